@@ -2,6 +2,7 @@
 #include <memory>
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <glm/gtc/type_ptr.hpp>
 #include <mineola/AppHelper.h>
 #include <mineola/CameraController.h>
@@ -185,8 +186,11 @@ public:
   void UpdateGPUData() {
     // update pos buffer
     auto vs = vs_.lock();
-    vs->buffer_ptr->Bind();
-    vs->buffer_ptr->UpdateData(0, vs->Stride() * vs->size, glm::value_ptr(positions_[0]));
+    auto dst = vs->buffer_ptr->MapForWrite();
+    if (dst) {
+      memcpy(dst, positions_.data(), vs->Stride() * vs->size);
+      vs->buffer_ptr->Unmap();
+    }
   }
 
   void FrameMove(double time, double frame_time) override {
@@ -297,7 +301,7 @@ public:
 
     auto geometry_node = SceneNode::FindNodeByName("geometry", en.Scene().get());
     if (geometry_node) {
-      geometry_node->Renderables().push_back(renderable);
+      geometry_node->AddRenderable(renderable);
     }
 
     cam_ctrl_.reset(new ArcballController);
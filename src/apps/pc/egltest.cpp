@@ -63,7 +63,7 @@ public:
     renderable->AddVertexArray(va2, "mineola:material:fallback");
     renderable->SetEffect("mineola:effect:fallback");
 
-    en.Scene()->Renderables().push_back(renderable);
+    en.Scene()->AddRenderable(renderable);
 
     RenderPass render_pass;
     render_pass.override_render_target = "framebuffer:offscr";
@@ -2,6 +2,7 @@
 #include <memory>
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <glm/gtc/type_ptr.hpp>
 #include <mineola/AppHelper.h>
 #include <mineola/CameraController.h>
@@ -200,12 +201,18 @@ public:
   void UpdateGPUData() {
     // update pos buffer
     auto vs_p = vs_pos_.lock();
-    vs_p->buffer_ptr->Bind();
-    vs_p->buffer_ptr->UpdateData(0, vs_p->Stride() * vs_p->size, glm::value_ptr(positions_[0]));
+    auto dst = vs_p->buffer_ptr->MapForWrite();
+    if (dst) {
+      memcpy(dst, positions_.data(), vs_p->Stride() * vs_p->size);
+      vs_p->buffer_ptr->Unmap();
+    }
 
     auto vs_n = vs_n_.lock();
-    vs_n->buffer_ptr->Bind();
-    vs_n->buffer_ptr->UpdateData(0, vs_n->Stride() * vs_n->size, glm::value_ptr(normals_[0]));
+    dst = vs_n->buffer_ptr->MapForWrite();
+    if (dst) {
+      memcpy(dst, normals_.data(), vs_n->Stride() * vs_n->size);
+      vs_n->buffer_ptr->Unmap();
+    }
   }
 
   void FrameMove(double time, double frame_time) override {
@@ -274,7 +281,7 @@ public:
 
     auto geometry_node = SceneNode::FindNodeByName("geometry", en.Scene().get());
     if (geometry_node) {
-      geometry_node->Renderables().push_back(renderable);
+      geometry_node->AddRenderable(renderable);
     }
 
     en.AddKeyboardCallback([water](uint32_t key, uint32_t action) {
@@ -2,6 +2,7 @@
 #define MINEOLA_AABB_H
 
 #include <memory>
+#include <vector>
 #include "GLMDefines.h"
 #include <glm/glm.hpp>
 
@@ -14,6 +15,11 @@ public:
   std::vector<glm::vec3> Corners() const;
   AABB &Combine(const AABB &other);
   AABB &Transform(const glm::mat4 &mat);
+  float SurfaceArea() const;
+  bool Overlaps(const AABB &other) const;
+  // slab test against a ray given by origin and 1 / direction, t_near is set on hit
+  bool IntersectRay(const glm::vec3 &origin, const glm::vec3 &inv_dir, float t_max,
+    float &t_near) const;
 public:
   glm::vec3 lb_{0.f, 0.f, 0.f};
   glm::vec3 ub_{0.f, 0.f, 0.f};
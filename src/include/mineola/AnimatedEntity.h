@@ -17,6 +17,11 @@ public:
   void PreRender() override;
   void PostRender() override;
   void Destroy() override;
+  // false unless enabled with SetThreadSafe(); entities whose animations drive the same
+  // nodes, e.g. the clips of a glTF file, must run in order so that the last one wins
+  bool IsThreadSafe() const override;
+  // for callers that know no other entity moves the nodes of this one
+  void SetThreadSafe(bool thread_safe);
 
   // add animation
   void AddAnimation(animation::Animation &&animation);
@@ -39,6 +44,7 @@ protected:
   double start_offset_{0.0};
   double speed_{1.0};
   double length_{0.0};
+  bool thread_safe_{false};
   // todo: evolve into a Unity like complex state machine
   std::vector<animation::Animation> animations_;
 };
@@ -14,6 +14,8 @@ public:
   virtual ~AppFrame();
 
   virtual void Run(uint32_t width, uint32_t height);
+  // simulate the next frame while rendering the current one, see FramePipeline. Off by default
+  void SetPipelined(bool pipelined);
 
 protected:
   virtual bool CreateRenderWindow();
@@ -24,6 +26,7 @@ protected:
   GLFWwindow *window_{ nullptr };
   uint32_t window_width_, window_height_;
   bool running_;
+  bool pipelined_{false};
 };
 }
 
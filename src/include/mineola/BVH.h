@@ -0,0 +1,170 @@
+#ifndef MINEOLA_BVH_H
+#define MINEOLA_BVH_H
+
+#include <cstdint>
+#include <vector>
+#include <optional>
+#include <utility>
+#include "GLMDefines.h"
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "Frustum.h"
+
+namespace mineola {
+
+// Bounding volume hierarchy over a set of items identified by their index.
+// Built top-down with the binned surface area heuristic, one item per leaf.
+// Moving items are handled by UpdateItem() + Refit(), which only re-fits the
+// ancestors of changed leaves. Rebuild when the tree quality degrades too much.
+class BVH {
+public:
+  enum : uint32_t { kInvalidIndex = 0xffffffff };
+
+  BVH();
+  ~BVH();
+
+  // items without bounds are left out of the tree
+  void Build(const std::vector<std::optional<AABB>> &item_bounds);
+  void Clear();
+  bool Empty() const;
+  size_t NumNodes() const;
+
+  // set new bounds of an item, takes effect after Refit()
+  void UpdateItem(uint32_t item, const AABB &bounds);
+  void Refit();
+
+  // visitor(uint32_t item) for every item whose bounds intersect the frustum
+  template<class VisitorT>
+  void QueryFrustum(const Frustum &frustum, VisitorT &&visitor) const;
+
+  // visitor(uint32_t item) for every item whose bounds overlap the box
+  template<class VisitorT>
+  void QueryAABB(const AABB &aabb, VisitorT &&visitor) const;
+
+  // float visitor(uint32_t item, float t_max) for every item whose bounds are hit by the ray
+  // before t_max, nearest subtrees first. The visitor returns the new t_max, so that returning
+  // the distance of an actual hit prunes everything behind it.
+  template<class VisitorT>
+  void QueryRay(const glm::vec3 &origin, const glm::vec3 &dir, float t_max,
+    VisitorT &&visitor) const;
+
+protected:
+  struct Node {
+    AABB bounds{glm::vec3(0.f), glm::vec3(0.f)};
+    uint32_t parent{kInvalidIndex};
+    uint32_t left{kInvalidIndex};
+    uint32_t right{kInvalidIndex};
+    uint32_t item{kInvalidIndex};  // valid for leaves only
+    bool dirty{false};
+
+    bool IsLeaf() const { return item != kInvalidIndex; }
+  };
+
+  uint32_t BuildRecursive(std::vector<uint32_t> &items,
+    const std::vector<std::optional<AABB>> &item_bounds,
+    uint32_t begin, uint32_t end, uint32_t parent);
+
+  // children always have larger indices than their parent
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> item_leaves_;
+  bool need_refit_;
+};
+
+template<class VisitorT>
+void BVH::QueryFrustum(const Frustum &frustum, VisitorT &&visitor) const {
+  if (nodes_.empty()) {
+    return;
+  }
+  // (node, whole subtree known to be inside)
+  std::vector<std::pair<uint32_t, bool>> stack;
+  stack.reserve(64);
+  stack.emplace_back(0, false);
+  while (!stack.empty()) {
+    auto [node_idx, inside] = stack.back();
+    stack.pop_back();
+    const auto &node = nodes_[node_idx];
+    if (!inside) {
+      if (!frustum.Intersects(node.bounds)) {
+        continue;
+      }
+      inside = frustum.Contains(node.bounds);
+    }
+    if (node.IsLeaf()) {
+      visitor(node.item);
+    } else {
+      stack.emplace_back(node.right, inside);
+      stack.emplace_back(node.left, inside);
+    }
+  }
+}
+
+template<class VisitorT>
+void BVH::QueryAABB(const AABB &aabb, VisitorT &&visitor) const {
+  if (nodes_.empty()) {
+    return;
+  }
+  std::vector<uint32_t> stack;
+  stack.reserve(64);
+  stack.push_back(0);
+  while (!stack.empty()) {
+    const auto &node = nodes_[stack.back()];
+    stack.pop_back();
+    if (!node.bounds.Overlaps(aabb)) {
+      continue;
+    }
+    if (node.IsLeaf()) {
+      visitor(node.item);
+    } else {
+      stack.push_back(node.right);
+      stack.push_back(node.left);
+    }
+  }
+}
+
+template<class VisitorT>
+void BVH::QueryRay(const glm::vec3 &origin, const glm::vec3 &dir, float t_max,
+  VisitorT &&visitor) const {
+  const glm::vec3 inv_dir = 1.f / dir;
+  float t_near = 0.f;
+  if (nodes_.empty() || !nodes_[0].bounds.IntersectRay(origin, inv_dir, t_max, t_near)) {
+    return;
+  }
+  // (node, entry distance)
+  std::vector<std::pair<uint32_t, float>> stack;
+  stack.reserve(64);
+  stack.emplace_back(0, t_near);
+  while (!stack.empty()) {
+    auto [node_idx, t_entry] = stack.back();
+    stack.pop_back();
+    if (t_entry > t_max) {
+      continue;  // a closer hit was found meanwhile
+    }
+    const auto &node = nodes_[node_idx];
+    if (node.IsLeaf()) {
+      t_max = visitor(node.item, t_max);
+      continue;
+    }
+
+    float t_left = 0.f, t_right = 0.f;
+    bool hit_left = nodes_[node.left].bounds.IntersectRay(origin, inv_dir, t_max, t_left);
+    bool hit_right = nodes_[node.right].bounds.IntersectRay(origin, inv_dir, t_max, t_right);
+    // push the far child first so that the near one is visited first
+    if (hit_left && hit_right) {
+      if (t_left <= t_right) {
+        stack.emplace_back(node.right, t_right);
+        stack.emplace_back(node.left, t_left);
+      } else {
+        stack.emplace_back(node.left, t_left);
+        stack.emplace_back(node.right, t_right);
+      }
+    } else if (hit_left) {
+      stack.emplace_back(node.left, t_left);
+    } else if (hit_right) {
+      stack.emplace_back(node.right, t_right);
+    }
+  }
+}
+
+} // namespace
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef MINEOLA_CAMERA_H
 #define MINEOLA_CAMERA_H
 
+#include <optional>
+#include <utility>
 #include "GLMDefines.h"
 #include <glm/glm.hpp>
 #include "Visitor.h"
@@ -27,10 +29,20 @@ public:
   void SetProjMatrix(const glm::mat4 &proj_mat);
   const glm::mat4 &GetViewMatrix() const {return view_mat_;}
   const glm::mat4 &GetProjMatrix() const {return proj_mat_;}
+  // updates only the snapshot projection if a snapshot is held, the camera's own one follows at
+  // the next Snapshot()
   void OnSize(const Viewport *viewport);
 
+  // uploads the snapshot matrices if a snapshot is held
   virtual void Activate();
 
+  // freeze the matrices used for rendering while the next frame is simulated,
+  // see Engine::SetPipelined()
+  void Snapshot();
+  void ClearSnapshot();
+  const glm::mat4 &RenderViewMatrix() const;
+  const glm::mat4 &RenderProjMatrix() const;
+
   // MINEOLA_VISITOR_ACCEPT_FUNC
 
 protected:
@@ -46,6 +58,16 @@ protected:
 
   // record if projection matrix is directly set
   bool using_custom_proj_matrix_;
+
+  // state read by the render thread, the simulation thread modifies the camera meanwhile
+  struct RenderSnapshot {
+    glm::mat4 view_mat, proj_mat;
+    float fovy, near_plane, far_plane, aspect_ratio;
+    float left, right, bottom, top;
+    bool using_custom_proj_matrix;
+    bool resized;  // by OnSize(), aspect_ratio is applied to the camera at the next Snapshot()
+  };
+  std::optional<RenderSnapshot> snapshot_;
 };
 
 class Resizer
@@ -0,0 +1,51 @@
+#ifndef MINEOLA_COMMANDLIST_H
+#define MINEOLA_COMMANDLIST_H
+
+#include <cstdint>
+#include <vector>
+#include "GLMDefines.h"
+#include <glm/glm.hpp>
+
+namespace mineola {
+
+class Renderable;
+struct Material;
+namespace vertex_type {
+class VertexArray;
+}
+
+// Draws of a render pass, recorded without touching GL so that worker threads can fill
+// lists for ranges of the render queue while the GL thread replays them in order.
+// Items refer to render queue indices, which select the model matrix and its slot in the
+// per-draw uniform ring.
+struct CommandList {
+  enum Op : uint8_t {
+    kBindEffect,  // effect of renderable in the pass
+    kSetModelMat,  // item
+    kDraw,  // vertex_array with material
+    kDrawInstanced,  // vertex_array with material, count matrices from first
+    // renderables with their own PreRender()/Draw(), replayed by calling them
+    kRenderable
+  };
+
+  struct Command {
+    Op op;
+    uint32_t item{0};
+    uint32_t first{0};  // in instance_mats
+    uint32_t count{1};
+    vertex_type::VertexArray *vertex_array{nullptr};
+    Material *material{nullptr};
+    Renderable *renderable{nullptr};
+  };
+
+  void Clear();
+  // append the commands of other, rebasing its instance matrices
+  void Append(const CommandList &other);
+
+  std::vector<Command> commands;
+  std::vector<glm::mat4> instance_mats;  // of all instanced draws
+};
+
+} // namespace
+
+#endif
@@ -13,6 +13,14 @@
 #include "ManagerBase.h"
 #include "ResourceManager.h"
 #include "RenderStateManager.h"
+#include "GeometryArena.h"
+#include "GLProgram.h"
+#include "RenderQueue.h"
+#include "CommandList.h"
+#include "OcclusionCuller.h"
+#include <limits>
+#include <optional>
+#include <thread>
 
 namespace mineola {
 
@@ -27,6 +35,22 @@ class Timer;
 class Framebuffer;
 class SceneNode;
 class UniformBlock;
+class Renderable;
+class GraphicsBuffer;
+class RingBuffer;
+class Skin;
+struct Material;
+
+struct RayCastHit {
+  const SceneNode *node{nullptr};
+  Renderable *renderable{nullptr};
+  uint32_t vertex_array{0};  // index within the renderable
+  uint32_t triangle{0};
+  // weights of the 2nd and 3rd vertex of the triangle
+  glm::vec2 barycentric{0.f, 0.f};
+  float distance{0.f};
+  glm::vec3 position{0.f, 0.f, 0.f};  // world space
+};
 
 class Engine {
 public:
@@ -35,10 +59,13 @@ public:
 
   ResourceManager &ResrcMgr();
   RenderStateManager &RenderStateMgr();
+  GeometryArena &GeomArena();
   ManagerBase<Entity> &EntityMgr();
   ManagerBase<Camera> &CameraMgr();
 
   void ChangeEffect(const std::string &name, bool force);
+  // bind an already resolved effect, skipped if it is bound in the current pass
+  void ChangeEffect(const std::shared_ptr<GLEffect> &effect, bool force);
   std::shared_ptr<GLEffect> &CurrentEffect();
 
   void ChangeCamera(const std::string &name, bool force);
@@ -51,6 +78,11 @@ public:
   std::shared_ptr<Framebuffer> GetScrFramebuffer();
 
   void DoRender(vertex_type::VertexArray &va, const std::string &material_name);
+  // material is replaced by the pass override material, if any
+  void DoRender(vertex_type::VertexArray &va, Material &material);
+  // model matrices of the instances are those of the batch being drawn, see Render()
+  void DoRenderInstanced(vertex_type::VertexArray &va, Material &material,
+    uint32_t num_instances);
 
     // manage render passes
   std::vector<RenderPass> &RenderPasses();
@@ -63,7 +95,16 @@ public:
   void Start();
   void RenderGUI();  // not invoked unless using GUI
   void FrameMove();
-  void Render();
+  void Render();  // PrepareRender(), RenderPrepared() then FinishRender()
+  // Render() in steps, for overlapping it with the FrameMove() of the next frame, see
+  // FramePipeline. PrepareRender() captures the frame to draw: entity PreRender(), time and
+  // light uniforms, the render queue, Renderable::PrepareFrame() and skin palettes.
+  // RenderPrepared() issues the passes reading only that state and may run while another
+  // thread calls FrameMove().
+  // FinishRender() calls entity PostRender(). Neither of the two may overlap FrameMove().
+  void PrepareRender();
+  void RenderPrepared();
+  void FinishRender();
   void OnSize(uint32_t width, uint32_t height);
   void Release();
 
@@ -115,6 +156,37 @@ public:
 
   // scene graph
   std::shared_ptr<SceneNode> Scene() const;
+  // call when renderables are added/removed/re-parented or change effect/material.
+  // Not from the simulation thread of a FramePipeline.
+  void InvalidateRenderQueue();
+  // renderables with world bounds and BVH as of the last Render(), for spatial queries
+  const RenderQueue &SceneRenderQueue() const;
+
+  // closest triangle hit by the world space ray, using transforms of the last Render().
+  // Only vertex arrays with a TriangleMesh are tested, see SetRetainCPUGeometry().
+  // Skinned renderables are not pickable.
+  std::optional<RayCastHit> RayCast(const glm::vec3 &origin, const glm::vec3 &dir,
+    float max_distance = std::numeric_limits<float>::max()) const;
+
+  // loaders keep a CPU copy of triangle meshes for RayCast(), off by default
+  void SetRetainCPUGeometry(bool retain);
+  bool RetainCPUGeometry() const;
+
+  // merge consecutive draws of the same geometry, effect and material into instanced draws,
+  // for effects reading the mineola_instancing attribute. On by default.
+  void SetAutoInstancing(bool enable);
+  bool AutoInstancing() const;
+
+  // cameras render from the matrices they had at PrepareRender(), so that FrameMove() of the
+  // next frame can move them. Set by FramePipeline, off by default. InvalidateRenderQueue()
+  // asserts it is not called from simulation_thread, see FramePipeline.
+  void SetPipelined(bool pipelined, std::thread::id simulation_thread = {});
+  bool Pipelined() const;
+
+  // directory of linked program binaries reused across runs, see ProgramBinaryCache.h.
+  // Must exist, empty (default) disables the cache.
+  void SetProgramCacheDir(const std::string &dir);
+  const std::string &ProgramCacheDir() const;
 
   // effects
   using effect_defines_t = std::vector<std::pair<std::string, std::string>>;
@@ -128,6 +200,17 @@ public:
     const effect_defines_t *defines);
   void ReloadEffectFiles();
 
+  // effects compiling and linking in the background, see GLEffect::BeginLink(). They are added
+  // to ResrcMgr() once linked, renderables draw with the fallback effects until then.
+  void AddPendingEffect(const std::string &name, std::shared_ptr<GLEffect> effect);
+  bool IsEffectPending(const std::string &name) const;
+  // adds the linked effects, or with wait all of them. Called by PrepareRender().
+  void FinishPendingEffects(bool wait);
+
+  // loaders link the effects they create as pending effects, off by default
+  void SetAsyncEffectLinking(bool enable);
+  bool AsyncEffectLinking() const;
+
   // uniform block
   const std::weak_ptr<UniformBlock> &BuiltinUniformBlock() const;
 
@@ -136,6 +219,12 @@ public:
   using texture_mem_loader_t =
     std::add_pointer<bool(const char *, uint32_t, bool, imgpp::Img &)>::type;
   void SetExtTextureLoaders(texture_loader_t file_loader, texture_mem_loader_t mem_loader);
+
+  // binds the palette of skin written this frame to the mineola_joint_uniforms block,
+  // false if there is none, see Skin
+  bool BindJointPalette(const Skin *skin);
+  // copies count matrices into fallback storage and binds it to the same block, per draw
+  void UploadJointPalette(const glm::mat4 *mats, uint32_t count);
   texture_loader_t ExtTextureLoader();
   texture_mem_loader_t ExtTextureMemLoader();
 
@@ -151,12 +240,15 @@ public:
 private:
   Engine();
 
-  // managers
-  ResourceManager resrc_mgr_;
+  // managers, resources notify the render state manager when destroyed
   RenderStateManager render_state_mgr_;
+  ResourceManager resrc_mgr_;
+  GeometryArena geometry_arena_;
   ManagerBase<Entity> entity_mgr_;
   ManagerBase<Camera> camera_mgr_;
   std::shared_ptr<SceneNode> root_node_;
+  RenderQueue render_queue_;
+  OcclusionCuller occlusion_culler_;
 
   // current state cache
   std::pair<std::string, std::shared_ptr<GLEffect> > current_effect_;
@@ -179,22 +271,83 @@ private:
   size_signal_t size_change_sig_;
   pinch_signal_t pinch_sig_;
 
+  enum { kEntitiesPerJob = 16 };
+  std::vector<Entity *> parallel_entities_;  // of the current FrameMove()
+
   std::shared_ptr<Timer> timer_;
   double time_, frame_time_;
+  double render_time_, render_frame_time_;  // of the frame being rendered
 
   bool override_effect_;
   bool override_camera_;
   bool override_render_target_;
-  std::string override_material_;
+  std::shared_ptr<Material> override_material_;  // resolved at the start of each pass
+  bool effect_bound_;  // current effect bound since the pass began
 
   effect_files_cache_t effect_files_cache_;
+  std::unordered_map<std::string, std::shared_ptr<GLEffect>> pending_effects_;
 
   texture_loader_t ext_texture_loader_;
   texture_mem_loader_t ext_texture_mem_loader_;
 
   std::weak_ptr<UniformBlock> builtin_uniform_block_;
 
+  // per-draw uniforms, resolved once per effect link
+  struct DrawUniformHandles {
+    uint32_t link_version{0};
+    int32_t model_mat{GLProgram::kInvalidUniform};
+    int32_t shadowmap0{GLProgram::kInvalidUniform};
+    int32_t env_light_probe0{GLProgram::kInvalidUniform};
+    bool draw_block{false};  // reads _model_mat from the mineola_draw_uniforms block
+  } draw_uniforms_;
+
+  // model matrices of the render queue in draw order, written once per frame for all passes
+  void WriteDrawUniforms();
+  std::unique_ptr<RingBuffer> draw_ring_;
+  uint32_t draw_ring_base_;  // offset of the first draw
+  uint32_t draw_ring_stride_;  // 0 if not written this frame
+  // holds the model matrix of a single draw when the ring could not be written
+  std::shared_ptr<GraphicsBuffer> draw_fallback_buffer_;
+
+  // command recording, see CommandList
+  enum { kRecordRangeSize = 1024 };  // render queue items per recording task
+  void RecordPass(uint32_t pass_idx);  // into pass_commands_
+  void RecordRange(uint32_t pass_idx, GLEffect *override_effect, size_t begin, size_t end,
+    CommandList &list) const;
+  void ReplayPass(uint32_t pass_idx, UniformBlock *builtin_ub);
+  void BindDrawUniforms();  // of the current effect
+  void UploadModelMatrix(uint32_t item);
+  std::vector<CommandList> record_lists_;  // one per range
+  CommandList pass_commands_;
+
+  // instanced draws
+  // copies model matrices into the stream buffer at the append cursor, sets instance_offset_
+  // to the first one
+  bool StreamInstanceMatrices(const glm::mat4 *mats, uint32_t count);
+  // offset is that of the first instance matrix in instance_buffer_, bytes
+  void DoRenderInstanced(vertex_type::VertexArray &va, Material &material,
+    uint32_t offset, uint32_t num_instances);
+  std::shared_ptr<GraphicsBuffer> instance_buffer_;
+  uint32_t instance_buffer_capacity_;  // bytes
+  uint32_t instance_offset_;  // of the last streamed batch, bytes
+  uint32_t instance_cursor_;  // where the next batch is appended, bytes
+
+  // joint palettes of the skins in the render queue, computed once per frame by
+  // PrepareRender() and written once for all passes
+  void WriteJointPalettes();
+  std::vector<Skin *> frame_skins_;  // sorted
+  std::vector<uint32_t> frame_palette_offsets_;  // of frame_skins_, if joint_ring_written_
+  std::unique_ptr<RingBuffer> joint_ring_;
+  bool joint_ring_written_;
+  std::shared_ptr<GraphicsBuffer> joint_fallback_buffer_;
+
   bool terminate_signaled_;
+  bool retain_cpu_geometry_;
+  bool auto_instancing_;
+  bool pipelined_;
+  std::thread::id simulation_thread_;
+  bool async_effect_linking_;
+  std::string program_cache_dir_;
 
   #ifdef MINEOLA_LOG_TO_FILE
   std::ofstream log_;
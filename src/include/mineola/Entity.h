@@ -20,6 +20,11 @@ public:
   virtual void PostRender();
   virtual void Destroy();
 
+  // FrameMove() of thread safe entities runs on the JobSystem, concurrently with other
+  // thread safe entities and after all the others. It may then only write state that no
+  // other entity touches in FrameMove(), e.g. transforms of its own scene nodes.
+  virtual bool IsThreadSafe() const;
+
 protected:
   const boost::uuids::uuid id_;
 };
@@ -1,6 +1,7 @@
 #ifndef MINEOLA_FILESYSTEM_H
 #define MINEOLA_FILESYSTEM_H
 
+#include <cstdint>
 #include <tuple>
 #include <string>
 
@@ -16,6 +17,15 @@ namespace mineola { namespace file_system {
   bool FileExists(const char *path);
   bool FileExists(const char *path, int &file_type);
 
+  // modification time (seconds) and size, to tell whether a cached file changed
+  struct FileStamp {
+    int64_t mtime{0};  // in nanoseconds, whole seconds on some platforms
+    int64_t size{0};
+    bool operator==(const FileStamp &rhs) const {return mtime == rhs.mtime && size == rhs.size;}
+    bool operator!=(const FileStamp &rhs) const {return !(*this == rhs);}
+  };
+  bool GetFileStamp(const char *path, FileStamp &stamp);
+
 }}
 
 #endif /* MINEOLA_FILESYSTEM_H */
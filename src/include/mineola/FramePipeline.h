@@ -0,0 +1,47 @@
+#ifndef MINEOLA_FRAMEPIPELINE_H
+#define MINEOLA_FRAMEPIPELINE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "Noncopyable.h"
+
+namespace mineola {
+
+// Overlaps the simulation of the next frame with the rendering of the current one.
+// Engine::FrameMove() of frame N+1 runs on a simulation thread while frame N is rendered on
+// the calling GL thread, from the state captured by Engine::PrepareRender().
+// Entities, frame move callbacks and controllers thus run concurrently with rendering: they
+// may move scene nodes and cameras, but must not
+//  - issue GL calls, add or remove resources or cameras,
+//  - change the scene structure: link, unlink or destroy nodes, add or remove renderables,
+//  - change the effect, material or vertex arrays of a renderable,
+// as the render thread draws from the render queue's raw Renderable pointers. Such edits
+// invalidate the render queue, which asserts it is not called from the simulation thread.
+// Make them from input handlers, between EndFrame() and the next BeginFrame().
+// Entity PostRender() of frame N runs in EndFrame(), after FrameMove() of frame N+1.
+// Frame time is the max of simulation and render time instead of their sum.
+class FramePipeline : Noncopyable {
+public:
+  FramePipeline();  // puts the engine in pipelined mode
+  ~FramePipeline();
+
+  // render the last simulated frame while simulating the next one
+  void BeginFrame();
+  // wait for the simulation, then call entity PostRender()
+  void EndFrame();
+
+protected:
+  void SimulationLoop();
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool simulating_{false};
+  bool stop_{false};
+  bool primed_{false};  // the first frame was simulated
+};
+
+} // namespace
+
+#endif
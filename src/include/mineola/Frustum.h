@@ -0,0 +1,31 @@
+#ifndef MINEOLA_FRUSTUM_H
+#define MINEOLA_FRUSTUM_H
+
+#include "GLMDefines.h"
+#include <glm/glm.hpp>
+#include "AABB.h"
+
+namespace mineola {
+
+// View frustum as 6 clip planes (left, right, bottom, top, near, far),
+// extracted from a projection * view (* model) matrix.
+// Plane normals point inwards, i.e. dot(plane, (p, 1)) >= 0 for inside points.
+struct Frustum {
+public:
+  Frustum() = default;
+  explicit Frustum(const glm::mat4 &proj_view);
+
+  // conservative test, may report intersection for boxes near frustum corners
+  bool Intersects(const AABB &aabb) const;
+  // true if the box is entirely inside
+  bool Contains(const AABB &aabb) const;
+
+  enum { kLeft = 0, kRight, kBottom, kTop, kNear, kFar, kNumPlanes };
+
+public:
+  glm::vec4 planes_[kNumPlanes];
+};
+
+} // namespace
+
+#endif
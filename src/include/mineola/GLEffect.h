@@ -2,6 +2,7 @@
 #define MINEOLA_GLEFFECT_H
 
 #include <vector>
+#include <optional>
 #include "GLProgram.h"
 
 namespace mineola {
@@ -14,26 +15,50 @@ public:
   GLEffect();
   virtual ~GLEffect();
 
+  // compiles the shaders if needed and links, or restores the program from the binary cache
   bool AttachShaders(std::shared_ptr<GLShader> pVS, std::shared_ptr<GLShader> pPS);
 
+  // AttachShaders() split for linking many effects at once. BeginLink() submits compiling and
+  // linking, which drivers with KHR_parallel_shader_compile run on their own threads until
+  // LinkComplete(). FinishLink() blocks until then and builds the attribute and uniform maps.
+  bool BeginLink(std::shared_ptr<GLShader> pVS, std::shared_ptr<GLShader> pPS);
+  // BeginLink() in two steps, so that callers compile only the shaders of the programs missing
+  // from the binary cache. RestoreProgram() returns true if the program was restored,
+  // LinkProgram() compiles and links otherwise.
+  bool RestoreProgram(std::shared_ptr<GLShader> pVS, std::shared_ptr<GLShader> pPS);
+  bool LinkProgram();
+  bool LinkComplete() const;
+  bool FinishLink();
+
   bool FindAttribLoc(const char *semantics, uint32_t format, uint32_t length, uint32_t *loc) const;
 
   void ApplyRenderStates() const;
+
+  // the vertex shader reads the model matrix from the per-instance attribute,
+  // see the mineola_instancing shader include
+  bool IsInstancingCapable() const;
   void SetRenderStates(std::vector<std::unique_ptr<RenderState>> states);
 
 protected:
   // IMPORTANT: so far the vertex shader's input attribute layout indices need to be manually assigned in GLSL,
   // following the index order specified in the VertexType::GetSemanticsBindLocation().
-  void ReorderAttribBindings();
+  // Binds every semantics before linking, names not used by the shader are ignored by GL.
+  void BindAttribLocations();
   bool GenerateAttribMap();
+  bool GenerateMaps();
 
   std::shared_ptr<GLShader> vertex_shader_;
   std::shared_ptr<GLShader> pixel_shader_;
+  bool shaders_attached_;  // false if restored from a program binary
+  bool linking_;  // between BeginLink() and FinishLink()
+  bool restored_;  // from a program binary
+  std::optional<uint64_t> cache_key_;  // to store the program binary under once linked
 
   //map from var/attrib name to location and type
   std::unordered_map<std::string,
     std::tuple<uint32_t/*loc*/, uint32_t/*type*/, uint32_t/*size*/>> attribute_map_;
   std::vector<std::unique_ptr<RenderState>> render_states_;
+  bool instancing_capable_;
 };
 
 typedef std::vector<std::pair<std::string, std::string>> effect_defines_t;
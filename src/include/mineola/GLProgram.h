@@ -2,8 +2,10 @@
 #define MINEOLA_GLPROGRAM_H
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <tuple>
+#include <vector>
 #include <unordered_map>
 #include "BasisObj.h"
 #include "Noncopyable.h"
@@ -17,6 +19,18 @@ public:
 
   bool Bind();
 
+  enum : int32_t { kInvalidUniform = -1 };
+
+  // resolve a uniform once, then upload by handle. Handles stay valid until the program is
+  // relinked, which changes LinkVersion(). Versions are unique across all programs.
+  int32_t GetUniformHandle(const char *var_name) const;
+  uint32_t LinkVersion() const;
+
+  // values identical to the last uploaded ones are skipped
+  void UploadVariable(int32_t handle, const float *val);
+  void UploadVariable(int32_t handle, const int32_t *val);
+  void UploadVariable(int32_t handle, const uint32_t *val);
+
   void UploadVariable(const char *var_name, const float *val);
   void UploadVariable(const char *var_name, const int32_t *val);
   void UploadVariable(const char *var_name, const uint32_t *val);
@@ -28,8 +42,18 @@ public:
 protected:
   bool InfoLog() const;
 
-  bool GetVariableInfo(const char *name,
-    uint32_t &type, uint32_t &loc, uint32_t &length);
+  struct UniformInfo {
+    std::string name;
+    uint32_t loc;
+    uint32_t type;
+    uint32_t size;  // array length
+    uint32_t shadow_offset;  // value last uploaded, in shadow_values_
+    uint32_t shadow_bytes;
+    bool shadow_valid;
+  };
+
+  // true if the value differs from the shadow copy, which is then updated
+  bool UpdateShadow(UniformInfo &info, const void *val);
 
   bool GenerateVarMap();
   bool GenerateUniformBlockMap();
@@ -37,9 +61,12 @@ protected:
 
   uint32_t handle_;
 
-  //map from var/attrib name to location and type
-  std::unordered_map<std::string,
-    std::tuple<uint32_t/*loc*/, uint32_t/*type*/, uint32_t/*size*/>> variable_map_;
+  // active uniforms outside of blocks, indexed by handle
+  std::vector<UniformInfo> uniforms_;
+  std::vector<uint8_t> shadow_values_;
+  // map from var name (viewing into uniforms_) to handle
+  std::unordered_map<std::string_view, int32_t> variable_map_;
+  uint32_t link_version_;
 
   // map from shader storage buffer name to binding index
   std::unordered_map<std::string, int32_t> ssb_map_;
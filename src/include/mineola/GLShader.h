@@ -20,14 +20,29 @@ public:
   virtual ~GLShader();
   uint32_t Handle() const {return handle_;}
 
+  // preprocess and compile
   bool LoadFromMemory(const char *pbuf, const effect_defines_t *defines);
   bool LoadFromFile(const char *fn, const effect_defines_t *defines);
 
+  // preprocess only. GLEffect::AttachShaders() compiles unless a cached program binary is found
+  bool PreprocessFromMemory(const char *pbuf, const effect_defines_t *defines);
+  bool PreprocessFromFile(const char *fn, const effect_defines_t *defines);
+  bool Compile();  // no-op if already compiled
+  bool Compiled() const {return compiled_;}
+  const std::string &Source() const {return source_;}  // preprocessed
+
+  // Compile() in two steps. Drivers may compile in the background between them, the status
+  // query of FinishCompile() blocks until the compilation is done.
+  void SubmitCompile();
+  bool FinishCompile();
+
 protected:
-  bool LoadFromRawMemory(const char *str);
   bool InfoLog() const;
 
   uint32_t handle_;
+  std::string source_;
+  bool submitted_;
+  bool compiled_;
 };
 
 class GLVertexShader : public GLShader {
@@ -0,0 +1,79 @@
+#ifndef MINEOLA_GEOMETRYARENA_H
+#define MINEOLA_GEOMETRYARENA_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Noncopyable.h"
+
+namespace mineola {
+
+class GraphicsBuffer;
+namespace vertex_type {
+struct VertexStream;
+}
+
+// A range of a geometry arena page, returned to the page when destroyed.
+class GeometryAllocation : Noncopyable {
+public:
+  ~GeometryAllocation();
+
+  // both change when the arena is defragmented
+  const std::shared_ptr<GraphicsBuffer> &Buffer() const;
+  uint32_t Offset() const;
+  uint32_t Size() const;  // rounded up to the arena alignment
+
+protected:
+  friend class GeometryArena;
+  struct Page;
+
+  GeometryAllocation(const std::shared_ptr<Page> &page, uint32_t offset, uint32_t size);
+
+  std::weak_ptr<Page> page_;
+  std::shared_ptr<GraphicsBuffer> buffer_;
+  uint32_t offset_;
+  uint32_t size_;
+};
+
+// Sub-allocates static vertex and index data of many meshes from a few large buffers,
+// so that meshes share buffer objects instead of owning one per stream.
+// Each page keeps a free list ordered by offset, freed ranges merge with their neighbors.
+class GeometryArena : Noncopyable {
+public:
+  enum { kDefaultPageSize = 4 << 20, kAlignment = 16 };
+
+  explicit GeometryArena(uint32_t page_size = kDefaultPageSize);
+  ~GeometryArena();
+
+  // target is GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER, data may be null.
+  // Requests larger than a page get a page of their own.
+  std::shared_ptr<GeometryAllocation> Allocate(uint32_t target, uint32_t size, const void *data);
+  // allocates Stride() * size bytes for stream, uploads data and points the stream at them
+  bool AllocateStream(vertex_type::VertexStream &stream, uint32_t target, const void *data);
+
+  // packs the allocations of fragmented pages to their front and drops empty pages.
+  // Moved allocations change buffer and offset, and Generation() is incremented.
+  // Pages are only reclaimed here. It copies whole pages, so call it after bulk frees such as
+  // unloading a scene rather than per frame; BuildStaticBatches() calls it once done.
+  void Defragment();
+  // vertex arrays compare it to rebuild their VAOs after allocations moved
+  uint32_t Generation() const;
+
+  // forgets all pages, outstanding allocations keep their buffers alive
+  void Release();
+
+  size_t NumPages() const;
+  uint32_t PageSize() const;
+
+protected:
+  using Page = GeometryAllocation::Page;
+  std::shared_ptr<Page> CreatePage(uint32_t target, uint32_t capacity);
+
+  std::vector<std::shared_ptr<Page>> pages_;
+  uint32_t page_size_;
+  uint32_t generation_;
+};
+
+} // namespace
+
+#endif
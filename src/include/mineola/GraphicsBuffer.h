@@ -19,12 +19,21 @@ public:
   void SetBindTargets(std::vector<uint32_t> targets); //P.S. Call after unbinding buffer!
   void Bind();
   void BindBase();
+  void BindRange(uint32_t offset, uint32_t size);
   void Unbind();
   bool SetSize(uint32_t size);
   bool SetData(uint32_t size, const void *data);
+  // updates of all of a STREAM buffer orphan its storage, see MapForWrite()
   bool UpdateData(uint32_t offset, uint32_t size, const void *data);
 
   void *Map();
+  // binds the buffer, access_bits are GL_MAP_*_BIT flags
+  void *MapRange(uint32_t offset, uint32_t size, uint32_t access_bits);
+  // write access to all of the buffer, for STREAM buffers refilled every frame. The storage
+  // is orphaned: draws still reading the previous contents keep their copy, the write
+  // neither waits for them nor a fence. The previous contents are lost, fill all of it.
+  // nullptr on failure, Unmap() before drawing.
+  void *MapForWrite();
   void Unmap();
 
   enum Frequency { STATIC = 0, DYNAMIC = 1, STREAM =2 };
@@ -32,6 +41,9 @@ public:
   enum Access { READ_ONLY = 0, WRITE_ONLY = 1, READ_WRITE = 2 };
 
 protected:
+  void BindTarget(uint32_t target, uint32_t handle);
+  void EndUpdate();
+
   uint32_t buffer_handle_;
   uint32_t frequency_;
   uint32_t direction_;
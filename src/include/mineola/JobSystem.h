@@ -0,0 +1,108 @@
+#ifndef MINEOLA_JOBSYSTEM_H
+#define MINEOLA_JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Noncopyable.h"
+
+namespace mineola {
+
+// Work-stealing thread pool shared by the engine: entity updates, transform updates,
+// command recording, and any CPU work of loaders or image processing.
+// Each worker owns a deque, pushing and popping at the back while idle workers steal from
+// the front of the others. Threads waiting on a group run pending jobs of that group instead of
+// blocking, so jobs may submit and wait on nested groups, and a thread never picks up unrelated
+// work of another thread while waiting. Jobs must not throw.
+class JobSystem : Noncopyable {
+public:
+  using job_t = std::function<void()>;
+
+  // jobs to wait for together
+  class Group {
+  public:
+    bool Done() const;
+  private:
+    friend class JobSystem;
+    std::atomic<uint32_t> pending_{0};
+  };
+
+  static JobSystem &Instance();
+  ~JobSystem();
+
+  // workers plus the calling thread
+  uint32_t Concurrency() const;
+
+  void Submit(job_t job, Group &group);
+  // runs pending jobs of group until all of them are done
+  void Wait(Group &group);
+
+  // calls func(idx) for idx in [begin, end), split into ranges of at least grain indices.
+  // Runs on the calling thread alone if there is only one range.
+  template <class FuncT>
+  void ParallelFor(size_t begin, size_t end, size_t grain, const FuncT &func);
+
+protected:
+  JobSystem();
+
+  struct Job {
+    job_t func;
+    Group *group;
+  };
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void WorkerLoop(uint32_t idx);
+  // pop from the own deque of a worker, steal from the others otherwise. Only jobs of group
+  // unless it is null.
+  bool TryRun(uint32_t idx, const Group *group);
+  bool Pop(Worker &worker, bool back, const Group *group, Job &job);
+
+  std::vector<std::unique_ptr<Worker>> workers_;  // the last one is fed by non-worker threads
+  std::vector<std::thread> threads_;
+  std::atomic<uint32_t> num_queued_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  bool stop_{false};
+};
+
+template <class FuncT>
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, const FuncT &func) {
+  if (end <= begin) {
+    return;
+  }
+  grain = std::max<size_t>(grain, 1);
+  const size_t num_ranges = std::min<size_t>((end - begin + grain - 1) / grain,
+    Concurrency() * 4);
+  if (num_ranges <= 1) {
+    for (size_t idx = begin; idx < end; ++idx) {
+      func(idx);
+    }
+    return;
+  }
+
+  const size_t range_size = (end - begin + num_ranges - 1) / num_ranges;
+  Group group;
+  for (size_t range_begin = begin; range_begin < end; range_begin += range_size) {
+    const size_t range_end = std::min(end, range_begin + range_size);
+    Submit([&func, range_begin, range_end]() {
+      for (size_t idx = range_begin; idx < range_end; ++idx) {
+        func(idx);
+      }
+    }, group);
+  }
+  Wait(group);
+}
+
+} // namespace
+
+#endif
@@ -15,12 +15,15 @@ public:
   ManagerBase();
   virtual ~ManagerBase();
 
-  TPtr &Find(const std::string &name);
+  // read only, objects are replaced with Add() so that Generation() follows
   const TPtr &Find(const std::string &name) const;
   std::string QueryName(const TPtr &ptr) const;
   void Remove(const std::string &name);
   void Add(const std::string &name, TPtr &pObj);
   void Add(const std::string &name, TPtr &&pObj); //overload for rvalue reference
+  // incremented by adding, replacing or removing objects, so that users caching resolved
+  // objects know to resolve again
+  uint32_t Generation() const;
 
   template <typename TT>
   void Traverse(TT &visitor);
@@ -33,10 +36,11 @@ public:
 
 protected:
   std::unordered_map<std::string, TPtr> map_;
+  uint32_t generation_;
 };
 
 template <typename T, typename TPtr>
-ManagerBase<T, TPtr>::ManagerBase() {
+ManagerBase<T, TPtr>::ManagerBase() : generation_(0) {
 }
 
 template <typename T, typename TPtr>
@@ -44,16 +48,6 @@ ManagerBase<T, TPtr>::~ManagerBase() {
   map_.clear();
 }
 
-template <typename T, typename TPtr>
-TPtr &ManagerBase<T, TPtr>::Find(const std::string &name) {
-  static TPtr pNullObj;
-  auto iter = map_.find(name);
-  if (iter != map_.end()) //found
-    return iter->second;
-  else
-    return pNullObj;
-}
-
 template <typename T, typename TPtr>
 const TPtr &ManagerBase<T, TPtr>::Find(const std::string &name) const {
   const static TPtr pNullObj;
@@ -79,18 +73,27 @@ std::string ManagerBase<T, TPtr>::QueryName(const TPtr &ptr) const {
 template <typename T, typename TPtr>
 void ManagerBase<T, TPtr>::Add(const std::string &name, TPtr &pObj) {
   map_[name] = pObj;
+  ++generation_;
 }
 
 template <typename T, typename TPtr>
 void ManagerBase<T, TPtr>::Add(const std::string &name, TPtr &&pObj) {
   map_[name] = pObj;
+  ++generation_;
 }
 
 template <typename T, typename TPtr>
 void ManagerBase<T, TPtr>::Remove(const std::string &name) {
   auto iter = map_.find(name);
-  if (iter != map_.end())
+  if (iter != map_.end()) {
     map_.erase(iter);
+    ++generation_;
+  }
+}
+
+template <typename T, typename TPtr>
+uint32_t ManagerBase<T, TPtr>::Generation() const {
+  return generation_;
 }
 
 template <typename T, typename TPtr> template <typename TT>
@@ -109,6 +112,7 @@ void ManagerBase<T, TPtr>::Transform(const TT &op) {
 template <typename T, typename TPtr>
 void ManagerBase<T, TPtr>::ReleaseResources() {
   map_.clear();
+  ++generation_;
 }
 
 template <typename T, typename TPtr>
@@ -12,19 +12,39 @@
 namespace mineola {
 
 class GLEffect;
+class Texture;
+class GraphicsBuffer;
 
 class UniformWrapper {
 public:
   virtual void UploadToShader(const char *var_name, GLEffect *effect) = 0;
+  // handle from GLProgram::GetUniformHandle()
+  virtual void UploadToShader(int32_t handle, GLEffect *effect) = 0;
 };
 
 struct TextureTransform {
   float rotation{0.0f};
   glm::vec4 offset_scale{0.0f, 0.0f, 1.0f, 1.0f};
   void UploadToShader(const char *tex_name, GLEffect *effect) const;
+  void UploadToShader(int32_t ts_handle, int32_t rot_handle, GLEffect *effect) const;
+};
+
+// std140 layout of the mineola_material uniform block
+struct MaterialUniforms {
+  glm::vec3 ambient;
+  float alpha;
+  glm::vec3 diffuse;
+  float specularity;
+  glm::vec3 specular;
+  float roughness;
+  glm::vec3 emit;
+  float padding;
 };
 
 struct Material : public Resource {
+  Material();
+  virtual ~Material();
+
   glm::vec3 ambient;
   glm::vec3 diffuse;
   glm::vec3 specular;
@@ -33,11 +53,56 @@ struct Material : public Resource {
   float specularity{0.0f};
   float roughness{0.0f};
 
+  // edit through the setters below, which keep the resolved bindings up to date
   std::unordered_map<std::string, std::vector<std::string>> texture_slots;
   std::unordered_map<std::string, TextureTransform> texture_tforms;
   std::unordered_map<std::string, std::shared_ptr<UniformWrapper>> uniform_slots;
 
+  void SetTextureSlot(const std::string &name, std::vector<std::string> texture_names);
+  void SetTextureTransform(const std::string &name, const TextureTransform &tform);
+  void SetUniformSlot(const std::string &name, std::shared_ptr<UniformWrapper> wrapper);
+
+  // uniform handles and textures are resolved once per effect link and resource generation.
+  // Effects with the mineola_material block read the fields from a uniform buffer of the
+  // material, refreshed only when a field changed.
   virtual void UploadToShader(GLEffect *effect);
+  // call after editing the slot maps directly
+  void InvalidateBindings();
+
+protected:
+  // copies of the slots, so that replaced map entries never dangle
+  struct UniformBinding {
+    std::string name;
+    int32_t handle;
+    std::shared_ptr<UniformWrapper> wrapper;
+  };
+
+  struct TextureBinding {
+    std::string name;
+    int32_t sampler;
+    int32_t ts;
+    int32_t rot;
+    TextureTransform tform;
+    std::vector<std::shared_ptr<Texture>> textures;
+    std::vector<int32_t> units;
+  };
+
+  // everything UploadToShader() needs for one effect, no names involved
+  struct Binding {
+    uint32_t link_version;
+    uint32_t resource_generation;
+    bool material_block;  // fields below are unused if true
+    int32_t ambient, diffuse, specular, emit, alpha, specularity, roughness;
+    std::vector<UniformBinding> uniforms;
+    std::vector<TextureBinding> textures;
+  };
+
+  const Binding &GetBinding(GLEffect *effect);
+  void UpdateUniformBuffer();
+
+  std::vector<Binding> bindings_;  // one per effect the material is drawn with
+  std::unique_ptr<GraphicsBuffer> uniform_buffer_;  // created on first use
+  MaterialUniforms uploaded_uniforms_;  // buffer content
 };
 
 }
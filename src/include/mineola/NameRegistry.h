@@ -0,0 +1,48 @@
+#ifndef MINEOLA_NAMEREGISTRY_H
+#define MINEOLA_NAMEREGISTRY_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "Noncopyable.h"
+
+namespace mineola {
+
+class SceneNode;
+
+// Interned SceneNode names and the scene-wide index from name id to live nodes.
+// Interned strings are never released, node entries are removed on destruction/rename.
+// Guarded by a mutex, as thread safe entities may rename nodes concurrently.
+class NameRegistry : Noncopyable {
+public:
+  enum : uint32_t { kEmptyName = 0, kInvalidName = 0xffffffff };
+
+  static NameRegistry &Instance();
+  ~NameRegistry();
+
+  uint32_t Intern(std::string_view name);
+  // kInvalidName if the name was never interned
+  uint32_t Find(std::string_view name) const;
+  const std::string &Str(uint32_t id) const;
+
+  void AddNode(uint32_t id, SceneNode *node);
+  void RemoveNode(uint32_t id, SceneNode *node);
+  // nodes named by id, in creation/rename order. A copy, the index may change concurrently.
+  std::vector<SceneNode *> Nodes(uint32_t id) const;
+
+protected:
+  NameRegistry();
+
+  std::deque<std::string> strings_;  // stable storage for the map keys
+  std::unordered_map<std::string_view, uint32_t> ids_;
+  std::vector<std::vector<SceneNode *>> nodes_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace
+
+#endif
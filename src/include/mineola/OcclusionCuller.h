@@ -0,0 +1,58 @@
+#ifndef MINEOLA_OCCLUSIONCULLER_H
+#define MINEOLA_OCCLUSIONCULLER_H
+
+#include <cstdint>
+#include <vector>
+#include "GLMDefines.h"
+#include <glm/glm.hpp>
+#include "AABB.h"
+
+namespace mineola {
+
+class TriangleMesh;
+
+// CPU software occlusion culling.
+// Occluder triangles are rasterized into a low resolution depth buffer (4 pixels at a time
+// with SSE2 where available), then boxes are tested against a max-depth (hierarchical-Z)
+// pyramid built from it. Depth is NDC z remapped to [0, 1], cleared to 1 (far).
+// Independent of GL, usable for testing and benchmarking without a GPU.
+class OcclusionCuller {
+public:
+  // width is rounded up to a multiple of 4
+  OcclusionCuller(uint32_t width = 256, uint32_t height = 128);
+  ~OcclusionCuller();
+
+  void Resize(uint32_t width, uint32_t height);
+  void Clear();
+
+  // mvp maps mesh positions to clip space. Triangles crossing the near plane are skipped,
+  // which only makes culling less aggressive.
+  void RasterizeOccluder(const TriangleMesh &mesh, const glm::mat4 &mvp);
+  // call after all occluders are rasterized, before IsVisible()
+  void BuildHiZ();
+  // conservative, false only if the box is entirely behind rasterized occluders
+  bool IsVisible(const AABB &aabb, const glm::mat4 &proj_view) const;
+
+  uint32_t Width() const;
+  uint32_t Height() const;
+  // depth buffer, row major with the first row at the bottom of the screen
+  const std::vector<float> &DepthBuffer() const;
+
+protected:
+  // vertices in screen space: pixel x, pixel y, depth
+  void RasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2);
+
+  struct Level {
+    uint32_t width;
+    uint32_t height;
+    std::vector<float> depth;
+  };
+
+  // levels_[0] is the depth buffer, each following level holds the max of 2x2 texels
+  std::vector<Level> levels_;
+  std::vector<glm::vec4> clip_verts_;  // scratch
+};
+
+} // namespace
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <array>
+#include <vector>
 #include <optional>
 
 namespace mineola {
@@ -100,6 +101,22 @@ struct AttribFlags {
   };
 };
 
+struct PBRPermutation {
+  SFXFlags sfx_flags;
+  MaterialFlags mat_flags;
+  AttribFlags attrib_flags;
+  bool use_env_light{false};
+};
+
+// names of the effect and the shadowmap effect of a permutation
+std::pair<std::string, std::string> PBREffectNames(const PBRPermutation &perm);
+
+// Creates the effects of the permutations not created yet. All shaders are submitted for
+// compilation before any program is linked, letting drivers compile them in parallel.
+// Linking finishes before returning, or with async later as pending effects, see
+// Engine::AddPendingEffect(). Returns false if any effect failed, so far as known.
+bool CreatePBREffects(const std::vector<PBRPermutation> &perms, bool async);
+
 std::optional<std::pair<std::string, std::string>> SelectOrCreatePBREffect(
   const SFXFlags &sfx_flags, const MaterialFlags &mat_flags,
   const AttribFlags &attrib_flags, bool use_env_light);
@@ -0,0 +1,25 @@
+#ifndef MINEOLA_PROGRAMBINARYCACHE_H
+#define MINEOLA_PROGRAMBINARYCACHE_H
+
+#include <cstdint>
+#include <string>
+
+namespace mineola { namespace program_binary_cache {
+
+// Linked programs are stored under Engine::ProgramCacheDir() as <key>.bin, and restored with
+// glProgramBinary instead of compiling and linking from source. Disabled while the directory
+// is empty or the driver offers no binary formats.
+bool Enabled();
+
+// hash of the preprocessed sources, which include the defines, and the driver strings
+uint64_t Key(const std::string &vs_src, const std::string &ps_src);
+
+// false on a miss, or if the driver rejects the binary, e.g. after a driver update
+bool Load(uint64_t key, uint32_t program);
+
+// program must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+bool Store(uint64_t key, uint32_t program);
+
+}} //end namespace
+
+#endif
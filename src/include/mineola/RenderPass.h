@@ -35,6 +35,10 @@ struct RenderPass {
   int layer_mask {RENDER_LAYER_ALL};
   int sfx {SFX_PASS_NONE};
   int clear_flag {CLEAR_ALL};
+  // skip renderables whose bounding box lies outside the active camera frustum
+  bool frustum_cull {true};
+  // additionally skip renderables hidden behind occluder meshes, needs frustum_cull
+  bool occlusion_cull {false};
   std::string override_effect;
   std::string override_render_target;
   std::string override_camera;
@@ -0,0 +1,122 @@
+#ifndef MINEOLA_RENDERQUEUE_H
+#define MINEOLA_RENDERQUEUE_H
+
+#include <cstdint>
+#include <vector>
+#include <optional>
+#include "GLMDefines.h"
+#include <glm/glm.hpp>
+#include "AABB.h"
+#include "BVH.h"
+
+namespace mineola {
+
+class SceneNode;
+class Renderable;
+class Camera;
+class OcclusionCuller;
+
+// Persistent draw list of all renderables under a scene root.
+// The list is only regenerated after Invalidate() (scene structure or renderable
+// effect/material changes), per-frame work is limited to refreshing transforms and
+// re-ordering the draws by their 64-bit sort keys.
+// A BVH over the world bounds of the items is refit along with the transforms, and
+// serves culling and spatial queries.
+class RenderQueue {
+public:
+  struct Item {
+    uint64_t sort_key{0};
+    glm::mat4 model_mat;
+    std::optional<AABB> world_bbox;  // empty if the renderable can't be culled
+    bool visible{true};  // result of the last Cull()
+    const SceneNode *node{nullptr};
+    Renderable *renderable{nullptr};
+  };
+
+  RenderQueue();
+  ~RenderQueue();
+
+  void Invalidate();
+  bool IsValid() const;
+
+  // collect renderables and their static sort key fields
+  void Rebuild(const SceneNode &root);
+  // refresh world transforms, view depth and draw order
+  void Update(const Camera *camera);
+  void Clear();
+
+  // set Item::visible by the frustum, all items are visible if frustum is nullptr
+  void Cull(const Frustum *frustum);
+  // rasterize visible occluders, then hide visible items behind them
+  void CullOccluded(OcclusionCuller &culler, const glm::mat4 &proj_view);
+
+  // spatial queries on the world bounds as of the last Update(), items without bounds
+  // are never reported. Visitors take a const Item &, see BVH for the ray visitor.
+  template<class VisitorT>
+  void QueryFrustum(const Frustum &frustum, VisitorT &&visitor) const;
+  template<class VisitorT>
+  void QueryAABB(const AABB &aabb, VisitorT &&visitor) const;
+  template<class VisitorT>
+  void QueryRay(const glm::vec3 &origin, const glm::vec3 &dir, float t_max,
+    VisitorT &&visitor) const;
+
+  // items in draw order
+  size_t Size() const;
+  const Item &operator[](size_t idx) const;
+
+  /*
+   * Sort key layout, from the most significant bit:
+   *   opaque:      queue id (16) | effect (12) | material (12) | vertex array (8) | depth (16)
+   *   transparent: queue id (16) | inverted depth (16) | effect (12) | material (12) | vertex array (8)
+   * so that state changes are minimized for opaque draws, while transparent draws are
+   * rendered back to front.
+   */
+  enum : uint32_t {
+    kQueueBits = 16,
+    kEffectBits = 12,
+    kMaterialBits = 12,
+    kVertexArrayBits = 8,
+    kDepthBits = 16
+  };
+
+protected:
+  struct StaticKey {
+    uint16_t queue;
+    uint16_t effect;
+    uint16_t material;
+    uint16_t vertex_array;
+    bool transparent;
+  };
+
+  std::vector<Item> items_;
+  std::vector<StaticKey> static_keys_;
+  // (sort key, item index), sorted
+  std::vector<std::pair<uint64_t, uint32_t>> order_;
+  std::vector<std::pair<uint64_t, uint32_t>> scratch_;
+  // over items_ indices, built on the first Update() after Rebuild(), and rebuilt when an
+  // item gains or loses its bounds, e.g. by Renderable::SetBbox() or SetSkin()
+  BVH bvh_;
+  std::vector<uint8_t> in_bvh_;  // item had bounds when the tree was built
+  bool valid_;
+};
+
+template<class VisitorT>
+void RenderQueue::QueryFrustum(const Frustum &frustum, VisitorT &&visitor) const {
+  bvh_.QueryFrustum(frustum, [this, &visitor](uint32_t idx) { visitor(items_[idx]); });
+}
+
+template<class VisitorT>
+void RenderQueue::QueryAABB(const AABB &aabb, VisitorT &&visitor) const {
+  bvh_.QueryAABB(aabb, [this, &visitor](uint32_t idx) { visitor(items_[idx]); });
+}
+
+template<class VisitorT>
+void RenderQueue::QueryRay(const glm::vec3 &origin, const glm::vec3 &dir, float t_max,
+  VisitorT &&visitor) const {
+  bvh_.QueryRay(origin, dir, t_max,
+    [this, &visitor](uint32_t idx, float t) { return visitor(items_[idx], t); });
+}
+
+} // namespace
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef MINEOLA_RENDERSTATEMANAGER_H
 #define MINEOLA_RENDERSTATEMANAGER_H
 
+#include <cstdint>
 #include <unordered_map>
 #include <stack>
 #include "GLMDefines.h"
@@ -55,6 +56,24 @@ public:
     render_state::BlendEquation equation, bool force = false);
   void SetBlendEnabled(bool enabled, bool force = false);
 
+  // Object bindings, redundant binds are skipped.
+  // Only binds made through these calls are known, call InvalidateBindings() after
+  // binding objects directly.
+  void UseProgram(uint32_t program);
+  void ActiveTexture(uint32_t unit);  // index of the unit, not GL_TEXTURE0 + unit
+  void BindTexture(uint32_t target, uint32_t texture);  // to the active unit
+  void BindVertexArray(uint32_t vao);
+  void BindBuffer(uint32_t target, uint32_t buffer);
+  void BindBufferBase(uint32_t target, uint32_t index, uint32_t buffer);
+  void BindBufferRange(uint32_t target, uint32_t index, uint32_t buffer,
+    uint32_t offset, uint32_t size);
+  // deleted objects are unbound by GL, their handles may be recycled
+  void OnProgramDeleted(uint32_t program);
+  void OnTextureDeleted(uint32_t texture);
+  void OnVertexArrayDeleted(uint32_t vao);
+  void OnBufferDeleted(uint32_t buffer);
+  void InvalidateBindings();
+
   int32_t GetCullMode() const;
   int32_t GetStencilMode() const;
   int32_t GetDepthTestMode() const;
@@ -80,6 +99,24 @@ protected:
   void ApplyStateCache(StateCache &state_cache, bool force = false);
   StateCache current_state_;
   std::stack<StateCache> states_stack_;
+
+  // bindings are not part of the pushed states
+  enum : uint32_t { kUnknownBinding = 0xffffffff };
+  struct IndexedBufferBinding {
+    uint32_t buffer;
+    uint32_t offset;
+    uint32_t size;  // 0 for the whole buffer
+  };
+  struct BindingCache {
+    uint32_t program{kUnknownBinding};
+    uint32_t active_texture_unit{kUnknownBinding};
+    uint32_t vertex_array{kUnknownBinding};
+    std::unordered_map<uint64_t, uint32_t> textures;  // (unit << 32 | target) -> texture
+    // target -> buffer, the element array binding is part of the vertex array
+    std::unordered_map<uint32_t, uint32_t> buffers;
+    std::unordered_map<uint64_t, IndexedBufferBinding> indexed_buffers;  // (target << 32 | index)
+  };
+  BindingCache bindings_;
 };
 }
 
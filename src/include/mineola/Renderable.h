@@ -12,15 +12,30 @@
 
 namespace mineola {
 
+class TriangleMesh;
+class GLEffect;
+struct Material;
+
 class Renderable : public Resource {
 public:
   Renderable();
   Renderable(int16_t queue_id);
   virtual ~Renderable();
 
+  // called once per frame before the passes, at a point where the scene is not being
+  // simulated (see Engine::PrepareRender()). Captures the scene state PreRender() and Draw()
+  // read. May run more than once per frame for renderables shared between nodes.
+  virtual void PrepareFrame(double frame_time);
   virtual void PreRender(double frame_time, uint32_t pass);
   virtual void Draw(double frame_time, uint32_t pass);
 
+  // Consecutive draws of renderables with the same effect, vertex arrays and materials are
+  // merged into instanced draws by the engine, model matrices being supplied per instance.
+  // Skinned renderables are never instanced.
+  virtual bool SupportsInstancing() const;
+  bool CanInstanceWith(Renderable &other, uint32_t pass);
+  virtual void DrawInstanced(double frame_time, uint32_t pass, uint32_t num_instances);
+
   void AddVertexArray(std::shared_ptr<vertex_type::VertexArray> va,
             const char *material_name);
   size_t NumVertexArray() const;
@@ -42,16 +57,42 @@ public:
   void SetQueueId(int16_t id);
 
   void SetSkin(std::shared_ptr<Skin> skin);
+  bool IsSkinned() const;
+  const std::shared_ptr<Skin> &GetSkin() const;
 
   void SetBbox(const AABB &bbox);
   const std::optional<AABB> &Bbox() const;
+  // incremented by SetBbox() of any renderable, scene nodes drop their cached bounds on change
+  static uint32_t BboxGeneration();
+
+  // simplified mesh rasterized by the software occlusion culler, nullptr if not an occluder
+  void SetOccluderMesh(std::shared_ptr<TriangleMesh> mesh);
+  const std::shared_ptr<TriangleMesh> &OccluderMesh() const;
 
   enum {
     kQueueOpaque = 0,
     kQueueTransparent = 1024
   };
 
+  // effects and materials resolved by name, with fallbacks applied
+  struct DrawPacket {
+    vertex_type::VertexArray *vertex_array;
+    Material *material;
+  };
+
+  // compile draw packets if outdated. The engine calls it on the GL thread before recording
+  // a frame, after which the accessors below may be read from worker threads.
+  void UpdateDrawPackets();
+  // effect drawing the renderable in a pass, shadowmap effect in shadowmap passes
+  const std::shared_ptr<GLEffect> &PassEffect(uint32_t pass) const;
+  const std::vector<DrawPacket> &DrawPackets() const;
+
 protected:
+  // resolve names into draw packets. Runs lazily when the renderable was edited or resources
+  // were added/removed since the last compilation, keeping the per-draw path free of lookups.
+  void CompileDrawPackets();
+  void InvalidateDrawPackets();
+
   int16_t q_id_;
   int layer_mask_;
   std::string effect_name_; // for standard render pass
@@ -60,6 +101,13 @@ protected:
   std::vector<std::string> material_names_;
   std::shared_ptr<Skin> skin_;
   std::optional<AABB> bbox_;
+  std::shared_ptr<TriangleMesh> occluder_mesh_;
+
+  std::shared_ptr<GLEffect> effect_;
+  std::shared_ptr<GLEffect> shadowmap_effect_;
+  std::vector<std::shared_ptr<Material>> materials_;  // keeps packet materials alive
+  std::vector<DrawPacket> packets_;
+  std::optional<uint32_t> packets_generation_;  // resource generation compiled against
 };
 
 } //namespaces
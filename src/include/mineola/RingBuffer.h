@@ -0,0 +1,54 @@
+#ifndef MINEOLA_RINGBUFFER_H
+#define MINEOLA_RINGBUFFER_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "Noncopyable.h"
+
+namespace mineola {
+
+class GraphicsBuffer;
+
+// Sub-allocator for data streamed to the GPU every frame.
+// The buffer is split into one segment per frame in flight. A segment is mapped for writing
+// at the start of a frame, and a fence is inserted once its last draw is issued, so that
+// the segment is only rewritten after the GPU is done reading it.
+class RingBuffer : Noncopyable {
+public:
+  // target and index as in GraphicsBuffer, e.g. GL_UNIFORM_BUFFER and the block binding
+  RingBuffer(uint32_t target, uint32_t index, uint32_t num_frames = 3);
+  ~RingBuffer();
+
+  // switch to the next segment and map it, growing segments to at least size bytes.
+  // Blocks if the GPU still reads the segment.
+  bool BeginFrame(uint32_t size);
+  // offset in Buffer() of size bytes within the current segment, std::nullopt if full
+  std::optional<uint32_t> Allocate(uint32_t size);
+  // write pointer for an offset returned by Allocate(), valid until EndWrite()
+  void *Pointer(uint32_t offset) const;
+  // unmap the segment, call before drawing from it
+  void EndWrite();
+  // call after the last draw reading the segment
+  void EndFrame();
+
+  // offsets returned by Allocate() are multiples of it
+  uint32_t Alignment() const;
+  GraphicsBuffer &Buffer();
+
+protected:
+  uint32_t Align(uint32_t size) const;
+
+  std::unique_ptr<GraphicsBuffer> buffer_;
+  uint32_t alignment_;
+  uint32_t segment_size_;
+  uint32_t frame_;  // current segment
+  uint32_t head_;  // allocated bytes in the current segment
+  uint8_t *mapped_;
+  std::vector<void *> fences_;  // GLsync per segment, nullptr if not in flight
+};
+
+} // namespace
+
+#endif
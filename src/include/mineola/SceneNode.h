@@ -1,6 +1,7 @@
 #ifndef MINEOLA_SCENENODE_H
 #define MINEOLA_SCENENODE_H
 
+#include <atomic>
 #include <vector>
 #include <memory>
 #include <string>
@@ -8,13 +9,16 @@
 #include <optional>
 #include "Rbt.h"
 #include "AABB.h"
+#include "Noncopyable.h"
 
 namespace mineola {
   class Renderable;
   class Light;
   class Camera;
 
-  class SceneNode : public std::enable_shared_from_this<SceneNode> {
+  class TransformStore;
+
+  class SceneNode : public std::enable_shared_from_this<SceneNode>, Noncopyable {
   public:
     SceneNode();
     SceneNode(const char *name);
@@ -22,33 +26,41 @@ namespace mineola {
 
     const std::weak_ptr<SceneNode> &Parent() const;
     const std::vector<std::shared_ptr<SceneNode>> &Children() const;
+    // position in the children of the parent, kept up to date on attaching and removing
+    uint32_t ChildIndex() const;
     void RemoveChild(const SceneNode &node);
     void RemoveChild(size_t index);
     void RemoveChildren();
     static void LinkTo(std::shared_ptr<SceneNode> child,
       const std::shared_ptr<SceneNode> &parent);
 
-    const glm::vec3 &Position() const;
+    // transforms live in the TransformStore, whose arrays move as nodes are created, so
+    // they are returned by value
+    glm::vec3 Position() const;
     void SetPosition(const glm::vec3 &position);
-    const glm::quat &Rotation() const;
+    glm::quat Rotation() const;
     void SetRotation(const glm::quat &rotation);
-    const glm::vec3 &Scale() const;
+    glm::vec3 Scale() const;
     void SetScale(const glm::vec3 &scale);
-    const math::Rbt &Rbt() const;
+    math::Rbt Rbt() const;
     void SetRbt(const math::Rbt &rbt);
 
     const std::string &Name() const;
     void SetName(const std::string &name);
+    // interned name, see NameRegistry
+    uint32_t NameId() const;
 
     // retrieve cached world tform
-    const math::Rbt &WorldRbt() const;
-    const glm::vec3 &WorldScale() const;
+    math::Rbt WorldRbt() const;
+    glm::vec3 WorldScale() const;
 
     // set local rbt w.r.t. parent rbt, given world rbt
     void SetWorldRbt(const math::Rbt &world_rbt);
 
-    std::vector<std::shared_ptr<Renderable>> &Renderables();
     const std::vector<std::shared_ptr<Renderable>> &Renderables() const;
+    // invalidate the render queue and the subtree bounds
+    void AddRenderable(std::shared_ptr<Renderable> renderable);
+    void RemoveRenderable(const std::shared_ptr<Renderable> &renderable);
 
     std::vector<std::shared_ptr<Light>> &Lights();
     const std::vector<std::shared_ptr<Light>> &Lights() const;
@@ -56,43 +68,59 @@ namespace mineola {
     std::vector<std::weak_ptr<Camera>> &Cameras();
     const std::vector<std::weak_ptr<Camera>> &Cameras() const;
 
+    // recompute cached world tforms of nodes in the subtree whose local tform (or an
+    // ancestor's) changed, level by level. Clean parts of the subtree are skipped.
     void UpdateSubtreeWorldTforms();
+    // flag this subtree for world tform update, called by all local tform setters
+    void MarkTformDirty();
 
     template<class VisitorT>
     void DFTraverse(const VisitorT &visitor) const;
     template<class VisitorT>
     void DFTraverse(const VisitorT &visitor);
 
+    // bounds of the subtree in parent space, cached until a tform, child or renderable list
+    // in the subtree or the bbox of any renderable changes
     std::optional<AABB> ComputeAABB() const;
+    void InvalidateAABB();
 
-    // bfs search
+    // dfs search
     template<class UnaryPredicate>
     std::shared_ptr<SceneNode> FindIf(UnaryPredicate p);
 
     template<class UnaryPredicate>
     std::shared_ptr<SceneNode const> FindIf(UnaryPredicate p) const;
 
+    // looked up in the NameRegistry, cost independent of the tree size.
+    // if several nodes under start node share the name, the first one in depth-first
+    // pre-order is returned.
     static std::shared_ptr<SceneNode> FindNodeByName(
       const char *name, SceneNode *node);
     static std::shared_ptr<SceneNode const> FindNodeByName(
       const char *name, const SceneNode *node);
 
   protected:
-    math::Rbt rbt_;
-    glm::vec3 scale_;
+    friend class TransformStore;
+
+    // slot in TransformStore, updated when the store is reordered
+    uint32_t tform_index_;
 
     std::weak_ptr<SceneNode> parent_;
+    uint32_t child_index_;  // in the children of parent_
 
     std::vector<std::shared_ptr<Renderable>> renderables_;
     std::vector<std::shared_ptr<SceneNode>> children_;
     std::vector<std::shared_ptr<Light>> lights_;
     std::vector<std::weak_ptr<Camera>> cameras_;
 
-    // cache world transform
-    math::Rbt world_rbt_;
-    glm::vec3 world_scale_;
+    // push world tform to attached lights and cameras
+    void UpdateAttachedTforms();
+
+    mutable std::optional<AABB> cached_aabb_;
+    mutable std::atomic<bool> aabb_valid_;
+    mutable uint32_t aabb_bbox_generation_;  // Renderable::BboxGeneration() of cached_aabb_
 
-    std::string name_;
+    uint32_t name_id_;
   };
 
   template<class VisitorT>
@@ -14,6 +14,8 @@ public:
   virtual ~ServerAppFrame();
 
   virtual void Run(uint32_t width, uint32_t height);
+  // simulate the next frame while rendering the current one, see FramePipeline. Off by default
+  void SetPipelined(bool pipelined);
 
 protected:
   virtual bool CreateRenderWindow();
@@ -23,6 +25,7 @@ protected:
 protected:
   uint32_t window_width_, window_height_;
   bool running_;
+  bool pipelined_{false};
   EGLDisplay egl_display_;
   EGLSurface egl_surface_;
 };
@@ -3,16 +3,21 @@
 
 #include <vector>
 #include <string>
-#include <istream>
+#include <string_view>
 
 namespace mineola { namespace shader_parser {
 
 typedef std::vector<std::pair<std::string, std::string>> effect_defines_t;
 
-bool ParseShader(std::istream &stream, const effect_defines_t *defines, std::string &shader_str);
+// Resolves #include directives and inserts the defines. Outputs are memoized by source and
+// defines, up to a bounded number of the most recently used, include files are cached and
+// re-read only when their modification time or size changes, so that preprocessing many
+// variants of an effect reads and scans everything once.
+bool ParseShader(std::string_view source, const effect_defines_t *defines, std::string &shader_str);
+// path as located by ResourceManager::LocateFile()
+bool ParseShaderFile(const char *path, const effect_defines_t *defines, std::string &shader_str);
 
-bool RecursiveParseShader(std::istream &stream,
-  const effect_defines_t *defines, uint32_t depth, std::string &shader_str);
+void ClearCache();
 
 }} //end namespace
 
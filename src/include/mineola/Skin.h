@@ -12,15 +12,26 @@ class SceneNode;
 
 class Skin {
 public:
+  // joints addressable by the mineola_joint_uniforms block, 16KB of matrices
+  enum { kMaxJoints = 256 };
+
   Skin();
   ~Skin();
 
+  // joint matrices from the current joint transforms. The engine calls it once per frame
+  // for every skin in the render queue, possibly on worker threads.
+  void PrepareFrame();
+  // binds the palette written by the engine, or uploads it if the engine could not write it
+  // or the effect has no joint block
   void PreRender(double frame_time, uint32_t pass);
 
   void SetRootNode(std::shared_ptr<SceneNode> &root_node);
   void SetJointNodes(std::vector<std::weak_ptr<SceneNode>> &&nodes,
     std::vector<glm::mat4> &&inv_bind_mats);
 
+  size_t NumJoints() const;
+  const glm::mat4 *JointMatrices() const;
+
 protected:
   std::weak_ptr<SceneNode> root_node_;
   std::vector<std::weak_ptr<SceneNode>> joint_nodes_;
@@ -34,4 +45,4 @@ protected:
 
 } //namespaces
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,25 @@
+#ifndef MINEOLA_STATICBATCHING_H
+#define MINEOLA_STATICBATCHING_H
+
+#include <cstddef>
+#include <memory>
+
+namespace mineola {
+
+class SceneNode;
+
+namespace static_batching {
+
+// Merges the renderables of a subtree that never moves into a few large vertex arrays.
+// Vertices are read back once, transformed into the space of root and concatenated per
+// effect, material, layer, queue and vertex layout. The merged renderables are attached to a
+// new child of root named "static_batch" and the originals are removed from their nodes.
+// Skinned renderables, occluders, subclasses of Renderable, strips, fans and non-float
+// positions, normals or tangents are left alone.
+// The geometry arena is defragmented afterwards, as the freed originals leave holes in it.
+// Returns the number of merged renderables created.
+size_t BuildStaticBatches(const std::shared_ptr<SceneNode> &root);
+
+}} // namespace
+
+#endif
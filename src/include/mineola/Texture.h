@@ -18,6 +18,10 @@ public:
    * Bind texture to the regular texture image unit
    */
   virtual void Bind();
+  /**
+   * Make unit the active texture image unit and bind texture to it
+   */
+  void BindToUnit(uint32_t unit);
 
   uint32_t Handle() const;
   const TextureDesc &Desc() const;
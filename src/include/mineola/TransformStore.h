@@ -0,0 +1,80 @@
+#ifndef MINEOLA_TRANSFORMSTORE_H
+#define MINEOLA_TRANSFORMSTORE_H
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include "GLMDefines.h"
+#include <glm/glm.hpp>
+#include "Rbt.h"
+#include "Noncopyable.h"
+
+namespace mineola {
+
+class SceneNode;
+
+// Flat structure-of-arrays storage of all SceneNode transforms.
+// Slots are kept sorted by depth (parent before child), so that world transforms can be
+// updated level by level, with each level processed in parallel.
+// Slot indices change when the hierarchy is reordered and the arrays reallocate as nodes are
+// created, so SceneNode hands out copies; references returned here are only valid until the
+// next node creation, destruction or re-parenting.
+class TransformStore : Noncopyable {
+public:
+  static TransformStore &Instance();
+  ~TransformStore();
+
+  uint32_t Allocate(SceneNode *node);
+  void Free(uint32_t idx);
+  // parent_idx == -1 for roots
+  void SetParent(uint32_t idx, int32_t parent_idx);
+  // may be called concurrently for distinct slots, e.g. by thread safe entities
+  void MarkDirty(uint32_t idx);
+  // slot has lights or cameras that follow its world tform
+  void SetHasAttachments(uint32_t idx);
+
+  math::Rbt &LocalRbt(uint32_t idx) { return local_rbts_[idx]; }
+  glm::vec3 &LocalScale(uint32_t idx) { return local_scales_[idx]; }
+  const math::Rbt &WorldRbt(uint32_t idx) const { return world_rbts_[idx]; }
+  const glm::vec3 &WorldScale(uint32_t idx) const { return world_scales_[idx]; }
+  math::Rbt &WorldRbt(uint32_t idx) { return world_rbts_[idx]; }
+
+  // recompute world tforms of dirty slots within the subtree of root, and their descendants.
+  // Only the slots between the first and the last dirty one, and the children of updated
+  // slots, are visited.
+  void Update(const SceneNode &root);
+
+  size_t Size() const;
+
+  enum { kParallelMinLevelSize = 1024 };  // slots per job
+
+protected:
+  TransformStore();
+  // sort slots in breadth-first order and drop freed slots
+  void Reorder();
+
+  std::vector<math::Rbt> local_rbts_;
+  std::vector<glm::vec3> local_scales_;
+  std::vector<math::Rbt> world_rbts_;
+  std::vector<glm::vec3> world_scales_;
+  std::vector<int32_t> parents_;
+  std::vector<uint8_t> dirty_;  // local tform changed
+  std::vector<uint8_t> changed_;  // world tform changed, only set during Update()
+  std::vector<uint8_t> has_attachments_;
+  std::vector<SceneNode *> nodes_;  // nullptr for freed slots
+  // children of a slot are [child_begin_[idx], child_end_[idx]), contiguous in breadth-first
+  // order, and nondecreasing within a level
+  std::vector<uint32_t> child_begin_;
+  std::vector<uint32_t> child_end_;
+  // bounds of the dirty slots, conservative until the next Update()
+  std::atomic<uint32_t> dirty_begin_;
+  std::atomic<uint32_t> dirty_end_;
+
+  // slots of depth d are [level_offsets_[d], level_offsets_[d + 1])
+  std::vector<uint32_t> level_offsets_;
+  bool ordered_;
+};
+
+} // namespace
+
+#endif
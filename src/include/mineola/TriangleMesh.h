@@ -0,0 +1,46 @@
+#ifndef MINEOLA_TRIANGLEMESH_H
+#define MINEOLA_TRIANGLEMESH_H
+
+#include <cstdint>
+#include <vector>
+#include "GLMDefines.h"
+#include <glm/glm.hpp>
+#include "BVH.h"
+#include "Noncopyable.h"
+
+namespace mineola {
+
+struct TriangleHit {
+  float t{0.f};  // ray parameter, origin + t * dir
+  uint32_t triangle{0};
+  // weights of the 2nd and 3rd vertex, the 1st one has 1 - u - v
+  glm::vec2 barycentric{0.f, 0.f};
+};
+
+// CPU copy of an indexed triangle list, kept alongside a VertexArray for ray casting.
+// The triangle BVH is built on the first ray query.
+class TriangleMesh : Noncopyable {
+public:
+  TriangleMesh(std::vector<glm::vec3> positions, std::vector<uint32_t> indices);
+  ~TriangleMesh();
+
+  const std::vector<glm::vec3> &Positions() const;
+  const std::vector<uint32_t> &Indices() const;
+  size_t NumTriangles() const;
+
+  // closest hit with t in [0, t_max], in the object space of the mesh
+  bool IntersectRay(const glm::vec3 &origin, const glm::vec3 &dir, float t_max,
+    TriangleHit &hit) const;
+
+protected:
+  void BuildBVH() const;
+
+  std::vector<glm::vec3> positions_;
+  std::vector<uint32_t> indices_;
+  mutable BVH bvh_;
+  mutable bool bvh_built_;
+};
+
+} // namespace
+
+#endif
@@ -323,6 +323,23 @@ namespace mineola { namespace type_mapping {
         *type = UINT32;
         *size = 4;
         break;
+      // only uniforms are bool, set through the glUniform*iv calls
+      case GL_BOOL:
+        *type = INT32;
+        *size = 1;
+        break;
+      case GL_BOOL_VEC2:
+        *type = INT32;
+        *size = 2;
+        break;
+      case GL_BOOL_VEC3:
+        *type = INT32;
+        *size = 3;
+        break;
+      case GL_BOOL_VEC4:
+        *type = INT32;
+        *size = 4;
+        break;
       default:
         *type = UNKNOWN;
         *size = 0;
@@ -330,6 +347,29 @@ namespace mineola { namespace type_mapping {
     }
   }
 
+  inline bool IsSamplerGLType(uint32_t gltype) {
+    switch (gltype) {
+      case GL_SAMPLER_2D:
+      case GL_SAMPLER_3D:
+      case GL_SAMPLER_CUBE:
+      case GL_SAMPLER_2D_SHADOW:
+      case GL_SAMPLER_2D_ARRAY:
+      case GL_SAMPLER_2D_ARRAY_SHADOW:
+      case GL_SAMPLER_CUBE_SHADOW:
+      case GL_INT_SAMPLER_2D:
+      case GL_INT_SAMPLER_3D:
+      case GL_INT_SAMPLER_CUBE:
+      case GL_INT_SAMPLER_2D_ARRAY:
+      case GL_UNSIGNED_INT_SAMPLER_2D:
+      case GL_UNSIGNED_INT_SAMPLER_3D:
+      case GL_UNSIGNED_INT_SAMPLER_CUBE:
+      case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+        return true;
+      default:
+        return false;
+    }
+  }
+
   inline uint32_t Map2GLType(uint32_t type) {
     switch (type) {
       case BOOL:
@@ -5,30 +5,60 @@
 #include <utility>
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include "BasisObj.h"
 
 namespace mineola {
 
 class GraphicsBuffer;
 
+// Uniform buffer with a CPU copy of its content.
+// Updates only touch the copy and extend a dirty byte range, which Flush() uploads in one go.
 class UniformBlock : public Resource {
 public:
-  enum Semantics { BUILTIN_UNIFORMS = 0, RESERVED_SEMANTICS_NUM = 1 };
+  enum Semantics {
+    BUILTIN_UNIFORMS = 0, MATERIAL_UNIFORMS = 1, DRAW_UNIFORMS = 2, JOINT_UNIFORMS = 3,
+    RESERVED_SEMANTICS_NUM = 4
+  };
   static const char *GetSemanticsString(int semantics);
   static uint32_t GetSemanticsBindLocation(int semantics);
 
+  // variables of the builtin block in std140 order, their handles equal the enum values
+  enum BuiltinVariable {
+    VIEW_MAT = 0, VIEW_MAT_INV, PROJ_MAT, PROJ_MAT_INV, PROJ_VIEW_MAT,
+    LIGHT_VIEW_MAT_0, LIGHT_PROJ_MAT_0, VIEWPORT_SIZE,
+    LIGHT_POS_0, LIGHT_INTENSITY_0, LIGHT_POS_1, LIGHT_INTENSITY_1,
+    LIGHT_POS_2, LIGHT_INTENSITY_2, LIGHT_POS_3, LIGHT_INTENSITY_3,
+    ENV_LIGHT_MAT_0, ENV_LIGHT_SH3_0, TIME, DELTA_TIME,
+    NUM_BUILTIN_VARIABLES
+  };
+  enum { kNumBuiltinLights = 4 };
+  static const char *GetBuiltinVariableString(int variable);
+  static uint32_t GetBuiltinVariableSize(int variable);
+
 public:
   explicit UniformBlock(uint32_t block_index);
   virtual ~UniformBlock();
 
   bool SetSize(uint32_t size);
+  // binds the block, uploading pending changes
   void Activate();
+  // handles are assigned in order of the first SetVariable() call of each name
   void SetVariable(const char *variable_name, uint32_t offset, uint32_t size);
+  int32_t GetVariableHandle(const char *variable_name) const;  // -1 if not found
+  bool UpdateVariable(int32_t handle, const void *data);
   bool UpdateVariable(const char *variable_name, const void *data);
 
+  bool IsDirty() const;
+  void Flush();
+
 protected:
   std::unique_ptr<GraphicsBuffer> buffer_;
-  std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> variable_map_;
+  std::unordered_map<std::string, int32_t> variable_map_;
+  std::vector<std::pair<uint32_t, uint32_t>> variables_;  // (offset, size) by handle
+  std::vector<uint8_t> data_;
+  uint32_t dirty_begin_;
+  uint32_t dirty_end_;  // empty range if not greater than dirty_begin_
 };
 
 }
@@ -18,6 +18,9 @@ public:
   virtual void UploadToShader(const char *var_name, GLEffect *effect) override {
     effect->UploadVariable(var_name, &value_);
   }
+  virtual void UploadToShader(int32_t handle, GLEffect *effect) override {
+    effect->UploadVariable(handle, &value_);
+  }
 private:
   T value_;
 };
@@ -29,6 +32,9 @@ public:
   virtual void UploadToShader(const char *var_name, GLEffect *effect) override {
     effect->UploadVariable(var_name, glm::value_ptr(value_));
   }
+  virtual void UploadToShader(int32_t handle, GLEffect *effect) override {
+    effect->UploadVariable(handle, glm::value_ptr(value_));
+  }
 private:
   T value_;
 };
@@ -40,6 +46,9 @@ public:
   virtual void UploadToShader(const char *var_name, GLEffect *effect) override {
     effect->UploadVariable(var_name, &value_[0]);
   }
+  virtual void UploadToShader(int32_t handle, GLEffect *effect) override {
+    effect->UploadVariable(handle, &value_[0]);
+  }
 private:
   std::vector<T> value_;
 };
@@ -51,6 +60,9 @@ public:
   virtual void UploadToShader(const char *var_name, GLEffect *effect) override {
     effect->UploadVariable(var_name, glm::value_ptr(value_[0]));
   }
+  virtual void UploadToShader(int32_t handle, GLEffect *effect) override {
+    effect->UploadVariable(handle, glm::value_ptr(value_[0]));
+  }
 private:
   std::vector<T> value_;
 };
@@ -8,8 +8,10 @@
 namespace mineola {
 
 class GraphicsBuffer;
+class GeometryAllocation;
 class GLEffect;
 class VertexArrayObject;
+class TriangleMesh;
 
 namespace vertex_type {
 
@@ -20,6 +22,13 @@ enum Semantics {
 
 enum { RESERVED_SEMANTICS_NUM = 12 };
 
+// per-instance model matrix of instanced draws, a mat4 taking 4 locations from here
+enum { INSTANCE_MODEL_MAT_BIND_LOCATION = 12 };
+
+inline const char *GetInstanceModelMatString() {
+  return "_instance_model_mat";
+}
+
 enum StreamType { VST_VERTEX, VST_INDEX };
 
 inline const char *GetSemanticsString(uint32_t semantics) {
@@ -75,6 +84,10 @@ struct VertexStream {
   uint32_t offset{0};
   uint32_t force_stride{0};
   std::shared_ptr<GraphicsBuffer> buffer_ptr;
+  // set if the data lives in the geometry arena, buffer_ptr and offset then follow the
+  // allocation when the arena is defragmented
+  std::shared_ptr<GeometryAllocation> allocation;
+  uint32_t allocation_offset{0};  // of the stream data within the allocation
 };
 
 class VertexArrayObject : Noncopyable {
@@ -98,20 +111,32 @@ public:
   void SetIndexStream(std::shared_ptr<VertexStream> index_stream);
 
   std::vector<std::shared_ptr<VertexStream>> &VertexStreams();
+  const std::shared_ptr<VertexStream> &IndexStream() const;
   void MarkVertexUpdated();  // MUST call after updating vertex data
   bool Draw();
+  // count instances, reading one mat4 per instance from instance_buffer at offset
+  bool DrawInstanced(GraphicsBuffer &instance_buffer, uint32_t offset, uint32_t count);
 
   int &PrimitiveType();
 
   void SetIndexed(bool indexed);
+  bool IsIndexed() const;
+
+  // optional CPU copy of the triangles, for ray casting
+  void SetTriangleMesh(std::shared_ptr<TriangleMesh> mesh);
+  const std::shared_ptr<TriangleMesh> &GetTriangleMesh() const;
 
 protected:
+  // rebuilds the vao if streams changed or arena allocations moved
+  bool PrepareVAO();
   bool UpdateVAO();
 
   std::vector<std::shared_ptr<VertexStream>> vertex_stream_ptrs_;
   std::shared_ptr<VertexStream> index_stream_ptr_;
   std::shared_ptr<VertexArrayObject> vao_ptr_;
+  std::shared_ptr<TriangleMesh> triangle_mesh_;
   bool vao_updated_;
+  uint32_t arena_generation_;
   int primitive_type_;
   bool is_indexed_;
 };
@@ -1,5 +1,6 @@
 #include "prefix.h"
 #include <vector>
+#include <algorithm>
 #include <glm/gtc/type_ptr.hpp>
 #include <mineola/AABB.h>
 
@@ -40,17 +41,44 @@ AABB &AABB::Combine(const AABB &other) {
 }
 
 AABB &AABB::Transform(const glm::mat4 &mat) {
-  auto lb = glm::vec3(std::numeric_limits<float>::max());
-  auto ub = glm::vec3(std::numeric_limits<float>::lowest());
-
-  auto corners = Corners();
-  for(auto &corner : corners) {
-    corner = mat * glm::vec4(corner, 1.f);
-    lb = glm::min(lb, corner);
-    ub = glm::max(ub, corner);
-  }
-  lb_ = lb;
-  ub_ = ub;
+  // transform center and project half extent onto the transformed axes (Arvo),
+  // equivalent to bounding all 8 transformed corners
+  glm::vec3 center = mat * glm::vec4(Center(), 1.f);
+  glm::vec3 half_extent = Extent() * 0.5f;
+  glm::mat3 abs_mat(
+    glm::abs(glm::vec3(mat[0])),
+    glm::abs(glm::vec3(mat[1])),
+    glm::abs(glm::vec3(mat[2])));
+  half_extent = abs_mat * half_extent;
+
+  lb_ = center - half_extent;
+  ub_ = center + half_extent;
   return *this;
 }
+
+float AABB::SurfaceArea() const {
+  auto extent = Extent();
+  return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+bool AABB::Overlaps(const AABB &other) const {
+  return lb_.x <= other.ub_.x && ub_.x >= other.lb_.x &&
+    lb_.y <= other.ub_.y && ub_.y >= other.lb_.y &&
+    lb_.z <= other.ub_.z && ub_.z >= other.lb_.z;
+}
+
+bool AABB::IntersectRay(const glm::vec3 &origin, const glm::vec3 &inv_dir, float t_max,
+  float &t_near) const {
+  glm::vec3 t0 = (lb_ - origin) * inv_dir;
+  glm::vec3 t1 = (ub_ - origin) * inv_dir;
+  glm::vec3 t_min_axis = glm::min(t0, t1);
+  glm::vec3 t_max_axis = glm::max(t0, t1);
+  float t_enter = std::max(std::max(t_min_axis.x, t_min_axis.y), std::max(t_min_axis.z, 0.f));
+  float t_exit = std::min(std::min(t_max_axis.x, t_max_axis.y), std::min(t_max_axis.z, t_max));
+  if (t_enter > t_exit) {
+    return false;
+  }
+  t_near = t_enter;
+  return true;
+}
 }
@@ -119,5 +119,10 @@ void AnimatedEntity::FrameMove(double time, double frame_time) {
 void AnimatedEntity::PreRender() {}
 void AnimatedEntity::PostRender() {}
 void AnimatedEntity::Destroy() {}
+bool AnimatedEntity::IsThreadSafe() const { return thread_safe_; }
+
+void AnimatedEntity::SetThreadSafe(bool thread_safe) {
+  thread_safe_ = thread_safe;
+}
 
 }
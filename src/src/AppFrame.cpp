@@ -1,9 +1,11 @@
 #include "prefix.h"
 #include <mineola/AppFrame.h>
+#include <memory>
 #include <mineola/glutility.h>
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #include <mineola/AppHelper.h>
+#include <mineola/FramePipeline.h>
 
 namespace {
 using namespace mineola;
@@ -115,34 +117,51 @@ void AppFrame::Run(uint32_t width, uint32_t height) {
   ResizeScreen(window_width_, window_height_);
   auto &en = GetEngine();
 
+  std::unique_ptr<FramePipeline> pipeline;
+  if (pipelined_) {
+    pipeline = std::make_unique<FramePipeline>();
+  }
+
   //main loop
   running_ = true;
   while( running_ ) {
-    ///////////////////////////////////////////
-    // call frame move before rendering
-    FrameMove();
-    ///////////////////////////////////////////
-
-    ///////////////////////////////////////////
-    // render
-    Render();
-    ///////////////////////////////////////////
-
-    // Swap front and back rendering buffers
-    glfwSwapBuffers(window_);
-
-    // Pool events
+    if (pipeline) {
+      // render this frame while the next one is simulated
+      pipeline->BeginFrame();
+      glfwSwapBuffers(window_);
+      pipeline->EndFrame();
+    } else {
+      ///////////////////////////////////////////
+      // call frame move before rendering
+      FrameMove();
+      ///////////////////////////////////////////
+
+      ///////////////////////////////////////////
+      // render
+      Render();
+      ///////////////////////////////////////////
+
+      // Swap front and back rendering buffers
+      glfwSwapBuffers(window_);
+    }
+
+    // Pool events, after the simulation thread is done
     glfwPollEvents();
 
     // Check if ESC key was pressed or window was closed
     running_ = running_ && !glfwWindowShouldClose(window_) && !en.TerminationSignaled();
   }
+  pipeline.reset();
 
   ReleaseScene();
   ReleaseEngine();
   glfwTerminate();
 }
 
+void AppFrame::SetPipelined(bool pipelined) {
+  pipelined_ = pipelined;
+}
+
 bool AppFrame::InitScene() {
   return true;
 }
@@ -189,7 +189,7 @@ bool InitEngine() {
   mat->diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
   mat->specular = glm::vec3(0.2f, 0.2f, 0.2f);
   mat->emit = glm::vec3(0.f, 0.f, 0.f);
-  mat->texture_slots["diffuse_sampler"] = {"mineola:texture:fallback"};
+  mat->SetTextureSlot("diffuse_sampler", {"mineola:texture:fallback"});
   en.ResrcMgr().Add("mineola:material:fallback", bd_cast<Resource>(mat));
 
   return true;
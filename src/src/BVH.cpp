@@ -0,0 +1,205 @@
+#include "prefix.h"
+#include <mineola/BVH.h>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+enum : uint32_t { kNumBins = 16 };
+
+float AxisValue(const glm::vec3 &v, uint32_t axis) {
+  return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+void Grow(std::optional<mineola::AABB> &box, const mineola::AABB &other) {
+  if (box) {
+    box->Combine(other);
+  } else {
+    box = other;
+  }
+}
+
+}
+
+namespace mineola {
+
+BVH::BVH() : need_refit_(false) {
+}
+
+BVH::~BVH() {
+}
+
+void BVH::Clear() {
+  nodes_.clear();
+  item_leaves_.clear();
+  need_refit_ = false;
+}
+
+bool BVH::Empty() const {
+  return nodes_.empty();
+}
+
+size_t BVH::NumNodes() const {
+  return nodes_.size();
+}
+
+void BVH::Build(const std::vector<std::optional<AABB>> &item_bounds) {
+  Clear();
+  item_leaves_.assign(item_bounds.size(), kInvalidIndex);
+
+  std::vector<uint32_t> items;
+  items.reserve(item_bounds.size());
+  for (uint32_t idx = 0; idx < (uint32_t)item_bounds.size(); ++idx) {
+    if (item_bounds[idx]) {
+      items.push_back(idx);
+    }
+  }
+  if (items.empty()) {
+    return;
+  }
+
+  nodes_.reserve(items.size() * 2 - 1);
+  BuildRecursive(items, item_bounds, 0, (uint32_t)items.size(), kInvalidIndex);
+}
+
+uint32_t BVH::BuildRecursive(std::vector<uint32_t> &items,
+  const std::vector<std::optional<AABB>> &item_bounds,
+  uint32_t begin, uint32_t end, uint32_t parent) {
+
+  uint32_t node_idx = (uint32_t)nodes_.size();
+  nodes_.emplace_back();
+  nodes_[node_idx].parent = parent;
+
+  AABB bounds = *item_bounds[items[begin]];
+  glm::vec3 first_center = bounds.Center();
+  AABB centroid_bounds(first_center, first_center);
+  for (uint32_t i = begin + 1; i < end; ++i) {
+    const auto &item_box = *item_bounds[items[i]];
+    bounds.Combine(item_box);
+    glm::vec3 center = item_box.Center();
+    centroid_bounds.Combine(AABB(center, center));
+  }
+  nodes_[node_idx].bounds = bounds;
+
+  if (end - begin == 1) {
+    nodes_[node_idx].item = items[begin];
+    item_leaves_[items[begin]] = node_idx;
+    return node_idx;
+  }
+
+  // split along the axis of largest centroid spread
+  glm::vec3 spread = centroid_bounds.Extent();
+  uint32_t axis = 0;
+  if (spread.y > spread.x) axis = 1;
+  if (spread.z > AxisValue(spread, axis)) axis = 2;
+  float axis_min = AxisValue(centroid_bounds.lb_, axis);
+  float axis_extent = AxisValue(spread, axis);
+
+  uint32_t mid = begin + (end - begin) / 2;
+  if (axis_extent > 0.f) {
+    // binned SAH: bin items by centroid, evaluate the cost of each bin boundary
+    struct Bin {
+      std::optional<AABB> bounds;
+      uint32_t count = 0;
+    } bins[kNumBins];
+
+    float bin_scale = kNumBins / axis_extent;
+    auto bin_of = [&](uint32_t item) {
+      float c = AxisValue(item_bounds[item]->Center(), axis);
+      return std::min<uint32_t>((uint32_t)((c - axis_min) * bin_scale), kNumBins - 1);
+    };
+    for (uint32_t i = begin; i < end; ++i) {
+      auto &bin = bins[bin_of(items[i])];
+      Grow(bin.bounds, *item_bounds[items[i]]);
+      ++bin.count;
+    }
+
+    // right-to-left sweep for the right side areas
+    float right_area[kNumBins] = {};
+    uint32_t right_count[kNumBins] = {};
+    std::optional<AABB> accum;
+    uint32_t count = 0;
+    for (uint32_t b = kNumBins - 1; b > 0; --b) {
+      if (bins[b].bounds) {
+        Grow(accum, *bins[b].bounds);
+      }
+      count += bins[b].count;
+      right_area[b] = accum ? accum->SurfaceArea() : 0.f;
+      right_count[b] = count;
+    }
+
+    float best_cost = std::numeric_limits<float>::max();
+    uint32_t best_split = 0;
+    accum.reset();
+    count = 0;
+    for (uint32_t b = 0; b + 1 < kNumBins; ++b) {
+      if (bins[b].bounds) {
+        Grow(accum, *bins[b].bounds);
+      }
+      count += bins[b].count;
+      if (count == 0 || right_count[b + 1] == 0) {
+        continue;
+      }
+      float cost = count * accum->SurfaceArea() + right_count[b + 1] * right_area[b + 1];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_split = b;
+      }
+    }
+
+    if (best_cost < std::numeric_limits<float>::max()) {
+      auto iter = std::partition(items.begin() + begin, items.begin() + end,
+        [&](uint32_t item) { return bin_of(item) <= best_split; });
+      mid = (uint32_t)(iter - items.begin());
+    }
+  }
+
+  if (mid == begin || mid == end) {
+    // coincident centroids, split in the middle
+    mid = begin + (end - begin) / 2;
+  }
+
+  uint32_t left = BuildRecursive(items, item_bounds, begin, mid, node_idx);
+  uint32_t right = BuildRecursive(items, item_bounds, mid, end, node_idx);
+  nodes_[node_idx].left = left;
+  nodes_[node_idx].right = right;
+  return node_idx;
+}
+
+void BVH::UpdateItem(uint32_t item, const AABB &bounds) {
+  if (item >= item_leaves_.size() || item_leaves_[item] == kInvalidIndex) {
+    return;
+  }
+  auto &leaf = nodes_[item_leaves_[item]];
+  if (leaf.bounds.lb_ == bounds.lb_ && leaf.bounds.ub_ == bounds.ub_) {
+    return;
+  }
+  leaf.bounds = bounds;
+
+  // flag the path to the root, stop at already flagged ancestors
+  uint32_t node_idx = leaf.parent;
+  while (node_idx != kInvalidIndex && !nodes_[node_idx].dirty) {
+    nodes_[node_idx].dirty = true;
+    node_idx = nodes_[node_idx].parent;
+  }
+  need_refit_ = true;
+}
+
+void BVH::Refit() {
+  if (!need_refit_) {
+    return;
+  }
+  // children come after parents, a reverse sweep visits them first
+  for (size_t idx = nodes_.size(); idx-- > 0;) {
+    auto &node = nodes_[idx];
+    if (!node.dirty) {
+      continue;
+    }
+    node.bounds = nodes_[node.left].bounds;
+    node.bounds.Combine(nodes_[node.right].bounds);
+    node.dirty = false;
+  }
+  need_refit_ = false;
+}
+
+} // namespace
@@ -8,6 +8,20 @@
 #include <mineola/UniformBlock.h>
 #include <mineola/Viewport.h>
 
+namespace {
+
+glm::mat4 ProjMatrix(bool perspective, float fovy, float aspect_ratio, float near_plane,
+  float far_plane, float left, float right, float bottom, float top) {
+  if (perspective) {
+    return glm::perspective(fovy, aspect_ratio, near_plane, far_plane);
+  }
+  float center = (bottom + top) * .5f;
+  float diff = (top - center) / aspect_ratio;
+  return glm::ortho(left, right, center - diff, center + diff, near_plane, far_plane);
+}
+
+}
+
 namespace mineola {
 
 Camera::Camera(bool perspective)
@@ -29,14 +43,39 @@ Camera::~Camera() {
 void Camera::Activate() {
   auto builtin_ub = Engine::Instance().BuiltinUniformBlock().lock();
   if (builtin_ub) {
-    builtin_ub->UpdateVariable("_view_mat", glm::value_ptr(view_mat_));
-    builtin_ub->UpdateVariable("_view_mat_inv", glm::value_ptr(glm::inverse(view_mat_)));
-    builtin_ub->UpdateVariable("_proj_mat", glm::value_ptr(proj_mat_));
-    builtin_ub->UpdateVariable("_proj_mat_inv", glm::value_ptr(glm::inverse(proj_mat_)));
-    builtin_ub->UpdateVariable("_proj_view_mat", glm::value_ptr(proj_mat_ * view_mat_));
+    const auto &view_mat = RenderViewMatrix();
+    const auto &proj_mat = RenderProjMatrix();
+    builtin_ub->UpdateVariable(UniformBlock::VIEW_MAT, glm::value_ptr(view_mat));
+    builtin_ub->UpdateVariable(UniformBlock::VIEW_MAT_INV, glm::value_ptr(glm::inverse(view_mat)));
+    builtin_ub->UpdateVariable(UniformBlock::PROJ_MAT, glm::value_ptr(proj_mat));
+    builtin_ub->UpdateVariable(UniformBlock::PROJ_MAT_INV, glm::value_ptr(glm::inverse(proj_mat)));
+    builtin_ub->UpdateVariable(UniformBlock::PROJ_VIEW_MAT, glm::value_ptr(proj_mat * view_mat));
   }
 }
 
+void Camera::Snapshot() {
+  // the simulation thread is stopped, resizes during the last frame catch up here
+  if (snapshot_ && snapshot_->resized && !using_custom_proj_matrix_) {
+    aspect_ratio_ = snapshot_->aspect_ratio;
+    proj_mat_ = ProjMatrix(perspective_, fovy_, aspect_ratio_, near_, far_,
+      left_, right_, bottom_, top_);
+  }
+  snapshot_ = RenderSnapshot{view_mat_, proj_mat_, fovy_, near_, far_, aspect_ratio_,
+    left_, right_, bottom_, top_, using_custom_proj_matrix_, false};
+}
+
+void Camera::ClearSnapshot() {
+  snapshot_.reset();
+}
+
+const glm::mat4 &Camera::RenderViewMatrix() const {
+  return snapshot_ ? snapshot_->view_mat : view_mat_;
+}
+
+const glm::mat4 &Camera::RenderProjMatrix() const {
+  return snapshot_ ? snapshot_->proj_mat : proj_mat_;
+}
+
 void Camera::SetProjParams(float fovy, float near_plane, float far_plane) {
   fovy_ = fovy;
   near_ = near_plane;
@@ -91,15 +130,20 @@ void Camera::SetProjMatrix(const glm::mat4 &proj_mat) {
 
 void Camera::OnSize(const Viewport *viewport) {
   if (viewport && viewport->height != 0) {
-    if (!using_custom_proj_matrix_) {
-      aspect_ratio_ = (float)viewport->width / viewport->height;
-      if (perspective_) {
-        proj_mat_ = glm::perspective(fovy_, aspect_ratio_, near_, far_);
-      } else {
-        float center = (bottom_ + top_) * .5f;
-        float diff = (top_ - center) / aspect_ratio_;
-        proj_mat_ = glm::ortho(left_, right_, center - diff, center + diff, near_, far_);
+    const float aspect_ratio = (float)viewport->width / viewport->height;
+    if (snapshot_) {
+      // the members belong to the simulation thread, project with the snapshotted parameters
+      auto &snap = *snapshot_;
+      if (!snap.using_custom_proj_matrix) {
+        snap.aspect_ratio = aspect_ratio;
+        snap.resized = true;
+        snap.proj_mat = ProjMatrix(perspective_, snap.fovy, aspect_ratio, snap.near_plane, snap.far_plane,
+          snap.left, snap.right, snap.bottom, snap.top);
       }
+    } else if (!using_custom_proj_matrix_) {
+      aspect_ratio_ = aspect_ratio;
+      proj_mat_ = ProjMatrix(perspective_, fovy_, aspect_ratio_, near_, far_,
+        left_, right_, bottom_, top_);
     }
   }
 }
@@ -0,0 +1,22 @@
+#include "prefix.h"
+#include <mineola/CommandList.h>
+
+namespace mineola {
+
+void CommandList::Clear() {
+  commands.clear();
+  instance_mats.clear();
+}
+
+void CommandList::Append(const CommandList &other) {
+  const uint32_t base = (uint32_t)instance_mats.size();
+  instance_mats.insert(instance_mats.end(), other.instance_mats.begin(), other.instance_mats.end());
+  for (auto command : other.commands) {
+    if (command.op == kDrawInstanced) {
+      command.first += base;
+    }
+    commands.push_back(command);
+  }
+}
+
+} // namespace
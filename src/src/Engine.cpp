@@ -1,18 +1,27 @@
 #include "prefix.h"
 #include <mineola/Engine.h>
+#include <cassert>
 #include <cstring>
 #include <algorithm>
 #include <ctime>
+#include <typeinfo>
 #include <mineola/glutility.h>
 #include <mineola/GLEffect.h>
 #include <mineola/Framebuffer.h>
+#include <mineola/GraphicsBuffer.h>
+#include <mineola/RingBuffer.h>
+#include <mineola/ShaderParser.h>
+#include <mineola/JobSystem.h>
 #include <mineola/TextureHelper.h>
 #include <mineola/Material.h>
 #include <mineola/Renderable.h>
 #include <mineola/SceneNode.h>
+#include <mineola/Skin.h>
 #include <mineola/UniformBlock.h>
 #include <mineola/Light.h>
 #include <mineola/Viewport.h>
+#include <mineola/Frustum.h>
+#include <mineola/TriangleMesh.h>
 #include <mineola/ReservedTextureUnits.h>
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -20,41 +29,27 @@
 
 namespace mineola {
 
-using RenderQueue = std::vector<std::pair<glm::mat4, std::shared_ptr<Renderable>>>;
-
-namespace {
-  bool RenderableLess(
-    const std::pair<glm::mat4, std::shared_ptr<Renderable>> &r_a,
-    const std::pair<glm::mat4, std::shared_ptr<Renderable>> &r_b) {
-    return r_a.second->QueueId() < r_b.second->QueueId();
-  }
-
-  RenderQueue GenerateRenderQueue(const SceneNode &root) {
-    RenderQueue result;
-    root.DFTraverse([&result](const SceneNode &node) {
-      // retrieve current world transform
-      auto world_rbt = node.WorldRbt();
-      auto world_scale = node.WorldScale();
-
-      // add renderables to render list
-      auto model_matrix = glm::scale(world_rbt.ToMatrix(), world_scale);
-      for (auto &renderable : node.Renderables())
-        result.push_back({model_matrix, renderable});
-    });
-    std::sort(result.begin(), result.end(), RenderableLess);
-    return result;
-  };
-}
-
 Engine::Engine()
   :current_viewport_(0),
   time_(0.0), frame_time_(0.0),
+  render_time_(0.0), render_frame_time_(0.0),
   override_effect_(false),
   override_camera_(false),
   override_render_target_(false),
+  effect_bound_(false),
   ext_texture_loader_(nullptr),
   ext_texture_mem_loader_(nullptr),
-  terminate_signaled_(false) {
+  draw_ring_base_(0),
+  draw_ring_stride_(0),
+  instance_buffer_capacity_(0),
+  instance_offset_(0),
+  instance_cursor_(0),
+  joint_ring_written_(false),
+  terminate_signaled_(false),
+  retain_cpu_geometry_(false),
+  auto_instancing_(true),
+  pipelined_(false),
+  async_effect_linking_(false) {
   timer_.reset(new Timer);
 
   root_node_ = std::make_shared<SceneNode>();
@@ -75,6 +70,10 @@ RenderStateManager &Engine::RenderStateMgr() {
   return render_state_mgr_;
 }
 
+GeometryArena &Engine::GeomArena() {
+  return geometry_arena_;
+}
+
 ManagerBase<Entity> &Engine::EntityMgr() {
   return entity_mgr_;
 }
@@ -109,6 +108,25 @@ void Engine::ChangeEffect(const std::string &name, bool force) {
   }
   p->ApplyRenderStates();
   p->Bind();
+  effect_bound_ = true;
+
+  //upload active camera info
+  if (current_camera_.second)
+    current_camera_.second->Activate();
+}
+
+void Engine::ChangeEffect(const std::shared_ptr<GLEffect> &effect, bool force) {
+  if (override_effect_)  // lock effect in override mode
+    return;
+
+  if (!force && effect_bound_ && current_effect_.second == effect)
+    return;
+
+  current_effect_.first.clear();  // name unknown, queried when needed
+  current_effect_.second = effect;
+  effect->ApplyRenderStates();
+  effect->Bind();
+  effect_bound_ = true;
 
   //upload active camera info
   if (current_camera_.second)
@@ -235,23 +253,39 @@ void Engine::FrameMove() {
 
   frame_move_sig_(now, frame_time_);
 
+  // thread safe entities are updated on the job system once the others are done
+  parallel_entities_.clear();
   entity_mgr_.Transform(
     [now, this](const std::string &, std::shared_ptr<Entity> &entity) {
-      entity->FrameMove(now, frame_time_);
+      if (entity->IsThreadSafe()) {
+        parallel_entities_.push_back(entity.get());
+      } else {
+        entity->FrameMove(now, frame_time_);
+      }
+  });
+  JobSystem::Instance().ParallelFor(0, parallel_entities_.size(), kEntitiesPerJob,
+    [now, this](size_t idx) {
+      parallel_entities_[idx]->FrameMove(now, frame_time_);
   });
 
   time_ = now;
-  auto builtin_ub = builtin_uniform_block_.lock();
-  if (builtin_ub) {
-    builtin_ub->UpdateVariable("_time", glm::value_ptr(glm::vec4((float)time_)));
-    builtin_ub->UpdateVariable("_delta_time", glm::value_ptr(glm::vec4((float)frame_time_)));
-  }
 
   // update scenenode tree
   root_node_->UpdateSubtreeWorldTforms();
 }
 
 void Engine::Render() {
+  PrepareRender();
+  RenderPrepared();
+  FinishRender();
+}
+
+void Engine::PrepareRender() {
+  render_time_ = time_;
+  render_frame_time_ = frame_time_;
+
+  // swap in effects linked since the last frame, before draw packets are resolved
+  FinishPendingEffects(false);
 
    // call entity prerender
   entity_mgr_.Transform([](const std::string &, std::shared_ptr<Entity> &entity) {
@@ -260,25 +294,73 @@ void Engine::Render() {
 
   auto builtin_ub = builtin_uniform_block_.lock();
   if (builtin_ub) {
-    // activate builtin uniform block
-    builtin_ub->Activate();
+    builtin_ub->UpdateVariable(UniformBlock::TIME,
+      glm::value_ptr(glm::vec4((float)render_time_)));
+    builtin_ub->UpdateVariable(UniformBlock::DELTA_TIME,
+      glm::value_ptr(glm::vec4((float)render_frame_time_)));
     // update light uniforms
-    root_node_->DFTraverse([&builtin_ub](SceneNode &node) {
+    root_node_->DFTraverse([&builtin_ub](const SceneNode &node) {
       for (auto &light : node.Lights()) {
         light->UpdateUniforms(builtin_ub.get());
       }
     });
   }
 
+  if (pipelined_) {
+    camera_mgr_.Transform([](const std::string &, std::shared_ptr<Camera> &camera) {
+      camera->Snapshot();
+    });
+  }
+
+  // regenerate draw list only if the scene structure changed, then refresh transforms and order
+  if (!render_queue_.IsValid()) {
+    render_queue_.Rebuild(*root_node_);
+  }
+  render_queue_.Update(current_camera_.second.get());
+  // resolve effects and materials here, recording threads only read them
+  frame_skins_.clear();
+  for (size_t idx = 0; idx < render_queue_.Size(); ++idx) {
+    auto renderable = render_queue_[idx].renderable;
+    renderable->UpdateDrawPackets();
+    renderable->PrepareFrame(render_frame_time_);
+    if (renderable->IsSkinned()) {
+      frame_skins_.push_back(renderable->GetSkin().get());
+    }
+  }
+
+  // skins shared by several renderables, e.g. the primitives of a glTF mesh, and drawn in
+  // several passes compute their palettes once
+  std::sort(frame_skins_.begin(), frame_skins_.end());
+  frame_skins_.erase(std::unique(frame_skins_.begin(), frame_skins_.end()), frame_skins_.end());
+  JobSystem::Instance().ParallelFor(0, frame_skins_.size(), 1, [this](size_t idx) {
+    frame_skins_[idx]->PrepareFrame();
+  });
+}
+
+void Engine::RenderPrepared() {
+  // objects may have been bound behind the state manager's back since the last frame
+  render_state_mgr_.InvalidateBindings();
+
+  auto builtin_ub = builtin_uniform_block_.lock();
+  if (builtin_ub) {
+    // activate builtin uniform block
+    builtin_ub->Activate();
+  }
+
   // clear current camera, effect, framebuffer at the beginning of a pass
   current_camera_.first.clear();
   current_effect_.first.clear();
+  effect_bound_ = false;
+
+  // the first instanced batch of the frame takes fresh buffer storage
+  instance_cursor_ = instance_buffer_capacity_;
 
   if (current_camera_.second)
     current_camera_.second->Activate();
 
-  // refresh scene tree and generate render list
-  RenderQueue render_queue = GenerateRenderQueue(*root_node_);
+  WriteDrawUniforms();
+  WriteJointPalettes();
+
   // cache last non-override camera and render target
   std::string previous_camera = "";
   bool need_restore_camera = false;
@@ -340,9 +422,24 @@ void Engine::Render() {
     }
 
     if (!pass.override_material.empty()) {
-      override_material_ = pass.override_material;
+      override_material_ = bd_cast<Material>(resrc_mgr_.Find(pass.override_material));
+      if (!override_material_)
+        override_material_ = bd_cast<Material>(resrc_mgr_.Find("mineola:material:fallback"));
     } else {
-      override_material_.clear();
+      override_material_.reset();
+    }
+
+    // cull against the frustum of the camera active in this pass
+    std::optional<Frustum> frustum;
+    if (pass.frustum_cull && current_camera_.second) {
+      const auto &cam = current_camera_.second;
+      frustum = Frustum(cam->RenderProjMatrix() * cam->RenderViewMatrix());
+    }
+    render_queue_.Cull(frustum ? &*frustum : nullptr);
+    if (frustum && pass.occlusion_cull) {
+      const auto &cam = current_camera_.second;
+      render_queue_.CullOccluded(occlusion_culler_,
+        cam->RenderProjMatrix() * cam->RenderViewMatrix());
     }
 
     CHKGLERR
@@ -353,26 +450,9 @@ void Engine::Render() {
 
     CHKGLERR
 
-    // actual rendering
-    for (auto iter = render_queue.begin(); iter != render_queue.end(); ++iter) {
-      if (!(pass.layer_mask & iter->second->LayerMask())) {  // skip masked objects
-        continue;
-      }
-
-      if (pass.sfx == RenderPass::SFX_PASS_SHADOWMAP && !iter->second->GetShadowmapEffectName()) {
-        // In shadowmap pass, skip objects that don't cast shadow.
-        continue;
-      }
-
-      CHKGLERR
-      iter->second->PreRender(frame_time_, pass_idx);
-      current_effect_.second->UploadVariable("_model_mat", glm::value_ptr(iter->first));
-      int tex_unit = kShadowmap0TextureUnit;
-      current_effect_.second->UploadVariable("_shadowmap0", &tex_unit);
-      tex_unit = kEnvLightProbe0TextureUnit;
-      current_effect_.second->UploadVariable("_env_light_probe_0", &tex_unit);
-      iter->second->Draw(frame_time_, pass_idx);
-    }
+    // record the draws over ranges of the queue, then issue them on this thread
+    RecordPass(pass_idx);
+    ReplayPass(pass_idx, builtin_ub.get());
 
     pass_end_sig_(pass_idx);
   }
@@ -387,11 +467,42 @@ void Engine::Render() {
   if (need_restore_camera)
     ChangeCamera(previous_camera.c_str(), false);
 
+  if (draw_ring_stride_ > 0) {
+    draw_ring_->EndFrame();
+  }
+  if (joint_ring_written_) {
+    joint_ring_->EndFrame();
+  }
+}
+
+void Engine::FinishRender() {
   entity_mgr_.Transform([](const std::string &, std::shared_ptr<Entity> &entity) {
   	entity->PostRender();
   });
 }
 
+void Engine::SetPipelined(bool pipelined, std::thread::id simulation_thread) {
+  pipelined_ = pipelined;
+  simulation_thread_ = pipelined_ ? simulation_thread : std::thread::id();
+  if (!pipelined_) {
+    camera_mgr_.Transform([](const std::string &, std::shared_ptr<Camera> &camera) {
+      camera->ClearSnapshot();
+    });
+  }
+}
+
+bool Engine::Pipelined() const {
+  return pipelined_;
+}
+
+void Engine::SetProgramCacheDir(const std::string &dir) {
+  program_cache_dir_ = dir;
+}
+
+const std::string &Engine::ProgramCacheDir() const {
+  return program_cache_dir_;
+}
+
 // create default framebuffer, etc.
 void Engine::Init() {
   render_state_mgr_ = {};
@@ -404,7 +515,8 @@ void Engine::Init() {
   override_effect_ = false;
   override_camera_ = false;
   override_render_target_ = false;
-  override_material_ = "";
+  override_material_.reset();
+  effect_bound_ = false;
 
   ext_texture_loader_ = nullptr;
   ext_texture_mem_loader_ = nullptr;
@@ -418,36 +530,35 @@ void Engine::Init() {
   // Note we're using std140 layout for builtin uniform buffer to save the effort of querying
   // member layout.
   // Make sure the offsets in SetVariable calls are correctly padded
-  static const std::vector<std::pair<std::string, uint32_t>> builtin_uniforms = {
-    {"_view_mat", 16 * (uint32_t)sizeof(float)},
-    {"_view_mat_inv", 16 * (uint32_t)sizeof(float)},
-    {"_proj_mat", 16 * (uint32_t)sizeof(float)},
-    {"_proj_mat_inv", 16 * (uint32_t)sizeof(float)},
-    {"_proj_view_mat", 16 * (uint32_t)sizeof(float)},
-    {"_light_view_mat_0", 16 * (uint32_t)sizeof(float)},
-    {"_light_proj_mat_0", 16 * (uint32_t)sizeof(float)},
-    {"_viewport_size", 4 * (uint32_t)sizeof(float)},
-    {"_light_pos_0", 4 * (uint32_t)sizeof(float)},
-    {"_light_intensity_0", 4 * (uint32_t)sizeof(float)},
-    {"_light_pos_1", 4 * (uint32_t)sizeof(float)},
-    {"_light_intensity_1", 4 * (uint32_t)sizeof(float)},
-    {"_light_pos_2", 4 * (uint32_t)sizeof(float)},
-    {"_light_intensity_2", 4 * (uint32_t)sizeof(float)},
-    {"_light_pos_3", 4 * (uint32_t)sizeof(float)},
-    {"_light_intensity_3", 4 * (uint32_t)sizeof(float)},
-    {"_env_light_mat_0", 16 * (uint32_t)sizeof(float)},
-    {"_env_light_sh3_0[0]", 9 * 4 * (uint32_t)sizeof(float)},
-    {"_time", 4 * (uint32_t)sizeof(float)},
-    {"_delta_time", 4 * (uint32_t)sizeof(float)},
-  };
+  // Variables are registered in enum order so that their handles equal the enum values
   uint32_t size = 0;
-  for (auto &pair : builtin_uniforms) {
-    uniform_block->SetVariable(pair.first.c_str(), size, pair.second);
-    size += pair.second;
+  for (int var = 0; var < UniformBlock::NUM_BUILTIN_VARIABLES; ++var) {
+    uint32_t var_size = UniformBlock::GetBuiltinVariableSize(var);
+    uniform_block->SetVariable(UniformBlock::GetBuiltinVariableString(var), size, var_size);
+    size += var_size;
   }
   uniform_block->SetSize(size);
   resrc_mgr_.Add("mineola:uniformblock:builtin", bd_cast<Resource>(uniform_block));
   builtin_uniform_block_ = uniform_block;
+
+  instance_buffer_ = std::make_shared<GraphicsBuffer>(GraphicsBuffer::STREAM,
+    GraphicsBuffer::SEND, GraphicsBuffer::WRITE_ONLY, GL_ARRAY_BUFFER);
+  instance_buffer_capacity_ = 0;
+  instance_offset_ = 0;
+  instance_cursor_ = 0;
+
+  draw_ring_ = std::make_unique<RingBuffer>(GL_UNIFORM_BUFFER,
+    UniformBlock::GetSemanticsBindLocation(UniformBlock::DRAW_UNIFORMS));
+  draw_ring_stride_ = 0;
+  draw_fallback_buffer_ = std::make_shared<GraphicsBuffer>(GraphicsBuffer::STREAM,
+    GraphicsBuffer::SEND, GraphicsBuffer::WRITE_ONLY, GL_UNIFORM_BUFFER,
+    UniformBlock::GetSemanticsBindLocation(UniformBlock::DRAW_UNIFORMS));
+  joint_ring_ = std::make_unique<RingBuffer>(GL_UNIFORM_BUFFER,
+    UniformBlock::GetSemanticsBindLocation(UniformBlock::JOINT_UNIFORMS));
+  joint_ring_written_ = false;
+  joint_fallback_buffer_ = std::make_shared<GraphicsBuffer>(GraphicsBuffer::STREAM,
+    GraphicsBuffer::SEND, GraphicsBuffer::WRITE_ONLY, GL_UNIFORM_BUFFER,
+    UniformBlock::GetSemanticsBindLocation(UniformBlock::JOINT_UNIFORMS));
   render_state_mgr_.ApplyCurrentState();
 
   #ifdef MINEOLA_LOG_TO_FILE
@@ -468,11 +579,15 @@ void Engine::Start() {
 
 void Engine::Release() {
   root_node_ = std::make_shared<SceneNode>();
+  render_queue_.Clear();
   entity_mgr_.Transform([](const std::string &, std::shared_ptr<Entity> &entity) {
   	entity->Destroy();
   });
   entity_mgr_.Release();
+  pending_effects_.clear();
+  shader_parser::ClearCache();
   resrc_mgr_.Release();
+  geometry_arena_.Release();
   camera_mgr_.Release();
   current_effect_ = {"", nullptr};
   current_camera_ = {"", nullptr};
@@ -494,6 +609,18 @@ void Engine::Release() {
 
   effect_files_cache_.clear();
   builtin_uniform_block_.reset();
+  instance_buffer_.reset();
+  instance_buffer_capacity_ = 0;
+  instance_offset_ = 0;
+  instance_cursor_ = 0;
+  draw_ring_.reset();
+  draw_ring_stride_ = 0;
+  draw_fallback_buffer_.reset();
+  joint_ring_.reset();
+  joint_ring_written_ = false;
+  joint_fallback_buffer_.reset();
+  frame_skins_.clear();
+  frame_palette_offsets_.clear();
 
   #ifdef MINEOLA_LOG_TO_FILE
   log_.close();
@@ -575,6 +702,392 @@ std::shared_ptr<SceneNode> Engine::Scene() const {
   return root_node_;
 }
 
+void Engine::InvalidateRenderQueue() {
+  // the render thread draws from the queue while the simulation thread runs
+  assert(!pipelined_ || std::this_thread::get_id() != simulation_thread_);
+  render_queue_.Invalidate();
+}
+
+const RenderQueue &Engine::SceneRenderQueue() const {
+  return render_queue_;
+}
+
+std::optional<RayCastHit> Engine::RayCast(const glm::vec3 &origin, const glm::vec3 &dir,
+  float max_distance) const {
+  if (glm::dot(dir, dir) == 0.f) {
+    return std::nullopt;
+  }
+  glm::vec3 world_dir = glm::normalize(dir);
+
+  std::optional<RayCastHit> result;
+  render_queue_.QueryRay(origin, world_dir, max_distance,
+    [&](const RenderQueue::Item &item, float t_max) {
+      // object space ray keeps the world space parameterization
+      glm::mat4 inv_model = glm::inverse(item.model_mat);
+      glm::vec3 obj_origin = inv_model * glm::vec4(origin, 1.f);
+      glm::vec3 obj_dir = inv_model * glm::vec4(world_dir, 0.f);
+
+      auto renderable = item.renderable;
+      for (uint32_t va_idx = 0; va_idx < renderable->NumVertexArray(); ++va_idx) {
+        auto va = renderable->GetVertexArray((int)va_idx);
+        const auto &mesh = va->GetTriangleMesh();
+        TriangleHit hit;
+        if (mesh && mesh->IntersectRay(obj_origin, obj_dir, t_max, hit)) {
+          t_max = hit.t;
+          result = RayCastHit();
+          result->node = item.node;
+          result->renderable = renderable;
+          result->vertex_array = va_idx;
+          result->triangle = hit.triangle;
+          result->barycentric = hit.barycentric;
+          result->distance = hit.t;
+          result->position = origin + world_dir * hit.t;
+        }
+      }
+      return t_max;
+  });
+  return result;
+}
+
+void Engine::SetRetainCPUGeometry(bool retain) {
+  retain_cpu_geometry_ = retain;
+}
+
+bool Engine::RetainCPUGeometry() const {
+  return retain_cpu_geometry_;
+}
+
+void Engine::SetAutoInstancing(bool enable) {
+  auto_instancing_ = enable;
+}
+
+bool Engine::AutoInstancing() const {
+  return auto_instancing_;
+}
+
+void Engine::WriteDrawUniforms() {
+  draw_ring_stride_ = 0;
+  const uint32_t num_draws = (uint32_t)render_queue_.Size();
+  if (!draw_ring_ || num_draws == 0) {
+    return;
+  }
+
+  const uint32_t alignment = draw_ring_->Alignment();
+  const uint32_t stride = ((uint32_t)sizeof(glm::mat4) + alignment - 1) / alignment * alignment;
+  if (!draw_ring_->BeginFrame(stride * num_draws)) {
+    return;
+  }
+  auto base = draw_ring_->Allocate(stride * num_draws);
+  if (!base) {
+    draw_ring_->EndWrite();
+    return;
+  }
+
+  uint8_t *dst = (uint8_t *)draw_ring_->Pointer(*base);
+  for (uint32_t idx = 0; idx < num_draws; ++idx) {
+    memcpy(dst + idx * stride, glm::value_ptr(render_queue_[idx].model_mat), sizeof(glm::mat4));
+  }
+  draw_ring_->EndWrite();
+  draw_ring_base_ = *base;
+  draw_ring_stride_ = stride;
+}
+
+void Engine::WriteJointPalettes() {
+  joint_ring_written_ = false;
+  if (!joint_ring_ || frame_skins_.empty()) {
+    return;
+  }
+
+  const uint32_t alignment = joint_ring_->Alignment();
+  auto palette_bytes = [](const Skin *skin) {
+    return (uint32_t)(std::min<size_t>(skin->NumJoints(), Skin::kMaxJoints) * sizeof(glm::mat4));
+  };
+  auto align = [alignment](uint32_t size) {
+    return (size + alignment - 1) / alignment * alignment;
+  };
+  // draws bind a whole block from a palette's offset, which must stay within the allocation
+  const uint32_t block_bytes = Skin::kMaxJoints * (uint32_t)sizeof(glm::mat4);
+  uint32_t total = block_bytes;
+  for (const auto skin : frame_skins_) {
+    total += align(palette_bytes(skin));
+  }
+
+  std::optional<uint32_t> base;
+  if (joint_ring_->BeginFrame(total)) {
+    base = joint_ring_->Allocate(total);
+    if (!base) {
+      joint_ring_->EndWrite();
+    }
+  }
+  if (!base) {
+    return;  // skins upload their palettes per draw
+  }
+
+  uint8_t *dst = (uint8_t *)joint_ring_->Pointer(*base);
+  uint32_t offset = 0;
+  frame_palette_offsets_.resize(frame_skins_.size());
+  for (size_t idx = 0; idx < frame_skins_.size(); ++idx) {
+    const uint32_t bytes = palette_bytes(frame_skins_[idx]);
+    memcpy(dst + offset, frame_skins_[idx]->JointMatrices(), bytes);
+    frame_palette_offsets_[idx] = *base + offset;
+    offset += align(bytes);
+  }
+  joint_ring_->EndWrite();
+  joint_ring_written_ = true;
+}
+
+bool Engine::BindJointPalette(const Skin *skin) {
+  if (!joint_ring_written_) {
+    return false;
+  }
+  // skins outside this frame's render queue have no palette, rather than a stale offset
+  auto iter = std::lower_bound(frame_skins_.begin(), frame_skins_.end(), skin);
+  if (iter == frame_skins_.end() || *iter != skin) {
+    return false;
+  }
+  joint_ring_->Buffer().BindRange(frame_palette_offsets_[iter - frame_skins_.begin()],
+    Skin::kMaxJoints * (uint32_t)sizeof(glm::mat4));
+  return true;
+}
+
+void Engine::UploadJointPalette(const glm::mat4 *mats, uint32_t count) {
+  // the block is bound in full, fresh storage of its size takes the joints in front
+  const uint32_t block_bytes = Skin::kMaxJoints * (uint32_t)sizeof(glm::mat4);
+  joint_fallback_buffer_->SetData(block_bytes, nullptr);
+  joint_fallback_buffer_->UpdateData(0,
+    std::min<uint32_t>(count, Skin::kMaxJoints) * (uint32_t)sizeof(glm::mat4), mats);
+  joint_fallback_buffer_->BindBase();
+}
+
+void Engine::RecordPass(uint32_t pass_idx) {
+  // an override effect stays bound for the whole pass
+  GLEffect *override_effect = override_effect_ ? current_effect_.second.get() : nullptr;
+  const int64_t num_items = (int64_t)render_queue_.Size();
+  const int64_t num_ranges = std::max<int64_t>(1,
+    (num_items + kRecordRangeSize - 1) / kRecordRangeSize);
+  if ((int64_t)record_lists_.size() < num_ranges) {
+    record_lists_.resize(num_ranges);
+  }
+
+  // ranges record independently, instanced batches do not span them
+  JobSystem::Instance().ParallelFor(0, (size_t)num_ranges, 1, [&](size_t range) {
+    RecordRange(pass_idx, override_effect, range * kRecordRangeSize,
+      (size_t)std::min<int64_t>(num_items, (range + 1) * kRecordRangeSize),
+      record_lists_[range]);
+  });
+
+  pass_commands_.Clear();
+  for (int64_t range = 0; range < num_ranges; ++range) {
+    pass_commands_.Append(record_lists_[range]);
+  }
+}
+
+void Engine::RecordRange(uint32_t pass_idx, GLEffect *override_effect,
+  size_t begin, size_t end, CommandList &list) const {
+  list.Clear();
+  const auto &pass = render_passes_[pass_idx];
+  auto is_drawn = [&pass](const RenderQueue::Item &item) {
+    auto renderable = item.renderable;
+    if (!(pass.layer_mask & renderable->LayerMask())) {  // skip masked objects
+      return false;
+    }
+
+    if (pass.sfx == RenderPass::SFX_PASS_SHADOWMAP && !renderable->GetShadowmapEffectName()) {
+      // In shadowmap pass, skip objects that don't cast shadow.
+      return false;
+    }
+
+    // skip objects outside the camera view
+    return item.visible;
+  };
+  // subclasses and skinned renderables run their own PreRender() and Draw() on the GL thread
+  auto is_plain = [](Renderable &renderable) {
+    return typeid(renderable) == typeid(Renderable) && !renderable.IsSkinned();
+  };
+  auto push = [&list](CommandList::Op op, uint32_t item) -> CommandList::Command & {
+    list.commands.push_back({op, item});
+    return list.commands.back();
+  };
+  auto push_draws = [&list](const Renderable &renderable, CommandList::Op op,
+    uint32_t first, uint32_t count) {
+    for (const auto &packet : renderable.DrawPackets()) {
+      list.commands.push_back({op, 0, first, count, packet.vertex_array, packet.material});
+    }
+  };
+
+  const bool can_instance = auto_instancing_ && instance_buffer_;
+  GLEffect *bound_effect = override_effect;
+  for (size_t idx = begin; idx < end; ++idx) {
+    const auto &item = render_queue_[idx];
+    auto renderable = item.renderable;
+    if (!is_drawn(item)) {
+      continue;
+    }
+
+    if (!is_plain(*renderable)) {
+      push(CommandList::kRenderable, (uint32_t)idx).renderable = renderable;
+      bound_effect = nullptr;  // unknown until replayed
+      continue;
+    }
+
+    GLEffect *effect = override_effect ? override_effect : renderable->PassEffect(pass_idx).get();
+    if (effect != bound_effect) {
+      push(CommandList::kBindEffect, (uint32_t)idx).renderable = renderable;
+      bound_effect = effect;
+    }
+
+    // the queue is sorted by effect, material and geometry, so identical draws are adjacent
+    const uint32_t first = (uint32_t)list.instance_mats.size();
+    size_t next = idx + 1;
+    if (can_instance && effect->IsInstancingCapable()) {
+      list.instance_mats.push_back(item.model_mat);
+      for (; next < end; ++next) {
+        const auto &other = render_queue_[next];
+        if (!is_drawn(other)) {
+          continue;
+        }
+        if (!is_plain(*other.renderable) ||
+          !renderable->CanInstanceWith(*other.renderable, pass_idx)) {
+          break;
+        }
+        list.instance_mats.push_back(other.model_mat);
+      }
+    }
+
+    const uint32_t count = (uint32_t)list.instance_mats.size() - first;
+    if (count > 1) {
+      push_draws(*renderable, CommandList::kDrawInstanced, first, count);
+      idx = next - 1;
+    } else {
+      list.instance_mats.resize(first);
+      push(CommandList::kSetModelMat, (uint32_t)idx);
+      push_draws(*renderable, CommandList::kDraw, 0, 1);
+    }
+  }
+}
+
+void Engine::ReplayPass(uint32_t pass_idx, UniformBlock *builtin_ub) {
+  const auto &list = pass_commands_;
+  uint32_t instance_base = 0;
+  if (!list.instance_mats.empty()) {
+    if (!StreamInstanceMatrices(list.instance_mats.data(), (uint32_t)list.instance_mats.size())) {
+      return;
+    }
+    instance_base = instance_offset_;
+  }
+  // camera and light changes since the last draw go out as one upload
+  auto flush_builtin = [builtin_ub]() {
+    if (builtin_ub && builtin_ub->IsDirty()) {
+      builtin_ub->Flush();
+    }
+  };
+
+  if (current_effect_.second) {
+    BindDrawUniforms();
+  }
+  for (const auto &command : list.commands) {
+    switch (command.op) {
+    case CommandList::kBindEffect:
+      ChangeEffect(command.renderable->PassEffect(pass_idx), false);
+      BindDrawUniforms();
+      break;
+    case CommandList::kSetModelMat:
+      UploadModelMatrix(command.item);
+      break;
+    case CommandList::kDraw:
+      flush_builtin();
+      DoRender(*command.vertex_array, *command.material);
+      break;
+    case CommandList::kDrawInstanced:
+      flush_builtin();
+      DoRenderInstanced(*command.vertex_array, *command.material,
+        instance_base + command.first * (uint32_t)sizeof(glm::mat4), command.count);
+      break;
+    case CommandList::kRenderable:
+      command.renderable->PreRender(render_frame_time_, pass_idx);
+      flush_builtin();
+      BindDrawUniforms();
+      UploadModelMatrix(command.item);
+      command.renderable->Draw(render_frame_time_, pass_idx);
+      break;
+    }
+  }
+  CHKGLERR
+}
+
+void Engine::BindDrawUniforms() {
+  auto &effect = current_effect_.second;
+  if (draw_uniforms_.link_version != effect->LinkVersion()) {
+    draw_uniforms_.link_version = effect->LinkVersion();
+    draw_uniforms_.model_mat = effect->GetUniformHandle("_model_mat");
+    draw_uniforms_.shadowmap0 = effect->GetUniformHandle("_shadowmap0");
+    draw_uniforms_.env_light_probe0 = effect->GetUniformHandle("_env_light_probe_0");
+    draw_uniforms_.draw_block = effect->GetUniformBlockBinding(
+      UniformBlock::GetSemanticsString(UniformBlock::DRAW_UNIFORMS)) >= 0;
+  }
+  int tex_unit = kShadowmap0TextureUnit;
+  effect->UploadVariable(draw_uniforms_.shadowmap0, &tex_unit);
+  tex_unit = kEnvLightProbe0TextureUnit;
+  effect->UploadVariable(draw_uniforms_.env_light_probe0, &tex_unit);
+}
+
+void Engine::UploadModelMatrix(uint32_t item) {
+  auto &effect = current_effect_.second;
+  const auto &model_mat = render_queue_[item].model_mat;
+  if (effect->IsInstancingCapable()) {
+    // constant attribute in place of the instance stream
+    for (uint32_t col = 0; col < 4; ++col) {
+      glVertexAttrib4fv(vertex_type::INSTANCE_MODEL_MAT_BIND_LOCATION + col,
+        glm::value_ptr(model_mat[col]));
+    }
+  } else if (draw_uniforms_.draw_block) {
+    if (draw_ring_stride_ > 0) {
+      draw_ring_->Buffer().BindRange(draw_ring_base_ + item * draw_ring_stride_,
+        (uint32_t)sizeof(glm::mat4));
+    } else {
+      // _model_mat is only readable from the block, refill the fallback storage per draw
+      draw_fallback_buffer_->SetData((uint32_t)sizeof(glm::mat4), glm::value_ptr(model_mat));
+      draw_fallback_buffer_->BindBase();
+    }
+  } else {
+    // custom shaders declaring _model_mat as a plain uniform
+    effect->UploadVariable(draw_uniforms_.model_mat, glm::value_ptr(model_mat));
+  }
+}
+
+bool Engine::StreamInstanceMatrices(const glm::mat4 *mats, uint32_t count) {
+  if (!instance_buffer_) {
+    return false;
+  }
+
+  // batches are appended behind the previous ones, the storage is orphaned when full so that
+  // pending draws keep reading the old one
+  const uint32_t size = (uint32_t)(count * sizeof(glm::mat4));
+  if (instance_cursor_ + size > instance_buffer_capacity_) {
+    if (size > instance_buffer_capacity_) {
+      instance_buffer_capacity_ = std::max(size, instance_buffer_capacity_ * 2);
+    }
+    instance_buffer_->SetSize(instance_buffer_capacity_);
+    instance_cursor_ = 0;
+  }
+  instance_buffer_->UpdateData(instance_cursor_, size, mats);
+  instance_offset_ = instance_cursor_;
+  instance_cursor_ += size;
+  return true;
+}
+
+void Engine::DoRenderInstanced(vertex_type::VertexArray &va, Material &material,
+  uint32_t num_instances) {
+   DoRenderInstanced(va, material, instance_offset_, num_instances);
+}
+
+void Engine::DoRenderInstanced(vertex_type::VertexArray &va, Material &material,
+  uint32_t offset, uint32_t num_instances) {
+   Material &actual = override_material_ ? *override_material_ : material;
+   actual.UploadToShader(current_effect_.second.get());
+   va.DrawInstanced(*instance_buffer_, offset, num_instances);
+}
+
 
 std::vector<RenderPass> &Engine::RenderPasses() {
   return render_passes_;
@@ -588,12 +1101,15 @@ void Engine::DoRender(vertex_type::VertexArray &va, const std::string &material_
    //resolve material
    std::shared_ptr<Material> material_ptr = bd_cast<Material>(
      resrc_mgr_.Find(material_name.c_str()));
-   if (!override_material_.empty())
-     material_ptr = bd_cast<Material>(resrc_mgr_.Find(override_material_));
    if (!material_ptr) //material not found, use default material
      material_ptr = bd_cast<Material>(resrc_mgr_.Find("mineola:material:fallback"));
 
-   material_ptr->UploadToShader(current_effect_.second.get());
+   DoRender(va, *material_ptr);
+}
+
+void Engine::DoRender(vertex_type::VertexArray &va, Material &material) {
+   Material &actual = override_material_ ? *override_material_ : material;
+   actual.UploadToShader(current_effect_.second.get());
    va.Draw();
 }
 
@@ -621,13 +1137,49 @@ void Engine::ReloadEffectFiles() {
     }
   }
 
-  ChangeEffect(current_effect_.first, true);
+  if (current_effect_.first.empty() && current_effect_.second) {
+    ChangeEffect(resrc_mgr_.QueryName(bd_cast<Resource>(current_effect_.second)), true);
+  } else {
+    ChangeEffect(current_effect_.first, true);
+  }
 }
 
 const std::weak_ptr<UniformBlock> &Engine::BuiltinUniformBlock() const {
   return builtin_uniform_block_;
 }
 
+void Engine::AddPendingEffect(const std::string &name, std::shared_ptr<GLEffect> effect) {
+  pending_effects_[name] = std::move(effect);
+}
+
+bool Engine::IsEffectPending(const std::string &name) const {
+  return pending_effects_.find(name) != pending_effects_.end();
+}
+
+void Engine::FinishPendingEffects(bool wait) {
+  for (auto iter = pending_effects_.begin(); iter != pending_effects_.end();) {
+    auto &effect = iter->second;
+    if (!wait && !effect->LinkComplete()) {
+      ++iter;
+      continue;
+    }
+    if (effect->FinishLink()) {
+      resrc_mgr_.Add(iter->first, bd_cast<Resource>(effect));
+    } else {
+      MLOG("Failed to link effect %s, drawing with the fallback\n", iter->first.c_str());
+    }
+    iter = pending_effects_.erase(iter);
+  }
+}
+
+void Engine::SetAsyncEffectLinking(bool enable) {
+  async_effect_linking_ = enable;
+}
+
+bool Engine::AsyncEffectLinking() const {
+  return async_effect_linking_;
+}
+
 bool Engine::TerminationSignaled() const {
   return terminate_signaled_;
 }
@@ -20,5 +20,6 @@ void Entity::FrameMove(double time, double frame_time) {}
 void Entity::PreRender() {}
 void Entity::PostRender() {}
 void Entity::Destroy() {}
+bool Entity::IsThreadSafe() const { return false; }
 
 }
@@ -21,11 +21,12 @@ EnvLight::EnvLight(size_t idx)
 EnvLight::~EnvLight() = default;
 
 void EnvLight::UpdateUniforms(UniformBlock *ub) {
-  auto mat_name = "_env_light_mat_" + std::to_string(idx_);
-  ub->UpdateVariable(mat_name.c_str(), glm::value_ptr(mat_));
-
-  auto sh3_name = "_env_light_sh3_" + std::to_string(idx_) + "[0]";
-  ub->UpdateVariable(sh3_name.c_str(), sh3_.coeffs.data());
+  // the builtin block holds a single environment light
+  if (idx_ != 0) {
+    return;
+  }
+  ub->UpdateVariable(UniformBlock::ENV_LIGHT_MAT_0, glm::value_ptr(mat_));
+  ub->UpdateVariable(UniformBlock::ENV_LIGHT_SH3_0, sh3_.coeffs.data());
 }
 
 void EnvLight::UpdateLightTransform(const math::Rbt &rbt) {
@@ -91,9 +92,8 @@ bool EnvLight::CreateLightProbeTexture(std::shared_ptr<ImgppTextureSrc> tex_src)
 
   // bind to texture unit
   if (idx_ == 0) {
-    glActiveTexture(GL_TEXTURE0 + kEnvLightProbe0TextureUnit);
-    light_probe_->Bind();
-    glActiveTexture(GL_TEXTURE0 + kNumReservedTextureUnits);
+    light_probe_->BindToUnit(kEnvLightProbe0TextureUnit);
+    Engine::Instance().RenderStateMgr().ActiveTexture(kNumReservedTextureUnits);
   }
 
   return true;
@@ -61,4 +61,21 @@ bool FileExists(const char *path, int &file_type) {
   }
 }
 
+bool GetFileStamp(const char *path, FileStamp &stamp) {
+  struct stat buffer;
+  if (stat(path, &buffer) == -1 || !S_ISREG(buffer.st_mode)) {
+    return false;
+  }
+  // nanoseconds where available, so that same-size edits within a second are told apart
+#if defined(__APPLE__)
+  stamp.mtime = (int64_t)buffer.st_mtimespec.tv_sec * 1000000000 + buffer.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+  stamp.mtime = (int64_t)buffer.st_mtime * 1000000000;
+#else
+  stamp.mtime = (int64_t)buffer.st_mtim.tv_sec * 1000000000 + buffer.st_mtim.tv_nsec;
+#endif
+  stamp.size = (int64_t)buffer.st_size;
+  return true;
+}
+
 }} //end namespace
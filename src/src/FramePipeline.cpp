@@ -0,0 +1,63 @@
+#include "prefix.h"
+#include <mineola/FramePipeline.h>
+#include <mineola/Engine.h>
+
+namespace mineola {
+
+FramePipeline::FramePipeline() {
+  // the thread idles until the first BeginFrame()
+  thread_ = std::thread(&FramePipeline::SimulationLoop, this);
+  Engine::Instance().SetPipelined(true, thread_.get_id());
+}
+
+FramePipeline::~FramePipeline() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+  Engine::Instance().SetPipelined(false);
+}
+
+void FramePipeline::BeginFrame() {
+  auto &en = Engine::Instance();
+  if (!primed_) {  // nothing simulated yet to render
+    en.FrameMove();
+    primed_ = true;
+  }
+
+  en.PrepareRender();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    simulating_ = true;
+  }
+  cv_.notify_all();
+  en.RenderPrepared();
+}
+
+void FramePipeline::EndFrame() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return !simulating_; });
+  }
+  Engine::Instance().FinishRender();
+}
+
+void FramePipeline::SimulationLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]() { return simulating_ || stop_; });
+    if (!simulating_) {
+      return;
+    }
+
+    lock.unlock();
+    Engine::Instance().FrameMove();
+    lock.lock();
+    simulating_ = false;
+    cv_.notify_all();
+  }
+}
+
+} // namespace
@@ -0,0 +1,49 @@
+#include "prefix.h"
+#include <mineola/Frustum.h>
+
+namespace mineola {
+
+// Gribb & Hartmann plane extraction, for OpenGL [-w, w] clip space depth.
+Frustum::Frustum(const glm::mat4 &m) {
+  glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+  glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+  glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+  glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+  planes_[kLeft] = row3 + row0;
+  planes_[kRight] = row3 - row0;
+  planes_[kBottom] = row3 + row1;
+  planes_[kTop] = row3 - row1;
+  planes_[kNear] = row3 + row2;
+  planes_[kFar] = row3 - row2;
+}
+
+bool Frustum::Intersects(const AABB &aabb) const {
+  for (const auto &plane : planes_) {
+    // pick the box corner furthest along the plane normal
+    glm::vec3 p(
+      plane.x >= 0.f ? aabb.ub_.x : aabb.lb_.x,
+      plane.y >= 0.f ? aabb.ub_.y : aabb.lb_.y,
+      plane.z >= 0.f ? aabb.ub_.z : aabb.lb_.z);
+    if (glm::dot(glm::vec3(plane), p) + plane.w < 0.f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Frustum::Contains(const AABB &aabb) const {
+  for (const auto &plane : planes_) {
+    // the box corner furthest against the plane normal must be inside
+    glm::vec3 n(
+      plane.x >= 0.f ? aabb.lb_.x : aabb.ub_.x,
+      plane.y >= 0.f ? aabb.lb_.y : aabb.ub_.y,
+      plane.z >= 0.f ? aabb.lb_.z : aabb.ub_.z);
+    if (glm::dot(glm::vec3(plane), n) + plane.w < 0.f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
@@ -2,7 +2,6 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstring>
-#include <unordered_set>
 #include <mineola/glutility.h>
 #include <mineola/GLShader.h>
 #include <mineola/GLEffect.h>
@@ -10,11 +9,38 @@
 #include <mineola/UniformBlock.h>
 #include <mineola/UniformHelper.h>
 #include <mineola/Engine.h>
+#include <mineola/ProgramBinaryCache.h>
 #include <mineola/RenderState.h>
 
 namespace mineola {
 
-GLEffect::GLEffect() {}
+namespace {
+
+bool ParallelCompileSupported() {
+  static const bool supported = [] {
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+    for (GLint i = 0; i < num_extensions; ++i) {
+      auto extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+      if (extension && (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0
+        || strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)) {
+#ifdef MINEOLA_DESKTOP
+        if (glMaxShaderCompilerThreadsKHR) {
+          glMaxShaderCompilerThreadsKHR(0xffffffff);  // as many as the driver likes
+        }
+#endif
+        return true;
+      }
+    }
+    return false;
+  }();
+  return supported;
+}
+
+}
+
+GLEffect::GLEffect()
+  : shaders_attached_(false), linking_(false), restored_(false), instancing_capable_(false) {}
 
 GLEffect::~GLEffect() {
   vertex_shader_.reset();
@@ -23,58 +49,111 @@ GLEffect::~GLEffect() {
 
 bool GLEffect::AttachShaders(std::shared_ptr<GLShader> vs,
 	std::shared_ptr<GLShader> ps) {
+  return BeginLink(std::move(vs), std::move(ps)) && FinishLink();
+}
+
+bool GLEffect::BeginLink(std::shared_ptr<GLShader> vs, std::shared_ptr<GLShader> ps) {
   if (handle_ == 0) {
     MLOG("Cannot attach shaders to an invalid GLEffect!\n");
     return false;
   }
+  return RestoreProgram(std::move(vs), std::move(ps)) || LinkProgram();
+}
 
-  if (vertex_shader_)
+bool GLEffect::RestoreProgram(std::shared_ptr<GLShader> vs, std::shared_ptr<GLShader> ps) {
+  if (handle_ == 0) {
+    return false;
+  }
+
+  if (shaders_attached_) {
     glDetachShader(handle_, vertex_shader_->Handle());
-  if (pixel_shader_)
     glDetachShader(handle_, pixel_shader_->Handle());
+    shaders_attached_ = false;
+  }
+  vertex_shader_ = vs;
+  pixel_shader_ = ps;
+  restored_ = false;
+  cache_key_.reset();
+  linking_ = true;
+
+  if (!vs->Source().empty() && !ps->Source().empty() && program_binary_cache::Enabled()) {
+    const uint64_t key = program_binary_cache::Key(vs->Source(), ps->Source());
+    if (program_binary_cache::Load(key, handle_)) {
+      restored_ = true;
+      return true;
+    }
+    cache_key_ = key;
+  }
+  return false;
+}
 
-  glAttachShader(handle_, vs->Handle());
-  glAttachShader(handle_, ps->Handle());
-  vertex_shader_ = std::move(vs);
-  pixel_shader_ = std::move(ps);
+bool GLEffect::LinkProgram() {
+  if (handle_ == 0 || !linking_) {
+    MLOG("LinkProgram() without RestoreProgram()!\n");
+    return false;
+  }
+  if (restored_) {
+    return true;
+  }
 
-  glLinkProgram(handle_);
-  if (!InfoLog()) return false;
-  // reorder attributes
-  ReorderAttribBindings();
+  // no-ops for shaders submitted by the caller already
+  vertex_shader_->SubmitCompile();
+  pixel_shader_->SubmitCompile();
 
-  // reorder uniform blocks
-  GenerateUniformBlockMap();
-  BindBuiltinUniformBlocks();
+  glAttachShader(handle_, vertex_shader_->Handle());
+  glAttachShader(handle_, pixel_shader_->Handle());
+  shaders_attached_ = true;
 
+  BindAttribLocations();
+  if (cache_key_) {
+    glProgramParameteri(handle_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
   glLinkProgram(handle_);
-  if (!InfoLog()) return false;
-
-  if (!GenerateAttribMap()) return false;
-  if (!GenerateVarMap()) return false;
-  if (!GenerateUniformBlockMap()) return false;
   return true;
 }
 
-void GLEffect::ReorderAttribBindings() {
-  int32_t attrib_num = 0;
-  glGetProgramiv(handle_, GL_ACTIVE_ATTRIBUTES, &attrib_num);
-  if (attrib_num <= 0)
-    return;
+bool GLEffect::LinkComplete() const {
+  if (!linking_ || restored_ || !ParallelCompileSupported()) {
+    return true;
+  }
+  GLint complete = GL_TRUE;
+  glGetProgramiv(handle_, GL_COMPLETION_STATUS_KHR, &complete);
+  return complete == GL_TRUE;
+}
 
-  std::unordered_set<std::string> attrib_names;
+bool GLEffect::FinishLink() {
+  if (!linking_) {
+    MLOG("FinishLink() without BeginLink()!\n");
+    return false;
+  }
+  linking_ = false;
 
-  static char attrib_name[VAR_NAME_MAX_LENGTH];
-  int32_t attrib_name_len, attrib_size;
-  GLenum attrib_type;
+  if (!restored_) {
+    // report errors of both shaders before the link error they cause
+    const bool vs_compiled = vertex_shader_->FinishCompile();
+    const bool ps_compiled = pixel_shader_->FinishCompile();
+    if (!vs_compiled || !ps_compiled) return false;
+    if (!InfoLog()) return false;
 
-  for (int i = 0; i < attrib_num; ++i) {
-    glGetActiveAttrib(handle_, i, VAR_NAME_MAX_LENGTH,
-              &attrib_name_len, &attrib_size, &attrib_type,
-              attrib_name);
-    attrib_names.insert(attrib_name);
+    if (cache_key_) {
+      program_binary_cache::Store(*cache_key_, handle_);
+    }
   }
 
+  // uniform block bindings are neither part of the link nor of a program binary
+  GenerateUniformBlockMap();
+  BindBuiltinUniformBlocks();
+  return GenerateMaps();
+}
+
+bool GLEffect::GenerateMaps() {
+  if (!GenerateAttribMap()) return false;
+  if (!GenerateVarMap()) return false;
+  if (!GenerateUniformBlockMap()) return false;
+  return true;
+}
+
+void GLEffect::BindAttribLocations() {
   for (int semantics = vertex_type::POSITION;
     semantics < vertex_type::RESERVED_SEMANTICS_NUM;
     ++semantics) {
@@ -85,11 +164,11 @@ void GLEffect::ReorderAttribBindings() {
     }
 
     int bind_loc = vertex_type::GetSemanticsBindLocation(semantics);
-    auto iter = attrib_names.find(var_name);
-    if (iter != attrib_names.end()) {
-      glBindAttribLocation(handle_, bind_loc, iter->c_str());
-    }
+    glBindAttribLocation(handle_, bind_loc, var_name);
   }
+
+  glBindAttribLocation(handle_, vertex_type::INSTANCE_MODEL_MAT_BIND_LOCATION,
+    vertex_type::GetInstanceModelMatString());
 }
 
 bool GLEffect::GenerateAttribMap() {
@@ -103,6 +182,7 @@ bool GLEffect::GenerateAttribMap() {
   if (attrib_num < 0)
     return false;
 
+  attribute_map_.clear();
   static char attrib_name[VAR_NAME_MAX_LENGTH];
   int32_t attrib_name_len, attrib_size, attrib_loc;
   GLenum attrib_type;
@@ -116,6 +196,10 @@ bool GLEffect::GenerateAttribMap() {
         std::make_tuple(attrib_loc, (uint32_t)attrib_type, attrib_size);
   }
 
+  auto iter = attribute_map_.find(vertex_type::GetInstanceModelMatString());
+  instancing_capable_ = iter != attribute_map_.end()
+    && std::get<0>(iter->second) == vertex_type::INSTANCE_MODEL_MAT_BIND_LOCATION;
+
   // dump attributes
   // for (auto iter = attribute_map_.begin(); iter != attribute_map_.end(); ++iter)
   //  printf("%s: %d, %d, %d\n", iter->first.c_str(), std::get<0>(iter->second), std::get<1>(iter->second), std::get<2>(iter->second));
@@ -143,6 +227,10 @@ void GLEffect::SetRenderStates(std::vector<std::unique_ptr<RenderState>> states)
   render_states_ = std::move(states);
 }
 
+bool GLEffect::IsInstancingCapable() const {
+  return instancing_capable_;
+}
+
 void GLEffect::ApplyRenderStates() const {
   auto &mgr = Engine::Instance().RenderStateMgr();
   for (const auto &state : render_states_) {
@@ -155,10 +243,10 @@ bool CreateEffectFromFileHelper(const char *effectname,
   std::vector<std::unique_ptr<RenderState>> states) {
 
   std::shared_ptr<GLShader> vs(new GLVertexShader), ps(new GLPixelShader);
-  if (!vs->LoadFromFile(filename_vs, defines)) {
+  if (!vs->PreprocessFromFile(filename_vs, defines)) {
     return false;
   }
-  if (!ps->LoadFromFile(filename_fs, defines)) {
+  if (!ps->PreprocessFromFile(filename_fs, defines)) {
     return false;
   }
 
@@ -180,10 +268,10 @@ bool CreateEffectFromMemHelper(const char *effectname,
   std::vector<std::unique_ptr<RenderState>> states) {
 
   std::shared_ptr<GLShader> vs(new GLVertexShader), ps(new GLPixelShader);
-  if (!vs->LoadFromMemory(vs_buf, defines)) {
+  if (!vs->PreprocessFromMemory(vs_buf, defines)) {
     return false;
   }
-  if (!ps->LoadFromMemory(ps_buf, defines)) {
+  if (!ps->PreprocessFromMemory(ps_buf, defines)) {
     return false;
   }
 
@@ -209,7 +297,7 @@ bool ReloadEffectFromFileHelper(const char *effectname,
   }
 
   std::shared_ptr<GLShader> vs(new GLVertexShader), ps(new GLPixelShader);
-  if (!vs->LoadFromFile(filename_vs, defines) || !ps->LoadFromFile(filename_fs, defines)) {
+  if (!vs->PreprocessFromFile(filename_vs, defines) || !ps->PreprocessFromFile(filename_fs, defines)) {
     return false;
   }
   if (!effect->AttachShaders(vs, ps)) {
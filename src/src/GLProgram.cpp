@@ -4,6 +4,7 @@
 #include <unordered_set>
 #include <numeric>
 #include <mineola/glutility.h>
+#include <mineola/Engine.h>
 #include <mineola/GLShader.h>
 #include <mineola/GLProgram.h>
 #include <mineola/TypeMapping.h>
@@ -13,11 +14,13 @@
 namespace mineola {
 
 GLProgram::GLProgram()
-  : handle_(glCreateProgram()) {}
+  : handle_(glCreateProgram()), link_version_(0) {}
 
 GLProgram::~GLProgram() {
-  if (handle_)
+  if (handle_) {
     glDeleteProgram(handle_);
+    Engine::Instance().RenderStateMgr().OnProgramDeleted(handle_);
+  }
 }
 
 bool GLProgram::InfoLog() const {
@@ -82,6 +85,11 @@ bool GLProgram::GenerateVarMap() {
   }
 
   variable_map_.clear();
+  uniforms_.clear();
+  shadow_values_.clear();
+  static uint32_t link_counter = 0;
+  link_version_ = ++link_counter;
+
   int32_t num_uniforms = 0;
   glGetProgramiv(handle_, GL_ACTIVE_UNIFORMS, &num_uniforms);
   if (num_uniforms <= 0)
@@ -105,10 +113,32 @@ bool GLProgram::GenerateVarMap() {
       &uniform_name_length, &uniform_size, &uniform_type, uniform_name);
     uniform_loc = glGetUniformLocation(handle_, uniform_name);
     if (uniform_loc != -1) {
-      variable_map_[uniform_name] = std::make_tuple(uniform_loc, (uint32_t)uniform_type, uniform_size);
+      uint32_t base_type = 0, num_components = 0;
+      type_mapping::MapGLType(uniform_type, &base_type, &num_components);
+      uint32_t element_bytes = type_mapping::SizeOf(base_type) * num_components;
+      if (element_bytes == 0 && type_mapping::IsSamplerGLType(uniform_type)) {
+        element_bytes = sizeof(int32_t);  // texture unit
+      }
+      // other unknown types get no shadow copy and are always uploaded
+
+      UniformInfo info;
+      info.name = uniform_name;
+      info.loc = (uint32_t)uniform_loc;
+      info.type = (uint32_t)uniform_type;
+      info.size = (uint32_t)uniform_size;
+      info.shadow_offset = (uint32_t)shadow_values_.size();
+      info.shadow_bytes = element_bytes * (uint32_t)uniform_size;
+      info.shadow_valid = false;
+      shadow_values_.resize(shadow_values_.size() + info.shadow_bytes);
+      uniforms_.push_back(std::move(info));
     }
   }
 
+  // keys view into uniforms_, which is not modified anymore
+  for (int32_t handle = 0; handle < (int32_t)uniforms_.size(); ++handle) {
+    variable_map_[uniforms_[handle].name] = handle;
+  }
+
 //  for (auto iter = variable_map_.begin(); iter != variable_map_.end(); ++iter)
 //    printf("%s: %d, %d, %d\n", iter->first.c_str(), std::get<0>(iter->second), std::get<1>(iter->second), std::get<2>(iter->second));
 
@@ -124,46 +154,78 @@ int32_t GLProgram::GetUniformBlockBinding(const std::string &name) {
 }
 
 
-bool GLProgram::GetVariableInfo(
-  const char *name,
-  uint32_t &type, uint32_t &loc, uint32_t &length) {
-
-  auto iter = variable_map_.find(name);
+int32_t GLProgram::GetUniformHandle(const char *var_name) const {
+  auto iter = variable_map_.find(var_name);
   if (iter != variable_map_.end()) {
-    type = std::get<1>(iter->second);
-    loc = std::get<0>(iter->second);
-    length = std::get<2>(iter->second);
+    return iter->second;
+  }
+  return kInvalidUniform;
+}
+
+uint32_t GLProgram::LinkVersion() const {
+  return link_version_;
+}
+
+bool GLProgram::UpdateShadow(UniformInfo &info, const void *val) {
+  if (info.shadow_bytes == 0) {
     return true;
   }
-  return false;
+  uint8_t *shadow = &shadow_values_[info.shadow_offset];
+  if (info.shadow_valid && memcmp(shadow, val, info.shadow_bytes) == 0) {
+    return false;
+  }
+  memcpy(shadow, val, info.shadow_bytes);
+  info.shadow_valid = true;
+  return true;
 }
 
-void GLProgram::UploadVariable(const char *var_name, const float *val) {
-  uint32_t type = 0, loc = 0, length = 0;
-  if (GetVariableInfo(var_name, type, loc, length)) {
-    gl_uniform::SetUniform(type, loc, length, val);
+void GLProgram::UploadVariable(int32_t handle, const float *val) {
+  if (handle < 0 || handle >= (int32_t)uniforms_.size()) {
+    return;
+  }
+  auto &info = uniforms_[handle];
+  if (UpdateShadow(info, val)) {
+    gl_uniform::SetUniform(info.type, info.loc, info.size, val);
   }
 }
 
-void GLProgram::UploadVariable(const char *var_name, const int32_t *val) {
-  uint32_t type = 0, loc = 0, length = 0;
-  if (GetVariableInfo(var_name, type, loc, length)) {
-    gl_uniform::SetUniform(type, loc, length, val);
+void GLProgram::UploadVariable(int32_t handle, const int32_t *val) {
+  if (handle < 0 || handle >= (int32_t)uniforms_.size()) {
+    return;
+  }
+  auto &info = uniforms_[handle];
+  if (UpdateShadow(info, val)) {
+    gl_uniform::SetUniform(info.type, info.loc, info.size, val);
   }
 }
 
-void GLProgram::UploadVariable(const char *var_name, const uint32_t *val) {
-  uint32_t type = 0, loc = 0, length = 0;
-  if (GetVariableInfo(var_name, type, loc, length)) {
-    gl_uniform::SetUniform(type, loc, length, val);
+void GLProgram::UploadVariable(int32_t handle, const uint32_t *val) {
+  if (handle < 0 || handle >= (int32_t)uniforms_.size()) {
+    return;
   }
+  auto &info = uniforms_[handle];
+  if (UpdateShadow(info, val)) {
+    gl_uniform::SetUniform(info.type, info.loc, info.size, val);
+  }
+}
+
+void GLProgram::UploadVariable(const char *var_name, const float *val) {
+  UploadVariable(GetUniformHandle(var_name), val);
+}
+
+void GLProgram::UploadVariable(const char *var_name, const int32_t *val) {
+  UploadVariable(GetUniformHandle(var_name), val);
+}
+
+void GLProgram::UploadVariable(const char *var_name, const uint32_t *val) {
+  UploadVariable(GetUniformHandle(var_name), val);
 }
 
 bool GLProgram::Bind() {
   if (handle_ == 0) {
     return false;
   }
-  glUseProgram(handle_);
+  Engine::Instance().RenderStateMgr().UseProgram(handle_);
   CHKGLERR_RET;
   return true;
 }
@@ -2,8 +2,6 @@
 #include <mineola/GLShader.h>
 #include <cstdio>
 #include <algorithm>
-#include <sstream>
-#include <fstream>
 #include <mineola/ShaderParser.h>
 #include <mineola/Engine.h>
 #include <mineola/glutility.h>
@@ -26,7 +24,7 @@ namespace {
 namespace mineola {
 
 GLShader::GLShader()
-  : handle_(0) {}
+  : handle_(0), submitted_(false), compiled_(false) {}
 
 GLShader::~GLShader() {
   if (handle_)
@@ -34,44 +32,70 @@ GLShader::~GLShader() {
 }
 
 bool GLShader::LoadFromMemory(const char *pbuf, const effect_defines_t *defines) {
-  std::istringstream stream(pbuf);
+  return PreprocessFromMemory(pbuf, defines) && Compile();
+}
+
+bool GLShader::LoadFromFile(const char *fn, const effect_defines_t *defines) {
+  return PreprocessFromFile(fn, defines) && Compile();
+}
+
+bool GLShader::PreprocessFromMemory(const char *pbuf, const effect_defines_t *defines) {
   std::string shader_str;
-  if (!shader_parser::ParseShader(stream, defines, shader_str))
+  if (!shader_parser::ParseShader(pbuf, defines, shader_str))
     return false;
-  return LoadFromRawMemory(shader_str.c_str());
+  source_ = std::move(shader_str);
+  submitted_ = compiled_ = false;
+  return true;
 }
 
-bool GLShader::LoadFromFile(const char *fn, const effect_defines_t *defines) {
+bool GLShader::PreprocessFromFile(const char *fn, const effect_defines_t *defines) {
   std::string found_fn;
   if (!Engine::Instance().ResrcMgr().LocateFile(fn, found_fn)) {
     MLOG("[%s] does not exists!\n", fn);
     return false;
   }
 
-  std::ifstream infile(found_fn);
-  if (!infile.good()) {
-    MLOG("Failed to open [%s]!\n", found_fn.c_str());
-    return false;
-  }
-
   std::string shader_str;
-  if (!shader_parser::ParseShader(infile, defines, shader_str))
+  if (!shader_parser::ParseShaderFile(found_fn.c_str(), defines, shader_str))
     return false;
-  return LoadFromRawMemory(shader_str.c_str());
+  source_ = std::move(shader_str);
+  submitted_ = compiled_ = false;
+  return true;
 }
 
-bool GLShader::LoadFromRawMemory(const char *str) {
+bool GLShader::Compile() {
+  SubmitCompile();
+  return FinishCompile();
+}
+
+void GLShader::SubmitCompile() {
+  if (submitted_ || handle_ == 0) {
+    return;
+  }
+  const char *str = source_.c_str();
+  glShaderSource(handle_, 1, &str, NULL);
+  glCompileShader(handle_);
+  submitted_ = true;
+}
+
+bool GLShader::FinishCompile() {
+  if (compiled_) {
+    return true;
+  }
   if (handle_ == 0) {
     MLOG("Unable to load code to an invalid GLShader!\n");
     return false;
   }
+  if (!submitted_) {
+    MLOG("Shader compilation was not submitted!\n");
+    return false;
+  }
 
-  glShaderSource(handle_, 1, (const char **)&str, NULL);
-  glCompileShader(handle_);
   bool result = InfoLog();
   if (!result) {
-    MLOG("%s", AddLineNumber(str).c_str());
+    MLOG("%s", AddLineNumber(source_).c_str());
   }
+  compiled_ = result;
   return result;
 }
 
@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <tuple>
 #include <sstream>
+#include <cstring>
 #include <boost/algorithm/string.hpp>
 #include <fx/gltf.h>
 #include <glm/glm.hpp>
@@ -12,13 +13,13 @@
 #include <mineola/Engine.h>
 #include <mineola/Renderable.h>
 #include <mineola/TextureHelper.h>
-#include <mineola/GraphicsBuffer.h>
 #include <mineola/SceneNode.h>
 #include <mineola/UniformWrappers.h>
 #include <mineola/PBRShaders.h>
 #include <mineola/AnimatedEntity.h>
 #include <mineola/GLMHelper.h>
 #include <mineola/Light.h>
+#include <mineola/TriangleMesh.h>
 
 namespace details {
 
@@ -267,6 +268,66 @@ std::vector<float> ParseNormalizedFloatBuffer(const fx::gltf::Document &doc, int
   return result;
 }
 
+// CPU copy of a triangle list primitive for ray casting, nullptr if not applicable
+std::shared_ptr<TriangleMesh> LoadTriangleMesh(const fx::gltf::Document &doc,
+  const fx::gltf::Primitive &p) {
+  if (p.mode != fx::gltf::Primitive::Mode::Triangles) {
+    return nullptr;
+  }
+  auto pos_iter = p.attributes.find("POSITION");
+  if (pos_iter == p.attributes.end()) {
+    return nullptr;
+  }
+  const auto &pos_acc = doc.accessors[pos_iter->second];
+  if (pos_acc.bufferView < 0 || pos_acc.type != fx::gltf::Accessor::Type::Vec3 ||
+    pos_acc.componentType != fx::gltf::Accessor::ComponentType::Float) {
+    return nullptr;
+  }
+
+  const auto &pos_bv = doc.bufferViews[pos_acc.bufferView];
+  const uint8_t *pos_ptr = &doc.buffers[pos_bv.buffer].data[pos_bv.byteOffset + pos_acc.byteOffset];
+  uint32_t pos_stride = pos_bv.byteStride > 0 ? pos_bv.byteStride : 3 * sizeof(float);
+  std::vector<glm::vec3> positions(pos_acc.count);
+  for (uint32_t i = 0; i < pos_acc.count; ++i) {
+    memcpy(&positions[i], pos_ptr + i * pos_stride, sizeof(glm::vec3));
+  }
+
+  std::vector<uint32_t> indices;
+  if (p.indices >= 0) {
+    const auto &idx_acc = doc.accessors[p.indices];
+    if (idx_acc.bufferView < 0) {
+      return nullptr;
+    }
+    const auto &idx_bv = doc.bufferViews[idx_acc.bufferView];
+    const uint8_t *idx_ptr =
+      &doc.buffers[idx_bv.buffer].data[idx_bv.byteOffset + idx_acc.byteOffset];
+    indices.resize(idx_acc.count);
+    for (uint32_t i = 0; i < idx_acc.count; ++i) {
+      switch (idx_acc.componentType) {
+        case fx::gltf::Accessor::ComponentType::UnsignedByte:
+          indices[i] = idx_ptr[i];
+          break;
+        case fx::gltf::Accessor::ComponentType::UnsignedShort:
+          indices[i] = ((const uint16_t*)idx_ptr)[i];
+          break;
+        case fx::gltf::Accessor::ComponentType::UnsignedInt:
+          indices[i] = ((const uint32_t*)idx_ptr)[i];
+          break;
+        default:
+          return nullptr;
+      }
+    }
+  } else {
+    indices.resize(pos_acc.count);
+    for (uint32_t i = 0; i < pos_acc.count; ++i) {
+      indices[i] = i;
+    }
+  }
+  indices.resize(indices.size() / 3 * 3);
+
+  return std::make_shared<TriangleMesh>(std::move(positions), std::move(indices));
+}
+
 void ParseAnimationChannel(const fx::gltf::Document &doc,
   const fx::gltf::Animation::Channel &ch,
   int acc_in, int acc_out,
@@ -469,29 +530,29 @@ void LoadClearcoat(const nlohmann::json &clearcoat_json,
   material_flags.SetUseClearcoat();
   details::Clearcoat clearcoat = clearcoat_json;
 
-  material->uniform_slots["clearcoat_factor"] = uniform_helper::Wrap(clearcoat.factor);
-  material->uniform_slots["clearcoat_roughness_factor"] = uniform_helper::Wrap(clearcoat.roughnessFactor);
+  material->SetUniformSlot("clearcoat_factor", uniform_helper::Wrap(clearcoat.factor));
+  material->SetUniformSlot("clearcoat_roughness_factor", uniform_helper::Wrap(clearcoat.roughnessFactor));
   if (!clearcoat.texture.empty()) {
-    material->texture_slots["clearcoat_sampler"] =
-      {texture_names[(uint32_t)clearcoat.texture.index]};
+    material->SetTextureSlot("clearcoat_sampler",
+      {texture_names[(uint32_t)clearcoat.texture.index]});
     material_flags.EnableClearcoatTex((uint8_t)clearcoat.texture.texCoord);
     if (auto ttform = LoadTexTform(clearcoat.texture.extensionsAndExtras))
-      material->texture_tforms["clearcoat_sampler"] = *ttform;
+      material->SetTextureTransform("clearcoat_sampler", *ttform);
   }
   if (!clearcoat.roughnessTexture.empty()) {
-    material->texture_slots["cc_rough_sampler"] =
-      {texture_names[(uint32_t)clearcoat.roughnessTexture.index]};
+    material->SetTextureSlot("cc_rough_sampler",
+      {texture_names[(uint32_t)clearcoat.roughnessTexture.index]});
     material_flags.EnableClearcoatRoughTex((uint8_t)clearcoat.roughnessTexture.texCoord);
     if (auto ttform = LoadTexTform(clearcoat.roughnessTexture.extensionsAndExtras))
-      material->texture_tforms["cc_rough_sampler"] = *ttform;
+      material->SetTextureTransform("cc_rough_sampler", *ttform);
   }
   if (!clearcoat.normalTexture.empty()) {
-    material->texture_slots["cc_normal_sampler"] =
-      {texture_names[(uint32_t)clearcoat.normalTexture.index]};
-    material->uniform_slots["cc_normal_scale"] = uniform_helper::Wrap(clearcoat.normalTexture.scale);
+    material->SetTextureSlot("cc_normal_sampler",
+      {texture_names[(uint32_t)clearcoat.normalTexture.index]});
+    material->SetUniformSlot("cc_normal_scale", uniform_helper::Wrap(clearcoat.normalTexture.scale));
     material_flags.EnableClearcoatNormalTex((uint8_t)clearcoat.normalTexture.texCoord);
     if (auto ttform = LoadTexTform(clearcoat.normalTexture.extensionsAndExtras))
-      material->texture_tforms["cc_normal_sampler"] = *ttform;
+      material->SetTextureTransform("cc_normal_sampler", *ttform);
   }
 }
 
@@ -572,26 +633,25 @@ bool CreateSceneFromGLTFDoc(
     }
   }
 
-  // load GPU buffers
-  std::unordered_map<uint32_t, std::shared_ptr<GraphicsBuffer>> buffers;
+  // load GPU buffers into the geometry arena
+  std::unordered_map<uint32_t, std::shared_ptr<GeometryAllocation>> buffers;
   {
-    // create graphics buffers
+    auto &arena = Engine::Instance().GeomArena();
     for (size_t idx = 0; idx < doc.buffers.size(); ++idx) {
       const auto &b = doc.buffers[idx];
-      std::vector<uint32_t> targets;
 
       const auto &usages = buffer_usages[idx];
       if (usages.size() == 0) {
         continue;
       }
-      std::copy(usages.begin(), usages.end(), std::back_inserter(targets));
-
-      auto buffer = std::make_shared<GraphicsBuffer>(
-        GraphicsBuffer::STATIC, GraphicsBuffer::SEND, GraphicsBuffer::WRITE_ONLY, targets);
-      buffer->Bind();
-      buffer->SetData(b.byteLength, b.data.data());
-      buffer->Unbind();
-      buffers[(uint32_t)idx] = buffer;
+      // buffers holding vertices and indices go to vertex pages
+      uint32_t target = (usages.size() == 1 && *usages.begin() == (uint32_t)BufferViewUsage::kIBO) ?
+        GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+
+      auto allocation = arena.Allocate(target, b.byteLength, b.data.data());
+      if (allocation) {
+        buffers[(uint32_t)idx] = allocation;
+      }
     }
   }
 
@@ -711,31 +771,31 @@ bool CreateSceneFromGLTFDoc(
         material_flags.EnableBlending();
       } else if (m.alphaMode == fx::gltf::Material::AlphaMode::Mask) {
         material_flags.EnableAlphaCutOff();
-        material->uniform_slots["alpha_threshold"] = uniform_helper::Wrap(m.alphaCutoff);
+        material->SetUniformSlot("alpha_threshold", uniform_helper::Wrap(m.alphaCutoff));
       }
 
       // additional textures
       if (!m.normalTexture.empty()) {
-        material->texture_slots["normal_sampler"] =
-          {texture_names[(uint32_t)m.normalTexture.index]};
-        material->uniform_slots["normal_scale"] = uniform_helper::Wrap(m.normalTexture.scale);
+        material->SetTextureSlot("normal_sampler",
+          {texture_names[(uint32_t)m.normalTexture.index]});
+        material->SetUniformSlot("normal_scale", uniform_helper::Wrap(m.normalTexture.scale));
         material_flags.EnableNormalMap((uint8_t)m.normalTexture.texCoord);
         if (auto ttform = LoadTexTform(m.normalTexture.extensionsAndExtras))
-          material->texture_tforms["normal_sampler"] = *ttform;
+          material->SetTextureTransform("normal_sampler", *ttform);
       }
       if (!m.occlusionTexture.empty()) {
-        material->texture_slots["lightmap_sampler"] =
-          {texture_names[(uint32_t)m.occlusionTexture.index]};
+        material->SetTextureSlot("lightmap_sampler",
+          {texture_names[(uint32_t)m.occlusionTexture.index]});
         material_flags.EnableOcclusionMap((uint8_t)m.occlusionTexture.texCoord);
         if (auto ttform = LoadTexTform(m.occlusionTexture.extensionsAndExtras))
-          material->texture_tforms["lightmap_sampler"] = *ttform;
+          material->SetTextureTransform("lightmap_sampler", *ttform);
       }
       if (!m.emissiveTexture.empty()) {
-        material->texture_slots["emissive_sampler"] =
-          {texture_names[(uint32_t)m.emissiveTexture.index]};
+        material->SetTextureSlot("emissive_sampler",
+          {texture_names[(uint32_t)m.emissiveTexture.index]});
         material_flags.EnableEmissiveMap((uint8_t)m.emissiveTexture.texCoord);
         if (auto ttform = LoadTexTform(m.emissiveTexture.extensionsAndExtras))
-          material->texture_tforms["emissive_sampler"] = *ttform;
+          material->SetTextureTransform("emissive_sampler", *ttform);
       }
       material->emit = glm::vec3(
         m.emissiveFactor[0], m.emissiveFactor[1], m.emissiveFactor[2]);
@@ -744,19 +804,19 @@ bool CreateSceneFromGLTFDoc(
       if (!m.pbrMetallicRoughness.empty()) {
         const auto &m_pbr = m.pbrMetallicRoughness;
         if (!m_pbr.baseColorTexture.empty()) {
-          material->texture_slots["diffuse_sampler"] =
-            {texture_names[(uint32_t)m_pbr.baseColorTexture.index]};
+          material->SetTextureSlot("diffuse_sampler",
+            {texture_names[(uint32_t)m_pbr.baseColorTexture.index]});
           material_flags.EnableDiffuseMap((uint8_t)m_pbr.baseColorTexture.texCoord);
           if (auto ttform = LoadTexTform(m_pbr.baseColorTexture.extensionsAndExtras))
-            material->texture_tforms["diffuse_sampler"] = *ttform;
+            material->SetTextureTransform("diffuse_sampler", *ttform);
         }
         if (!m_pbr.metallicRoughnessTexture.empty()) {
-          material->texture_slots["mr_sampler"] =
-            {texture_names[(uint32_t)m_pbr.metallicRoughnessTexture.index]};
+          material->SetTextureSlot("mr_sampler",
+            {texture_names[(uint32_t)m_pbr.metallicRoughnessTexture.index]});
           material_flags.EnableMetallicRoughnessMap(
             (uint8_t)m_pbr.metallicRoughnessTexture.texCoord);
           if (auto ttform = LoadTexTform(m_pbr.metallicRoughnessTexture.extensionsAndExtras))
-            material->texture_tforms["mr_sampler"] = *ttform;
+            material->SetTextureTransform("mr_sampler", *ttform);
         }
 
         material->diffuse = glm::vec3(
@@ -806,6 +866,8 @@ bool CreateSceneFromGLTFDoc(
   {
     auto sfx_flags = EffectNameToSFXFlags(effect_name);
     auto shadownmap_effect_type = ShadowmapEffectNameToType(shadowmap_effect_name);
+    // PBR effects used by the primitives, created together once all are known
+    std::vector<PBRPermutation> pbr_perms;
 
     for (size_t mesh_idx = 0; mesh_idx < doc.meshes.size(); ++mesh_idx) {
       const auto &m = doc.meshes[mesh_idx];
@@ -837,7 +899,7 @@ bool CreateSceneFromGLTFDoc(
             continue;
           }
           int32_t buffer = doc.bufferViews[buffer_view_id].buffer;
-          if (buffer < 0) {
+          if (buffer < 0 || !buffers[buffer]) {
             continue;
           }
 
@@ -848,9 +910,12 @@ bool CreateSceneFromGLTFDoc(
           vs->layout.push_back({(uint32_t)semantics, (uint32_t)comp_type, (uint32_t)vec_length});
           vs->type = VST_VERTEX;
           vs->size = accessor.count;
-          vs->offset = doc.bufferViews[buffer_view_id].byteOffset + accessor.byteOffset;
+          vs->allocation_offset =
+            doc.bufferViews[buffer_view_id].byteOffset + accessor.byteOffset;
           vs->force_stride = doc.bufferViews[buffer_view_id].byteStride;
-          vs->buffer_ptr = buffers[buffer];
+          vs->allocation = buffers[buffer];
+          vs->buffer_ptr = vs->allocation->Buffer();
+          vs->offset = vs->allocation->Offset() + vs->allocation_offset;
           va->AddVertexStream(vs);
 
           SetAttribFlag(semantics, attrib_flags);
@@ -871,9 +936,11 @@ bool CreateSceneFromGLTFDoc(
           is->layout.push_back({INDEX, (uint32_t)comp_type, 1});
           is->type = VST_INDEX;
           is->size = accessor.count;
-          is->offset = doc.bufferViews[bv].byteOffset + accessor.byteOffset;
+          is->allocation_offset = doc.bufferViews[bv].byteOffset + accessor.byteOffset;
           is->force_stride = doc.bufferViews[bv].byteStride;
-          is->buffer_ptr = buffers[doc.bufferViews[bv].buffer];
+          is->allocation = buffers[doc.bufferViews[bv].buffer];
+          is->buffer_ptr = is->allocation->Buffer();
+          is->offset = is->allocation->Offset() + is->allocation_offset;
           va->SetIndexStream(is);
         }
 
@@ -905,6 +972,10 @@ bool CreateSceneFromGLTFDoc(
           break;
         };
 
+        if (en.RetainCPUGeometry()) {
+          va->SetTriangleMesh(LoadTriangleMesh(doc, p));
+        }
+
         // set material, queue, layer
         int32_t mat_id = p.material;
         if (mat_id >= 0) {
@@ -923,27 +994,18 @@ bool CreateSceneFromGLTFDoc(
             *shadowmap_effect_name = "mineola:effect:shadowmap_fallback";
           }
         } else if (sfx_flags || shadownmap_effect_type == PBRShadowmapEffectType::kBuiltIn) {
-          // create or choose proper PBR shader
-          const auto &mat_flags = materials_flags[mat_id];
-          auto sfx_flags_or_default = sfx_flags ? *sfx_flags : SFXFlags();
-          auto pbr_effects = SelectOrCreatePBREffect(
-            sfx_flags_or_default, mat_flags, attrib_flags, use_env_light);
-
-          if (!pbr_effects) {
-            // creation failed, use fallback
-            if (sfx_flags) {
-              effect_name = "mineola:effect:fallback";
-            }
-            if (shadownmap_effect_type == PBRShadowmapEffectType::kBuiltIn) {
-              *shadowmap_effect_name = "mineola:effect:shadowmap_fallback";
-            }
-          } else {
-            if (sfx_flags) {
-              effect_name = std::move(std::get<0>(*pbr_effects));
-            }
-            if (shadownmap_effect_type == PBRShadowmapEffectType::kBuiltIn) {
-              *shadowmap_effect_name = std::get<1>(*pbr_effects);
-            }
+          // choose proper PBR shader. Renderables whose effects fail to be created, or are
+          // still linking, draw with the fallback effects
+          PBRPermutation perm{sfx_flags ? *sfx_flags : SFXFlags(), materials_flags[mat_id],
+            attrib_flags, use_env_light};
+          auto pbr_effects = PBREffectNames(perm);
+          pbr_perms.push_back(perm);
+
+          if (sfx_flags) {
+            effect_name = std::move(pbr_effects.first);
+          }
+          if (shadownmap_effect_type == PBRShadowmapEffectType::kBuiltIn) {
+            *shadowmap_effect_name = std::move(pbr_effects.second);
           }
         }
 
@@ -957,6 +1019,10 @@ bool CreateSceneFromGLTFDoc(
 
       meshes.push_back(std::move(mesh));
     }
+
+    if (!CreatePBREffects(pbr_perms, en.AsyncEffectLinking())) {
+      MLOG("Failed to create some PBR effects of %s, using the fallback\n", model_name.c_str());
+    }
   }
 
   // load KHR_lights_punctual
@@ -1018,8 +1084,9 @@ bool CreateSceneFromGLTFDoc(
       }
 
       if (n.mesh >= 0) {
-        std::copy(meshes[n.mesh].begin(), meshes[n.mesh].end(),
-          std::back_inserter(node->Renderables()));
+        for (auto &renderable : meshes[n.mesh]) {
+          node->AddRenderable(renderable);
+        }
       }
 
       // extensions
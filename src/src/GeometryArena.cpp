@@ -0,0 +1,218 @@
+#include "prefix.h"
+#include <mineola/GeometryArena.h>
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#include <mineola/glutility.h>
+#include <mineola/Engine.h>
+#include <mineola/GraphicsBuffer.h>
+#include <mineola/VertexType.h>
+
+namespace {
+
+uint32_t AlignSize(uint32_t size) {
+  using mineola::GeometryArena;
+  return (size + GeometryArena::kAlignment - 1) & ~(uint32_t)(GeometryArena::kAlignment - 1);
+}
+
+}
+
+namespace mineola {
+
+struct GeometryAllocation::Page {
+  uint32_t target;
+  uint32_t capacity;
+  std::shared_ptr<GraphicsBuffer> buffer;
+  std::map<uint32_t, uint32_t> free_blocks;  // offset -> size, never adjacent
+  std::unordered_set<GeometryAllocation*> allocations;
+
+  // best fit, size is aligned
+  bool Allocate(uint32_t size, uint32_t *offset) {
+    auto best = free_blocks.end();
+    for (auto iter = free_blocks.begin(); iter != free_blocks.end(); ++iter) {
+      if (iter->second >= size && (best == free_blocks.end() || iter->second < best->second)) {
+        best = iter;
+      }
+    }
+    if (best == free_blocks.end()) {
+      return false;
+    }
+    *offset = best->first;
+    uint32_t remaining = best->second - size;
+    free_blocks.erase(best);
+    if (remaining > 0) {
+      free_blocks[*offset + size] = remaining;
+    }
+    return true;
+  }
+
+  void Free(uint32_t offset, uint32_t size) {
+    auto next = free_blocks.lower_bound(offset);
+    if (next != free_blocks.end() && offset + size == next->first) {
+      size += next->second;
+      next = free_blocks.erase(next);
+    }
+    if (next != free_blocks.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == offset) {
+        prev->second += size;
+        return;
+      }
+    }
+    free_blocks[offset] = size;
+  }
+
+  bool IsFragmented() const {
+    // free space other than a single block at the end
+    return free_blocks.size() > 1 || (free_blocks.size() == 1 &&
+      free_blocks.begin()->first + free_blocks.begin()->second != capacity);
+  }
+};
+
+GeometryAllocation::GeometryAllocation(const std::shared_ptr<Page> &page,
+  uint32_t offset, uint32_t size)
+  : page_(page), buffer_(page->buffer), offset_(offset), size_(size) {
+  page->allocations.insert(this);
+}
+
+GeometryAllocation::~GeometryAllocation() {
+  if (auto page = page_.lock()) {
+    page->allocations.erase(this);
+    page->Free(offset_, size_);
+  }
+}
+
+const std::shared_ptr<GraphicsBuffer> &GeometryAllocation::Buffer() const {
+  return buffer_;
+}
+
+uint32_t GeometryAllocation::Offset() const {
+  return offset_;
+}
+
+uint32_t GeometryAllocation::Size() const {
+  return size_;
+}
+
+GeometryArena::GeometryArena(uint32_t page_size)
+  : page_size_(AlignSize(page_size)), generation_(0) {
+}
+
+GeometryArena::~GeometryArena() {
+}
+
+std::shared_ptr<GeometryArena::Page> GeometryArena::CreatePage(uint32_t target,
+  uint32_t capacity) {
+  auto page = std::make_shared<Page>();
+  page->target = target;
+  page->capacity = capacity;
+  page->buffer = std::make_shared<GraphicsBuffer>(GraphicsBuffer::STATIC,
+    GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, target);
+  page->buffer->SetSize(capacity);
+  page->free_blocks[0] = capacity;
+  return page;
+}
+
+std::shared_ptr<GeometryAllocation> GeometryArena::Allocate(uint32_t target, uint32_t size,
+  const void *data) {
+  if (size == 0) {
+    return nullptr;
+  }
+  uint32_t aligned_size = AlignSize(size);
+
+  std::shared_ptr<Page> page;
+  uint32_t offset = 0;
+  for (const auto &candidate : pages_) {
+    if (candidate->target == target && candidate->Allocate(aligned_size, &offset)) {
+      page = candidate;
+      break;
+    }
+  }
+  if (!page) {
+    page = CreatePage(target, std::max(aligned_size, page_size_));
+    pages_.push_back(page);
+    page->Allocate(aligned_size, &offset);
+  }
+
+  std::shared_ptr<GeometryAllocation> allocation(
+    new GeometryAllocation(page, offset, aligned_size));
+  if (data) {
+    page->buffer->UpdateData(offset, size, data);
+  }
+  return allocation;
+}
+
+bool GeometryArena::AllocateStream(vertex_type::VertexStream &stream, uint32_t target,
+  const void *data) {
+  auto allocation = Allocate(target, stream.Stride() * stream.size, data);
+  if (!allocation) {
+    return false;
+  }
+  stream.allocation = allocation;
+  stream.allocation_offset = 0;
+  stream.buffer_ptr = allocation->Buffer();
+  stream.offset = allocation->Offset();
+  return true;
+}
+
+void GeometryArena::Defragment() {
+  auto &mgr = Engine::Instance().RenderStateMgr();
+  bool moved = false;
+  for (auto iter = pages_.begin(); iter != pages_.end();) {
+    auto &page = *iter;
+    if (page->allocations.empty()) {
+      iter = pages_.erase(iter);
+      continue;
+    }
+    if (page->IsFragmented()) {
+      std::vector<GeometryAllocation*> live(page->allocations.begin(), page->allocations.end());
+      std::sort(live.begin(), live.end(), [](const GeometryAllocation *lhs,
+        const GeometryAllocation *rhs) { return lhs->offset_ < rhs->offset_; });
+
+      // copy into fresh storage, draws already submitted keep reading the old buffer
+      auto buffer = std::make_shared<GraphicsBuffer>(GraphicsBuffer::STATIC,
+        GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, page->target);
+      buffer->SetSize(page->capacity);
+      mgr.BindBuffer(GL_COPY_READ_BUFFER, page->buffer->Handle());
+      mgr.BindBuffer(GL_COPY_WRITE_BUFFER, buffer->Handle());
+      uint32_t offset = 0;
+      for (auto allocation : live) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+          allocation->offset_, offset, allocation->size_);
+        allocation->offset_ = offset;
+        allocation->buffer_ = buffer;
+        offset += allocation->size_;
+      }
+      CHKGLERR
+
+      page->buffer = buffer;
+      page->free_blocks.clear();
+      if (offset < page->capacity) {
+        page->free_blocks[offset] = page->capacity - offset;
+      }
+      moved = true;
+    }
+    ++iter;
+  }
+  if (moved) {
+    ++generation_;
+  }
+}
+
+uint32_t GeometryArena::Generation() const {
+  return generation_;
+}
+
+void GeometryArena::Release() {
+  pages_.clear();
+}
+
+size_t GeometryArena::NumPages() const {
+  return pages_.size();
+}
+
+uint32_t GeometryArena::PageSize() const {
+  return page_size_;
+}
+
+} // namespace
@@ -3,6 +3,7 @@
 #include <mineola/GraphicsBuffer.h>
 #include <mineola/TypeMapping.h>
 #include <mineola/glutility.h>
+#include <mineola/Engine.h>
 
 namespace mineola {
 
@@ -55,6 +56,7 @@ namespace mineola {
   GraphicsBuffer::~GraphicsBuffer() {
     if (buffer_handle_) {
       glDeleteBuffers(1, &buffer_handle_);
+      Engine::Instance().RenderStateMgr().OnBufferDeleted(buffer_handle_);
     }
   }
 
@@ -62,19 +64,41 @@ namespace mineola {
     return buffer_handle_;
   }
 
+  void GraphicsBuffer::BindTarget(uint32_t target, uint32_t handle) {
+    auto &mgr = Engine::Instance().RenderStateMgr();
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+      // the index buffer binding belongs to the bound vertex array, which stays bound
+      // after draws. Only VertexArray sets it up.
+      mgr.BindVertexArray(0);
+    }
+    mgr.BindBuffer(target, handle);
+  }
+
+  void GraphicsBuffer::EndUpdate() {
+    // other buffers stay bound, a bound pixel buffer would redirect later pixel transfers
+    if (targets_[0] == GL_PIXEL_PACK_BUFFER || targets_[0] == GL_PIXEL_UNPACK_BUFFER) {
+      BindTarget(targets_[0], 0);
+    }
+  }
+
   void GraphicsBuffer::Bind() {
     for (auto target : targets_) {
-      glBindBuffer(target, buffer_handle_);
+      BindTarget(target, buffer_handle_);
     }
   }
 
   void GraphicsBuffer::BindBase() {
-    glBindBufferBase(targets_[0], index_, buffer_handle_);
+    Engine::Instance().RenderStateMgr().BindBufferBase(targets_[0], index_, buffer_handle_);
+  }
+
+  void GraphicsBuffer::BindRange(uint32_t offset, uint32_t size) {
+    Engine::Instance().RenderStateMgr().BindBufferRange(
+      targets_[0], index_, buffer_handle_, offset, size);
   }
 
   void GraphicsBuffer::Unbind() {
     for (auto target : targets_) {
-      glBindBuffer(target, 0);
+      BindTarget(target, 0);
     }
   }
 
@@ -83,25 +107,29 @@ namespace mineola {
   }
 
   bool GraphicsBuffer::SetSize(uint32_t size) {
-    glBindBuffer(targets_[0], buffer_handle_);
+    BindTarget(targets_[0], buffer_handle_);
     glBufferData(targets_[0], size, 0, type_mapping::Usage2GL(frequency_, direction_));
-    glBindBuffer(targets_[0], 0);
+    EndUpdate();
     size_ = size;
     return true;
   }
 
   bool GraphicsBuffer::SetData(uint32_t size, const void *data) {
-    glBindBuffer(targets_[0], buffer_handle_);
+    BindTarget(targets_[0], buffer_handle_);
     glBufferData(targets_[0], size, data, type_mapping::Usage2GL(frequency_, direction_));
-    glBindBuffer(targets_[0], 0);
+    EndUpdate();
     size_ = size;
     return true;
   }
 
   bool GraphicsBuffer::UpdateData(uint32_t offset, uint32_t size, const void *data) {
-    glBindBuffer(targets_[0], buffer_handle_);
+    if (frequency_ == STREAM && offset == 0 && size == size_) {
+      // fresh storage rather than waiting for pending draws of the old contents
+      return SetData(size, data);
+    }
+    BindTarget(targets_[0], buffer_handle_);
     glBufferSubData(targets_[0], offset, size, data);
-    glBindBuffer(targets_[0], 0);
+    EndUpdate();
     return true;
   }
 
@@ -109,7 +137,24 @@ namespace mineola {
     return glMapBufferRange(targets_[0], 0, size_, type_mapping::Access2GL(access_));
   }
 
+  void *GraphicsBuffer::MapRange(uint32_t offset, uint32_t size, uint32_t access_bits) {
+    BindTarget(targets_[0], buffer_handle_);
+    return glMapBufferRange(targets_[0], offset, size, access_bits);
+  }
+
+  void *GraphicsBuffer::MapForWrite() {
+    if (size_ == 0) {
+      return nullptr;
+    }
+    BindTarget(targets_[0], buffer_handle_);
+    glBufferData(targets_[0], size_, nullptr, type_mapping::Usage2GL(frequency_, direction_));
+    return glMapBufferRange(targets_[0], 0, size_,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  }
+
   void GraphicsBuffer::Unmap() {
+    BindTarget(targets_[0], buffer_handle_);
     glUnmapBuffer(targets_[0]);
+    EndUpdate();
   }
 }
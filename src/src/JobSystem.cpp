@@ -0,0 +1,131 @@
+#include "prefix.h"
+#include <mineola/JobSystem.h>
+#include <iterator>
+
+namespace {
+// index of the worker running on this thread, -1 on other threads
+thread_local int32_t tls_worker_idx = -1;
+}
+
+namespace mineola {
+
+bool JobSystem::Group::Done() const {
+  return pending_.load(std::memory_order_acquire) == 0;
+}
+
+JobSystem &JobSystem::Instance() {
+  static JobSystem job_system;
+  return job_system;
+}
+
+JobSystem::JobSystem() {
+  const uint32_t num_threads = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+  for (uint32_t idx = 0; idx <= num_threads; ++idx) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (uint32_t idx = 0; idx < num_threads; ++idx) {
+    threads_.emplace_back(&JobSystem::WorkerLoop, this, idx);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  sleep_cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+uint32_t JobSystem::Concurrency() const {
+  return (uint32_t)threads_.size() + 1;
+}
+
+void JobSystem::Submit(job_t job, Group &group) {
+  group.pending_.fetch_add(1, std::memory_order_relaxed);
+  const uint32_t idx = tls_worker_idx >= 0 ? (uint32_t)tls_worker_idx : (uint32_t)threads_.size();
+  // counted before it can be popped, sleeping workers only wake up for queued jobs
+  num_queued_.fetch_add(1, std::memory_order_relaxed);
+  {
+    auto &worker = *workers_[idx];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.jobs.push_back({std::move(job), &group});
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+  }
+  sleep_cv_.notify_one();
+}
+
+void JobSystem::Wait(Group &group) {
+  const uint32_t idx = tls_worker_idx >= 0 ? (uint32_t)tls_worker_idx : (uint32_t)threads_.size();
+  while (!group.Done()) {
+    if (!TryRun(idx, &group)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+bool JobSystem::Pop(Worker &worker, bool back, const Group *group, Job &job) {
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.jobs.empty()) {
+    return false;
+  }
+  auto iter = worker.jobs.end();
+  if (!group) {
+    iter = back ? worker.jobs.end() - 1 : worker.jobs.begin();
+  } else if (back) {
+    auto riter = std::find_if(worker.jobs.rbegin(), worker.jobs.rend(),
+      [group](const Job &job) { return job.group == group; });
+    if (riter != worker.jobs.rend()) {
+      iter = std::prev(riter.base());
+    }
+  } else {
+    iter = std::find_if(worker.jobs.begin(), worker.jobs.end(),
+      [group](const Job &job) { return job.group == group; });
+  }
+  if (iter == worker.jobs.end()) {
+    return false;
+  }
+  job = std::move(*iter);
+  worker.jobs.erase(iter);
+  num_queued_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool JobSystem::TryRun(uint32_t idx, const Group *group) {
+  Job job;
+  // own jobs newest first for locality, others' oldest first as they tend to be the largest
+  bool found = Pop(*workers_[idx], true, group, job);
+  const uint32_t num_workers = (uint32_t)workers_.size();
+  for (uint32_t offset = 1; !found && offset < num_workers; ++offset) {
+    found = Pop(*workers_[(idx + offset) % num_workers], false, group, job);
+  }
+  if (!found) {
+    return false;
+  }
+
+  job.func();
+  job.group->pending_.fetch_sub(1, std::memory_order_release);
+  return true;
+}
+
+void JobSystem::WorkerLoop(uint32_t idx) {
+  tls_worker_idx = (int32_t)idx;
+  while (true) {
+    if (TryRun(idx, nullptr)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.wait(lock, [this]() {
+      return stop_ || num_queued_.load(std::memory_order_relaxed) > 0;
+    });
+    if (stop_ && num_queued_.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+  }
+}
+
+} // namespace
@@ -36,19 +36,21 @@ void PointLight::SetIntensity(glm::vec3 intensity) {
 }
 
 void PointLight::UploadUniforms(glm::vec4 &v4, UniformBlock *ub) {
-  auto idx_str = std::to_string(idx_);
-  auto var_name = "_light_pos_" + idx_str;
-  ub->UpdateVariable(var_name.c_str(), glm::value_ptr(v4));
+  if (idx_ >= (size_t)UniformBlock::kNumBuiltinLights) {
+    return;
+  }
+  // position and intensity of each light are interleaved in the builtin block
+  int32_t pos_var = UniformBlock::LIGHT_POS_0 + 2 * (int32_t)idx_;
+  ub->UpdateVariable(pos_var, glm::value_ptr(v4));
 
   v4 = glm::vec4(intensity_, 1.0f);
-  var_name = "_light_intensity_" + idx_str;
-  ub->UpdateVariable(var_name.c_str(), glm::value_ptr(v4));
+  ub->UpdateVariable(pos_var + 1, glm::value_ptr(v4));
 
-  var_name = "_light_view_mat_" + idx_str;
-  ub->UpdateVariable(var_name.c_str(), glm::value_ptr(view_mat_));
-
-  var_name = "_light_proj_mat_" + idx_str;
-  ub->UpdateVariable(var_name.c_str(), glm::value_ptr(proj_mat_));
+  // only the first light casts shadows
+  if (idx_ == 0) {
+    ub->UpdateVariable(UniformBlock::LIGHT_VIEW_MAT_0, glm::value_ptr(view_mat_));
+    ub->UpdateVariable(UniformBlock::LIGHT_PROJ_MAT_0, glm::value_ptr(proj_mat_));
+  }
 }
 
 void PointLight::UpdateUniforms(UniformBlock *ub) {
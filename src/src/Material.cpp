@@ -1,14 +1,20 @@
 #include "prefix.h"
 #include <mineola/Material.h>
+#include <algorithm>
+#include <cstring>
 #include <glm/gtc/type_ptr.hpp>
 #include <mineola/GLEffect.h>
 #include <mineola/Engine.h>
 #include <mineola/Texture.h>
 #include <mineola/glutility.h>
 #include <mineola/ReservedTextureUnits.h>
+#include <mineola/GraphicsBuffer.h>
+#include <mineola/UniformBlock.h>
 
 namespace {
     const mineola::TextureTransform kDefaultTransform;
+    const size_t kMaxBindings = 8;
+    static_assert(sizeof(mineola::MaterialUniforms) == 64, "std140 layout mismatch");
 }
 
 namespace mineola {
@@ -19,53 +25,176 @@ void TextureTransform::UploadToShader(const char *tex_name, GLEffect *effect) co
   effect->UploadVariable((var_name + "_rot").c_str(), &rotation);
 }
 
+void TextureTransform::UploadToShader(int32_t ts_handle, int32_t rot_handle,
+  GLEffect *effect) const {
+  effect->UploadVariable(ts_handle, glm::value_ptr(offset_scale));
+  effect->UploadVariable(rot_handle, &rotation);
+}
+
+Material::Material() {
+  memset(&uploaded_uniforms_, 0, sizeof(uploaded_uniforms_));
+}
+
+Material::~Material() {
+}
+
+void Material::UpdateUniformBuffer() {
+  MaterialUniforms uniforms;
+  memset(&uniforms, 0, sizeof(uniforms));
+  uniforms.ambient = ambient;
+  uniforms.alpha = alpha;
+  uniforms.diffuse = diffuse;
+  uniforms.specularity = specularity;
+  uniforms.specular = specular;
+  uniforms.roughness = roughness;
+  uniforms.emit = emit;
+
+  if (!uniform_buffer_) {
+    uniform_buffer_ = std::make_unique<GraphicsBuffer>(GraphicsBuffer::DYNAMIC,
+      GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, GL_UNIFORM_BUFFER,
+      UniformBlock::GetSemanticsBindLocation(UniformBlock::MATERIAL_UNIFORMS));
+    uniform_buffer_->SetData(sizeof(uniforms), &uniforms);
+  } else if (memcmp(&uniforms, &uploaded_uniforms_, sizeof(uniforms)) != 0) {
+    uniform_buffer_->UpdateData(0, sizeof(uniforms), &uniforms);
+  } else {
+    return;
+  }
+  uploaded_uniforms_ = uniforms;
+}
+
 void Material::UploadToShader(GLEffect *effect) {
-  effect->UploadVariable("ambient", glm::value_ptr(ambient));
-  effect->UploadVariable("diffuse", glm::value_ptr(diffuse));
-  effect->UploadVariable("specular", glm::value_ptr(specular));
-  effect->UploadVariable("emit", glm::value_ptr(emit));
-  effect->UploadVariable("alpha", &alpha);
-  effect->UploadVariable("specularity", &specularity);
-  effect->UploadVariable("roughness", &roughness);
+  const auto &binding = GetBinding(effect);
+  if (binding.material_block) {
+    UpdateUniformBuffer();
+    uniform_buffer_->BindRange(0, sizeof(MaterialUniforms));
+  } else {
+    effect->UploadVariable(binding.ambient, glm::value_ptr(ambient));
+    effect->UploadVariable(binding.diffuse, glm::value_ptr(diffuse));
+    effect->UploadVariable(binding.specular, glm::value_ptr(specular));
+    effect->UploadVariable(binding.emit, glm::value_ptr(emit));
+    effect->UploadVariable(binding.alpha, &alpha);
+    effect->UploadVariable(binding.specularity, &specularity);
+    effect->UploadVariable(binding.roughness, &roughness);
+  }
 
   // upload uniforms
-  for (const auto &kvp : uniform_slots) {
-    kvp.second->UploadToShader(kvp.first.c_str(), effect);
+  for (const auto &uniform : binding.uniforms) {
+    uniform.wrapper->UploadToShader(uniform.handle, effect);
   }
 
   // upload textures
-  int32_t tex_unit = kNumReservedTextureUnits;
-  for (auto iter = texture_slots.begin(); iter != texture_slots.end(); ++iter) {
-    static std::vector<int32_t> tex_units;
-    if (iter->second.size() > tex_units.size()) {
-     tex_units.resize(iter->second.size());
+  for (const auto &slot : binding.textures) {
+    for (size_t i = 0; i < slot.textures.size(); ++i) {
+      slot.textures[i]->BindToUnit(slot.units[i]);
     }
+    effect->UploadVariable(slot.sampler, &slot.units[0]);
+    slot.tform.UploadToShader(slot.ts, slot.rot, effect);
+  }
+}
 
+void Material::SetTextureSlot(const std::string &name, std::vector<std::string> texture_names) {
+  texture_slots[name] = std::move(texture_names);
+  // textures and units are resolved by name
+  InvalidateBindings();
+}
+
+void Material::SetTextureTransform(const std::string &name, const TextureTransform &tform) {
+  texture_tforms[name] = tform;
+  // patched in place, transforms may be animated per frame
+  for (auto &binding : bindings_) {
+    for (auto &slot : binding.textures) {
+      if (slot.name == name) {
+        slot.tform = tform;
+      }
+    }
+  }
+}
+
+void Material::SetUniformSlot(const std::string &name, std::shared_ptr<UniformWrapper> wrapper) {
+  bool is_new = uniform_slots.find(name) == uniform_slots.end();
+  if (!is_new) {
+    for (auto &binding : bindings_) {
+      for (auto &uniform : binding.uniforms) {
+        if (uniform.name == name) {
+          uniform.wrapper = wrapper;
+        }
+      }
+    }
+  }
+  uniform_slots[name] = std::move(wrapper);
+  if (is_new) {
+    InvalidateBindings();
+  }
+}
+
+void Material::InvalidateBindings() {
+  bindings_.clear();
+}
+
+const Material::Binding &Material::GetBinding(GLEffect *effect) {
+  auto &resrc_mgr = Engine::Instance().ResrcMgr();
+  const uint32_t link_version = effect->LinkVersion();
+  const uint32_t generation = resrc_mgr.Generation();
+  for (const auto &binding : bindings_) {
+    if (binding.link_version == link_version && binding.resource_generation == generation) {
+      return binding;
+    }
+  }
+
+  // drop bindings resolved against replaced resources, start over if effects keep relinking
+  if (bindings_.size() >= kMaxBindings) {
+    bindings_.clear();
+  }
+  bindings_.erase(std::remove_if(bindings_.begin(), bindings_.end(), [&](const Binding &binding) {
+    return binding.resource_generation != generation;
+  }), bindings_.end());
+
+  Binding binding;
+  binding.link_version = link_version;
+  binding.resource_generation = generation;
+  binding.material_block = effect->GetUniformBlockBinding(
+    UniformBlock::GetSemanticsString(UniformBlock::MATERIAL_UNIFORMS)) >= 0;
+  binding.ambient = effect->GetUniformHandle("ambient");
+  binding.diffuse = effect->GetUniformHandle("diffuse");
+  binding.specular = effect->GetUniformHandle("specular");
+  binding.emit = effect->GetUniformHandle("emit");
+  binding.alpha = effect->GetUniformHandle("alpha");
+  binding.specularity = effect->GetUniformHandle("specularity");
+  binding.roughness = effect->GetUniformHandle("roughness");
+
+  for (const auto &kvp : uniform_slots) {
+    binding.uniforms.push_back({kvp.first, effect->GetUniformHandle(kvp.first.c_str()),
+      kvp.second});
+  }
+
+  int32_t tex_unit = kNumReservedTextureUnits;
+  for (const auto &kvp : texture_slots) {
+    TextureBinding slot;
+    slot.name = kvp.first;
     bool all_found = true;
-    for (size_t i = 0; i < iter->second.size(); ++i) {
-      auto texture = bd_cast<Texture>(
-        Engine::Instance().ResrcMgr().Find(iter->second[i].c_str()));
+    for (const auto &texture_name : kvp.second) {
+      auto texture = bd_cast<Texture>(resrc_mgr.Find(texture_name));
       if (!texture) {
         all_found = false;
         break;
       }
-
-      tex_units[i] = tex_unit;
-      glActiveTexture(GL_TEXTURE0 + tex_unit);
-      texture->Bind();
-      ++tex_unit;
+      slot.textures.push_back(std::move(texture));
+      slot.units.push_back(tex_unit++);
     }
-    if (!all_found)
+    if (!all_found || slot.textures.empty()) {
       continue;
-
-    effect->UploadVariable(iter->first.c_str(), &tex_units[0]);
-    
-    if (auto trs_iter = texture_tforms.find(iter->first); trs_iter != texture_tforms.end()) {
-      trs_iter->second.UploadToShader(iter->first.c_str(), effect);
-    } else {
-      kDefaultTransform.UploadToShader(iter->first.c_str(), effect);
     }
- }
+
+    slot.sampler = effect->GetUniformHandle(kvp.first.c_str());
+    slot.ts = effect->GetUniformHandle((kvp.first + "_ts").c_str());
+    slot.rot = effect->GetUniformHandle((kvp.first + "_rot").c_str());
+    auto trs_iter = texture_tforms.find(kvp.first);
+    slot.tform = trs_iter != texture_tforms.end() ? trs_iter->second : kDefaultTransform;
+    binding.textures.push_back(std::move(slot));
+  }
+
+  bindings_.push_back(std::move(binding));
+  return bindings_.back();
 }
 
 } //namespace
@@ -29,7 +29,7 @@ bool LoadPolygonSoup(const PolygonSoup &soup,
   renderable->SetLayerMask(layer_mask);
 
   auto node = std::make_shared<SceneNode>();
-  node->Renderables().push_back(renderable);
+  node->AddRenderable(renderable);
   SceneNode::LinkTo(node, parent_node);
 
   return true;
@@ -0,0 +1,63 @@
+#include "prefix.h"
+#include <mineola/NameRegistry.h>
+#include <algorithm>
+
+namespace mineola {
+
+NameRegistry::NameRegistry() {
+  Intern("");
+}
+
+NameRegistry::~NameRegistry() {
+}
+
+NameRegistry &NameRegistry::Instance() {
+  static NameRegistry registry;
+  return registry;
+}
+
+uint32_t NameRegistry::Intern(std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = ids_.find(name);
+  if (iter != ids_.end()) {
+    return iter->second;
+  }
+  uint32_t id = (uint32_t)strings_.size();
+  strings_.emplace_back(name);
+  ids_[strings_.back()] = id;
+  nodes_.emplace_back();
+  return id;
+}
+
+uint32_t NameRegistry::Find(std::string_view name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = ids_.find(name);
+  return iter != ids_.end() ? iter->second : (uint32_t)kInvalidName;
+}
+
+const std::string &NameRegistry::Str(uint32_t id) const {
+  // deque elements stay in place as strings are appended
+  std::lock_guard<std::mutex> lock(mutex_);
+  return strings_[id];
+}
+
+void NameRegistry::AddNode(uint32_t id, SceneNode *node) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  nodes_[id].push_back(node);
+}
+
+void NameRegistry::RemoveNode(uint32_t id, SceneNode *node) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &nodes = nodes_[id];
+  auto iter = std::find(nodes.begin(), nodes.end(), node);
+  if (iter != nodes.end()) {
+    nodes.erase(iter);
+  }
+}
+
+std::vector<SceneNode *> NameRegistry::Nodes(uint32_t id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nodes_[id];
+}
+
+} // namespace
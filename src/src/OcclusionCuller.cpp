@@ -0,0 +1,250 @@
+#include "prefix.h"
+#include <mineola/OcclusionCuller.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mineola/TriangleMesh.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MINEOLA_OCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// vertices closer than this (in clip w) are treated as crossing the near plane
+const float kMinClipW = 1e-5f;
+
+}
+
+namespace mineola {
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height) {
+  Resize(width, height);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+}
+
+void OcclusionCuller::Resize(uint32_t width, uint32_t height) {
+  width = std::max<uint32_t>((width + 3) & ~3u, 4);
+  height = std::max<uint32_t>(height, 1);
+
+  levels_.clear();
+  uint32_t w = width, h = height;
+  while (true) {
+    levels_.push_back({w, h, std::vector<float>(w * h, 1.f)});
+    if (w == 1 && h == 1) {
+      break;
+    }
+    w = std::max<uint32_t>((w + 1) / 2, 1);
+    h = std::max<uint32_t>((h + 1) / 2, 1);
+  }
+}
+
+void OcclusionCuller::Clear() {
+  std::fill(levels_[0].depth.begin(), levels_[0].depth.end(), 1.f);
+}
+
+uint32_t OcclusionCuller::Width() const {
+  return levels_[0].width;
+}
+
+uint32_t OcclusionCuller::Height() const {
+  return levels_[0].height;
+}
+
+const std::vector<float> &OcclusionCuller::DepthBuffer() const {
+  return levels_[0].depth;
+}
+
+void OcclusionCuller::RasterizeOccluder(const TriangleMesh &mesh, const glm::mat4 &mvp) {
+  const auto &positions = mesh.Positions();
+  const auto &indices = mesh.Indices();
+
+  clip_verts_.resize(positions.size());
+  for (size_t idx = 0; idx < positions.size(); ++idx) {
+    clip_verts_[idx] = mvp * glm::vec4(positions[idx], 1.f);
+  }
+
+  const float half_width = Width() * 0.5f;
+  const float half_height = Height() * 0.5f;
+  auto to_screen = [&](const glm::vec4 &clip) {
+    float inv_w = 1.f / clip.w;
+    return glm::vec3(
+      (clip.x * inv_w + 1.f) * half_width,
+      (clip.y * inv_w + 1.f) * half_height,
+      clip.z * inv_w * 0.5f + 0.5f);
+  };
+
+  for (size_t tri = 0; tri + 2 < indices.size(); tri += 3) {
+    const auto &c0 = clip_verts_[indices[tri]];
+    const auto &c1 = clip_verts_[indices[tri + 1]];
+    const auto &c2 = clip_verts_[indices[tri + 2]];
+    if (c0.w < kMinClipW || c1.w < kMinClipW || c2.w < kMinClipW) {
+      continue;
+    }
+    RasterizeTriangle(to_screen(c0), to_screen(c1), to_screen(c2));
+  }
+}
+
+void OcclusionCuller::RasterizeTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+  const int width = (int)Width();
+  const int height = (int)Height();
+
+  // occluders are double sided, make the winding counter-clockwise
+  float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+  if (std::abs(area) < 1e-8f) {
+    return;
+  }
+  if (area < 0.f) {
+    std::swap(v1, v2);
+    area = -area;
+  }
+
+  int min_x = std::max((int)std::floor(std::min(std::min(v0.x, v1.x), v2.x)), 0);
+  int max_x = std::min((int)std::ceil(std::max(std::max(v0.x, v1.x), v2.x)), width - 1);
+  int min_y = std::max((int)std::floor(std::min(std::min(v0.y, v1.y), v2.y)), 0);
+  int max_y = std::min((int)std::ceil(std::max(std::max(v0.y, v1.y), v2.y)), height - 1);
+  if (min_x > max_x || min_y > max_y) {
+    return;
+  }
+  min_x &= ~3;  // 4 pixel groups, width is a multiple of 4
+
+  // edge functions e(x, y) = a * x + b * y + c, positive inside.
+  // e12 weighs v0, e20 weighs v1, e01 weighs v2
+  const float a01 = v0.y - v1.y, b01 = v1.x - v0.x, c01 = v0.x * v1.y - v0.y * v1.x;
+  const float a12 = v1.y - v2.y, b12 = v2.x - v1.x, c12 = v1.x * v2.y - v1.y * v2.x;
+  const float a20 = v2.y - v0.y, b20 = v0.x - v2.x, c20 = v2.x * v0.y - v2.y * v0.x;
+  const float inv_area = 1.f / area;
+  const float dz1 = (v1.z - v0.z) * inv_area;
+  const float dz2 = (v2.z - v0.z) * inv_area;
+
+  auto &depth = levels_[0].depth;
+
+#ifdef MINEOLA_OCCLUSION_SSE2
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 step01 = _mm_set1_ps(a01 * 4.f);
+  const __m128 step12 = _mm_set1_ps(a12 * 4.f);
+  const __m128 step20 = _mm_set1_ps(a20 * 4.f);
+  const __m128 vz0 = _mm_set1_ps(v0.z);
+  const __m128 vdz1 = _mm_set1_ps(dz1);
+  const __m128 vdz2 = _mm_set1_ps(dz2);
+  const __m128 x_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+  for (int y = min_y; y <= max_y; ++y) {
+    const float py = y + 0.5f;
+    const __m128 px = _mm_add_ps(_mm_set1_ps((float)min_x), x_offsets);
+    __m128 e01 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a01), px), _mm_set1_ps(b01 * py + c01));
+    __m128 e12 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a12), px), _mm_set1_ps(b12 * py + c12));
+    __m128 e20 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a20), px), _mm_set1_ps(b20 * py + c20));
+    float *row = &depth[y * width];
+
+    for (int x = min_x; x <= max_x; x += 4) {
+      __m128 inside = _mm_and_ps(
+        _mm_and_ps(_mm_cmpge_ps(e01, zero), _mm_cmpge_ps(e12, zero)),
+        _mm_cmpge_ps(e20, zero));
+      if (_mm_movemask_ps(inside)) {
+        __m128 z = _mm_add_ps(vz0,
+          _mm_add_ps(_mm_mul_ps(e20, vdz1), _mm_mul_ps(e01, vdz2)));
+        __m128 old_z = _mm_loadu_ps(row + x);
+        __m128 closer = _mm_and_ps(inside, _mm_cmplt_ps(z, old_z));
+        _mm_storeu_ps(row + x,
+          _mm_or_ps(_mm_and_ps(closer, z), _mm_andnot_ps(closer, old_z)));
+      }
+      e01 = _mm_add_ps(e01, step01);
+      e12 = _mm_add_ps(e12, step12);
+      e20 = _mm_add_ps(e20, step20);
+    }
+  }
+#else
+  for (int y = min_y; y <= max_y; ++y) {
+    const float py = y + 0.5f;
+    float *row = &depth[y * width];
+    for (int x = min_x; x <= max_x; ++x) {
+      const float px = x + 0.5f;
+      float e01 = a01 * px + b01 * py + c01;
+      float e12 = a12 * px + b12 * py + c12;
+      float e20 = a20 * px + b20 * py + c20;
+      if (e01 >= 0.f && e12 >= 0.f && e20 >= 0.f) {
+        float z = v0.z + e20 * dz1 + e01 * dz2;
+        row[x] = std::min(row[x], z);
+      }
+    }
+  }
+#endif
+}
+
+void OcclusionCuller::BuildHiZ() {
+  for (size_t level = 1; level < levels_.size(); ++level) {
+    const auto &src = levels_[level - 1];
+    auto &dst = levels_[level];
+    for (uint32_t y = 0; y < dst.height; ++y) {
+      uint32_t y0 = std::min(y * 2, src.height - 1);
+      uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+      for (uint32_t x = 0; x < dst.width; ++x) {
+        uint32_t x0 = std::min(x * 2, src.width - 1);
+        uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+        dst.depth[y * dst.width + x] = std::max(
+          std::max(src.depth[y0 * src.width + x0], src.depth[y0 * src.width + x1]),
+          std::max(src.depth[y1 * src.width + x0], src.depth[y1 * src.width + x1]));
+      }
+    }
+  }
+}
+
+bool OcclusionCuller::IsVisible(const AABB &aabb, const glm::mat4 &proj_view) const {
+  glm::vec2 rect_min(std::numeric_limits<float>::max());
+  glm::vec2 rect_max(std::numeric_limits<float>::lowest());
+  float min_z = std::numeric_limits<float>::max();
+
+  for (uint32_t corner = 0; corner < 8; ++corner) {
+    glm::vec4 p(
+      (corner & 1) ? aabb.ub_.x : aabb.lb_.x,
+      (corner & 2) ? aabb.ub_.y : aabb.lb_.y,
+      (corner & 4) ? aabb.ub_.z : aabb.lb_.z,
+      1.f);
+    glm::vec4 clip = proj_view * p;
+    if (clip.w < kMinClipW) {
+      return true;  // crosses the near plane
+    }
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    rect_min = glm::min(rect_min, glm::vec2(ndc));
+    rect_max = glm::max(rect_max, glm::vec2(ndc));
+    min_z = std::min(min_z, ndc.z * 0.5f + 0.5f);
+  }
+
+  const float width = (float)Width();
+  const float height = (float)Height();
+  int x0 = (int)std::floor((rect_min.x + 1.f) * 0.5f * width);
+  int x1 = (int)std::floor((rect_max.x + 1.f) * 0.5f * width);
+  int y0 = (int)std::floor((rect_min.y + 1.f) * 0.5f * height);
+  int y1 = (int)std::floor((rect_max.y + 1.f) * 0.5f * height);
+  if (x1 < 0 || y1 < 0 || x0 >= (int)width || y0 >= (int)height) {
+    return true;  // off screen, nothing known about it
+  }
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, (int)width - 1);
+  y1 = std::min(y1, (int)height - 1);
+
+  // coarsest level at which the rect spans at most 2 texels per axis
+  uint32_t extent = (uint32_t)std::max(x1 - x0, y1 - y0);
+  uint32_t level = 0;
+  while (extent > 1 && level + 1 < levels_.size()) {
+    extent >>= 1;
+    ++level;
+  }
+
+  const auto &lvl = levels_[level];
+  for (int y = y0 >> level; y <= (y1 >> level); ++y) {
+    for (int x = x0 >> level; x <= (x1 >> level); ++x) {
+      if (min_z <= lvl.depth[y * lvl.width + x]) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+} // namespace
@@ -2,7 +2,9 @@
 #include <mineola/PBRShaders.h>
 #include <vector>
 #include <memory>
+#include <unordered_set>
 #include <mineola/Engine.h>
+#include <mineola/GLShader.h>
 #include <mineola/GLEffect.h>
 #include <mineola/RenderState.h>
 
@@ -43,6 +45,7 @@ out vec3 vcolor;
 #if defined(HAS_SKIN)
 #include "mineola_skinned_animation"
 #endif
+#include "mineola_instancing"
 
 vec3 Dir2WC(mat4 model_mat, vec3 dir) {
   return normalize((model_mat * vec4(normalize(dir), 0.0)).xyz);
@@ -55,7 +58,7 @@ void main(void) {
     + BlendWeight.z * _joint_mats[int(BlendIdx.z)]
     + BlendWeight.w * _joint_mats[int(BlendIdx.w)];
   #else
-  mat4 model_mat = _model_mat;
+  mat4 model_mat = _instance_model_mat;
   #endif
   vec4 pos = model_mat * vec4(Pos, 1.0);
   pos_wc = pos.xyz / pos.w;
@@ -91,6 +94,7 @@ in vec3 Pos;
 #if defined(HAS_SKIN)
 #include "mineola_skinned_animation"
 #endif
+#include "mineola_instancing"
 
 void main(void) {
   #if defined(HAS_SKIN)
@@ -99,7 +103,7 @@ void main(void) {
     + BlendWeight.z * _joint_mats[int(BlendIdx.z)]
     + BlendWeight.w * _joint_mats[int(BlendIdx.w)];
   #else
-  mat4 model_mat = _model_mat;
+  mat4 model_mat = _instance_model_mat;
   #endif
   vec4 pos = model_mat * vec4(Pos, 1.0);
   gl_Position = _light_proj_mat_0 * _light_view_mat_0 * pos;
@@ -164,11 +168,9 @@ uniform float alpha_threshold;  // alpha cut-off threshold
   #endif
 #endif
 
-uniform vec3 diffuse;  // albedo coefficient
-uniform float alpha;  // albedo transparency
-uniform float specularity;  // metallic coefficient
-uniform float roughness;  // roughness coefficient
-uniform vec3 emit;  // emissive coefficient
+// diffuse: albedo coefficient, alpha: albedo transparency, specularity: metallic coefficient,
+// roughness: roughness coefficient, emit: emissive coefficient
+#include "mineola_material"
 
 in vec3 pos_wc;
 
@@ -918,24 +920,53 @@ std::string AttribFlags::Abbrev() const {
   return result;
 }
 
-std::optional<std::pair<std::string, std::string>> SelectOrCreatePBREffect(
-  const SFXFlags &sfx_flags, const MaterialFlags &mat_flags,
-  const AttribFlags &attrib_flags, bool use_env_light) {
-
-  char env_light_abbre = use_env_light ? 'E' : 'e';
+std::pair<std::string, std::string> PBREffectNames(const PBRPermutation &perm) {
+  char env_light_abbre = perm.use_env_light ? 'E' : 'e';
 
   std::string effect_name = "mineola:effect:pbr:"
-    + sfx_flags.Abbrev()
-    + attrib_flags.Abbrev()
-    + mat_flags.Abbrev()
+    + perm.sfx_flags.Abbrev()
+    + perm.attrib_flags.Abbrev()
+    + perm.mat_flags.Abbrev()
     + env_light_abbre;
   std::string shadowmap_effect_name = effect_name + "s";
+  return std::make_pair(std::move(effect_name), std::move(shadowmap_effect_name));
+}
+
+bool CreatePBREffects(const std::vector<PBRPermutation> &perms, bool async) {
+  struct EffectBuild {
+    std::string name;
+    std::shared_ptr<GLEffect> effect;
+    std::shared_ptr<GLShader> vs, ps;
+  };
 
   auto &en = Engine::Instance();
-  auto effect = bd_cast<GLEffect>(en.ResrcMgr().Find(effect_name));
-  if (!effect) {
-    auto macros = CreatePBRShaderMacros(sfx_flags, mat_flags, attrib_flags);
-    if (use_env_light) {
+  bool result = true;
+  std::vector<EffectBuild> builds;
+  std::unordered_set<std::string> seen;
+
+  auto add_build = [&](std::string name, const char *vs_str, const char *ps_str,
+    const effect_defines_t &macros, std::vector<std::unique_ptr<RenderState>> render_states) {
+    EffectBuild build{std::move(name), std::make_shared<GLEffect>(),
+      std::make_shared<GLVertexShader>(), std::make_shared<GLPixelShader>()};
+    if (!build.vs->PreprocessFromMemory(vs_str, &macros)
+      || !build.ps->PreprocessFromMemory(ps_str, &macros)) {
+      result = false;
+      return;
+    }
+    build.effect->SetRenderStates(std::move(render_states));
+    builds.push_back(std::move(build));
+  };
+
+  for (const auto &perm : perms) {
+    auto names = PBREffectNames(perm);
+    if (!seen.insert(names.first).second
+      || en.ResrcMgr().Find(names.first) || en.IsEffectPending(names.first)) {
+      continue;
+    }
+
+    const auto &mat_flags = perm.mat_flags;
+    auto macros = CreatePBRShaderMacros(perm.sfx_flags, mat_flags, perm.attrib_flags);
+    if (perm.use_env_light) {
       macros.push_back({"USE_ENV_LIGHT", {}});
     }
 
@@ -947,22 +978,57 @@ std::optional<std::pair<std::string, std::string>> SelectOrCreatePBREffect(
     } else {
       render_states.push_back(std::make_unique<BlendEnableState>(false));
     }
-
-    if (!CreateEffectFromMemHelper(effect_name.c_str(),
-      pbr_vs_str, pbr_fs_str, &macros, std::move(render_states))) {
-      return std::nullopt;
-    }
+    add_build(std::move(names.first), pbr_vs_str, pbr_fs_str, macros, std::move(render_states));
 
     render_states = CreatePBRShaderCommonStates(mat_flags);
     render_states.push_back(std::make_unique<BlendEnableState>(false));
+    add_build(std::move(names.second), pbr_shadow_vs_str, pbr_shadow_fs_str, macros,
+      std::move(render_states));
+  }
+
+  // programs in the binary cache need no compiling. The others compile first, then link,
+  // querying no status in between.
+  std::vector<EffectBuild *> misses;
+  for (auto &build : builds) {
+    if (!build.effect->RestoreProgram(build.vs, build.ps)) {
+      misses.push_back(&build);
+    }
+  }
+  for (auto build : misses) {
+    build->vs->SubmitCompile();
+    build->ps->SubmitCompile();
+  }
+  for (auto build : misses) {
+    build->effect->LinkProgram();
+  }
 
-    if (!CreateEffectFromMemHelper(shadowmap_effect_name.c_str(),
-      pbr_shadow_vs_str, pbr_shadow_fs_str, &macros, std::move(render_states))) {
-      return std::nullopt;
+  for (auto &build : builds) {
+    if (async) {
+      en.AddPendingEffect(build.name, std::move(build.effect));
+    } else if (build.effect->FinishLink()) {
+      en.ResrcMgr().Add(build.name, bd_cast<Resource>(build.effect));
+    } else {
+      MLOG("Failed to create effect %s\n", build.name.c_str());
+      result = false;
     }
   }
+  return result;
+}
+
+std::optional<std::pair<std::string, std::string>> SelectOrCreatePBREffect(
+  const SFXFlags &sfx_flags, const MaterialFlags &mat_flags,
+  const AttribFlags &attrib_flags, bool use_env_light) {
+  PBRPermutation perm{sfx_flags, mat_flags, attrib_flags, use_env_light};
+  if (!CreatePBREffects({perm}, false)) {
+    return std::nullopt;
+  }
 
-  return std::make_pair(std::move(effect_name), std::move(shadowmap_effect_name));
+  auto names = PBREffectNames(perm);
+  auto &resrc_mgr = Engine::Instance().ResrcMgr();
+  if (!resrc_mgr.Find(names.first) || !resrc_mgr.Find(names.second)) {
+    return std::nullopt;  // still pending from an asynchronous creation
+  }
+  return names;
 }
 
 }  // namespace
@@ -7,6 +7,7 @@
 #include <mineola/PolygonSoup.h>
 #include <mineola/TextureHelper.h>
 #include <mineola/Engine.h>
+#include <mineola/TriangleMesh.h>
 
 namespace {
 using namespace mineola;
@@ -66,12 +67,7 @@ bool BuildFromPolygonSoup(const PolygonSoup &soup,
   }
   vs->type = VST_VERTEX;
   vs->size = (uint32_t)soup.vertices.size();
-  vs->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND,
-    GraphicsBuffer::READ_ONLY,
-    GL_ARRAY_BUFFER));
-  vs->buffer_ptr->Bind();
-  vs->buffer_ptr->SetData(vs->Stride() * vs->size, &verts_data[0]);
+  Engine::Instance().GeomArena().AllocateStream(*vs, GL_ARRAY_BUFFER, &verts_data[0]);
 
   verts_data.clear();
 
@@ -89,12 +85,7 @@ bool BuildFromPolygonSoup(const PolygonSoup &soup,
     is->layout.push_back({INDEX, type_mapping::UINT32, 1});
     is->type = VST_INDEX;
     is->size = (uint32_t)soup.edges.size() * 2;
-    is->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-      GraphicsBuffer::SEND,
-      GraphicsBuffer::READ_ONLY,
-      GL_ELEMENT_ARRAY_BUFFER));
-    is->buffer_ptr->Bind();
-    is->buffer_ptr->SetData(is->Stride() * is->size, &edges_data[0]);
+    Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER, &edges_data[0]);
     edges_data.clear();
     va->PrimitiveType() = GL_LINES;
   } else if (soup.faces.size() != 0) {
@@ -115,14 +106,19 @@ bool BuildFromPolygonSoup(const PolygonSoup &soup,
     is->layout.push_back({INDEX, type_mapping::UINT32, 1});
     is->type = VST_INDEX;
     is->size = (uint32_t)index_count;
-    is->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-      GraphicsBuffer::SEND,
-      GraphicsBuffer::READ_ONLY,
-      GL_ELEMENT_ARRAY_BUFFER));
-    is->buffer_ptr->Bind();
-    is->buffer_ptr->SetData(is->Stride() * is->size, &faces_data[0]);
-    faces_data.clear();
+    Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER, &faces_data[0]);
     va->PrimitiveType() = GL_TRIANGLES;
+
+    if (Engine::Instance().RetainCPUGeometry()) {
+      std::vector<glm::vec3> positions;
+      positions.reserve(soup.vertices.size());
+      for (const auto &vert : soup.vertices) {
+        positions.push_back(vert.pos);
+      }
+      va->SetTriangleMesh(std::make_shared<TriangleMesh>(
+        std::move(positions), std::move(faces_data)));
+    }
+    faces_data.clear();
   } else {
     // draw points
     std::vector<uint32_t> indices(soup.vertices.size());
@@ -131,12 +127,7 @@ bool BuildFromPolygonSoup(const PolygonSoup &soup,
     is->layout.push_back({INDEX, type_mapping::UINT32, 1});
     is->type = VST_INDEX;
     is->size = (uint32_t)indices.size();
-    is->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-      GraphicsBuffer::SEND,
-      GraphicsBuffer::READ_ONLY,
-      GL_ELEMENT_ARRAY_BUFFER));
-    is->buffer_ptr->Bind();
-    is->buffer_ptr->SetData(is->Stride() * is->size, &indices[0]);
+    Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER, &indices[0]);
     indices.clear();
     va->PrimitiveType() = GL_POINTS;
   }
@@ -160,7 +151,7 @@ bool BuildFromPolygonSoup(const PolygonSoup &soup,
   material->specular = glm::vec3(0.2f, 0.2f, 0.2f);
   material->emit = glm::vec3(0.f, 0.f, 0.f);
   if (!soup.texture_filename.empty()) {
-    material->texture_slots["diffuse_sampler"] = {soup.texture_filename};
+    material->SetTextureSlot("diffuse_sampler", {soup.texture_filename});
   }
   std::string material_name = "mat:";
   material_name.append(name);
@@ -185,10 +176,19 @@ bool UpdateVertexData(const PolygonSoup &soup, Renderable &renderable) {
 
   auto va = renderable.GetVertexArray(0);
   auto vs = va->VertexStreams()[0];
-  vs->buffer_ptr->Bind();
-  vs->buffer_ptr->UpdateData(0, vs->Stride() * vs->size, &verts_data[0]);
+  vs->buffer_ptr->UpdateData(vs->offset, vs->Stride() * vs->size, &verts_data[0]);
   va->MarkVertexUpdated();
 
+  if (const auto &mesh = va->GetTriangleMesh()) {
+    // picking geometry follows the vertices, its BVH is rebuilt on the next query
+    std::vector<glm::vec3> positions;
+    positions.reserve(soup.vertices.size());
+    for (const auto &vert : soup.vertices) {
+      positions.push_back(vert.pos);
+    }
+    va->SetTriangleMesh(std::make_shared<TriangleMesh>(std::move(positions), mesh->Indices()));
+  }
+
   return true;
 }
 
@@ -77,7 +77,7 @@ bool CreateSkybox(int layer_mask, bool srgb, SceneNode &node) {
   renderable->AddVertexArray(std::move(va), "mineola:material:fallback");
   renderable->SetEffect(effect_name);
   renderable->SetLayerMask(layer_mask);
-  node.Renderables().push_back(std::move(renderable));
+  node.AddRenderable(std::move(renderable));
   return true;
 }
 
@@ -88,7 +88,7 @@ void CreateAxes(int layer_mask, SceneNode &node) {
   renderable->AddVertexArray(std::move(va), "mineola:material:fallback");
   renderable->SetEffect("mineola:effect:diffusecolor");
   renderable->SetLayerMask(layer_mask);
-  node.Renderables().push_back(std::move(renderable));
+  node.AddRenderable(std::move(renderable));
 }
 
 }
@@ -3,7 +3,7 @@
 #include <map>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <mineola/GraphicsBuffer.h>
+#include <mineola/Engine.h>
 
 namespace mineola { namespace primitive_helper {
 
@@ -35,22 +35,12 @@ void BuildRect(float size, vertex_type::VertexArray &vertex_array) {
   vs->layout.push_back({TEXCOORD0, type_mapping::FLOAT32, 2});
   vs->type = VST_VERTEX;
   vs->size = 4;
-  vs->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND,
-    GraphicsBuffer::READ_ONLY,
-    GL_ARRAY_BUFFER));
-  vs->buffer_ptr->Bind();
-  vs->buffer_ptr->SetData(vs->Stride() * vs->size, &vertices[0]);
+  Engine::Instance().GeomArena().AllocateStream(*vs, GL_ARRAY_BUFFER, &vertices[0]);
 
   is->layout.push_back({INDEX, type_mapping::UINT32, 1});
   is->type = VST_INDEX;
   is->size = 6;
-  is->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND,
-    GraphicsBuffer::READ_ONLY,
-    GL_ELEMENT_ARRAY_BUFFER));
-  is->buffer_ptr->Bind();
-  is->buffer_ptr->SetData(is->Stride() * is->size, &indices[0]);
+  Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER, &indices[0]);
 
   vertex_array.AddVertexStream(vs);
   vertex_array.SetIndexStream(is);
@@ -84,22 +74,12 @@ void BuildRectXY(float size, vertex_type::VertexArray &vertex_array) {
   vs->layout.push_back({TEXCOORD0, type_mapping::FLOAT32, 2});
   vs->type = VST_VERTEX;
   vs->size = 4;
-  vs->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND,
-    GraphicsBuffer::READ_ONLY,
-    GL_ARRAY_BUFFER));
-  vs->buffer_ptr->Bind();
-  vs->buffer_ptr->SetData(vs->Stride() * vs->size, &vertices[0]);
+  Engine::Instance().GeomArena().AllocateStream(*vs, GL_ARRAY_BUFFER, &vertices[0]);
 
   is->layout.push_back({INDEX, type_mapping::UINT32, 1});
   is->type = VST_INDEX;
   is->size = 6;
-  is->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND,
-    GraphicsBuffer::READ_ONLY,
-    GL_ELEMENT_ARRAY_BUFFER));
-  is->buffer_ptr->Bind();
-  is->buffer_ptr->SetData(is->Stride() * is->size, &indices[0]);
+  Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER, &indices[0]);
 
   vertex_array.AddVertexStream(vs);
   vertex_array.SetIndexStream(is);
@@ -234,23 +214,18 @@ void BuildSphere(int sub_div_level, vertex_type::VertexArray &vertex_array) {
   vs->layout.push_back({POSITION, type_mapping::FLOAT32, 3});
   vs->type = VST_VERTEX;
   vs->size = (uint32_t)vertices.size();
-  vs->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC, GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, GL_ARRAY_BUFFER));
-  vs->buffer_ptr->Bind();
-  vs->buffer_ptr->SetData(vs->Stride() * vs->size, glm::value_ptr(vertices[0]));
+  Engine::Instance().GeomArena().AllocateStream(*vs, GL_ARRAY_BUFFER, glm::value_ptr(vertices[0]));
 
   ns->layout.push_back({NORMAL, type_mapping::FLOAT32, 3});
   ns->type = VST_VERTEX;
   ns->size = (uint32_t)vertices.size();
-  ns->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC, GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, GL_ARRAY_BUFFER));
-  ns->buffer_ptr->Bind();
-  ns->buffer_ptr->SetData(ns->Stride() * ns->size, glm::value_ptr(vertices[0]));
+  Engine::Instance().GeomArena().AllocateStream(*ns, GL_ARRAY_BUFFER, glm::value_ptr(vertices[0]));
 
   is->layout.push_back({INDEX, type_mapping::UINT32, 1});
   is->type = VST_INDEX;
   is->size = (uint32_t)triangles.size() * 3;
-  is->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC, GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, GL_ELEMENT_ARRAY_BUFFER));
-  is->buffer_ptr->Bind();
-  is->buffer_ptr->SetData(is->Stride() * is->size, glm::value_ptr(triangles[0]));
+  Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER,
+    glm::value_ptr(triangles[0]));
 
   vertex_array.AddVertexStream(vs);
   vertex_array.AddVertexStream(ns);
@@ -296,22 +271,12 @@ void BuildCube(float size, vertex_type::VertexArray &vertex_array) {
   vs->layout.push_back({NORMAL, type_mapping::FLOAT32, 3});
   vs->type = VST_VERTEX;
   vs->size = 8;
-  vs->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND,
-    GraphicsBuffer::READ_ONLY,
-    GL_ARRAY_BUFFER));
-  vs->buffer_ptr->Bind();
-  vs->buffer_ptr->SetData(vs->Stride() * vs->size, &vertices[0]);
+  Engine::Instance().GeomArena().AllocateStream(*vs, GL_ARRAY_BUFFER, &vertices[0]);
 
   is->layout.push_back({INDEX, type_mapping::UINT32, 1});
   is->type = VST_INDEX;
   is->size = 36;
-  is->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND,
-    GraphicsBuffer::READ_ONLY,
-    GL_ELEMENT_ARRAY_BUFFER));
-  is->buffer_ptr->Bind();
-  is->buffer_ptr->SetData(is->Stride() * is->size, &indices[0]);
+  Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER, &indices[0]);
 
   vertex_array.AddVertexStream(vs);
   vertex_array.SetIndexStream(is);
@@ -343,19 +308,13 @@ void BuildFrustum(float size, float fov, float aspect_ratio,
   vs->layout.push_back({NORMAL, type_mapping::FLOAT32, 3});
   vs->type = VST_VERTEX;
   vs->size = 5;
-  vs->buffer_ptr = std::make_shared<GraphicsBuffer>(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, GL_ARRAY_BUFFER);
-  vs->buffer_ptr->Bind();
-  vs->buffer_ptr->SetData(vs->Stride() * vs->size, verts);
+  Engine::Instance().GeomArena().AllocateStream(*vs, GL_ARRAY_BUFFER, verts);
 
   auto is = std::make_shared<VertexStream>();
   is->layout.push_back({INDEX, type_mapping::UINT32, 1});
   is->type = VST_INDEX;
   is->size = 12;
-  is->buffer_ptr = std::make_shared<GraphicsBuffer>(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, GL_ELEMENT_ARRAY_BUFFER);
-  is->buffer_ptr->Bind();
-  is->buffer_ptr->SetData(is->Stride() * is->size, inds);
+  Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER, inds);
 
   vertex_array.AddVertexStream(vs);
   vertex_array.SetIndexStream(is);
@@ -382,19 +341,13 @@ void BuildFrameAxes(float size, vertex_type::VertexArray &vertex_array) {
   vs->layout.push_back({DIFFUSE_COLOR, type_mapping::FLOAT32, 3});
   vs->type = VST_VERTEX;
   vs->size = 6;
-  vs->buffer_ptr = std::make_shared<GraphicsBuffer>(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, GL_ARRAY_BUFFER);
-  vs->buffer_ptr->Bind();
-  vs->buffer_ptr->SetData(vs->Stride() * vs->size, verts);
+  Engine::Instance().GeomArena().AllocateStream(*vs, GL_ARRAY_BUFFER, verts);
 
   auto is = std::make_shared<VertexStream>();
   is->layout.push_back({INDEX, type_mapping::UINT32, 1});
   is->type = VST_INDEX;
   is->size = 6;
-  is->buffer_ptr = std::make_shared<GraphicsBuffer>(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, GL_ELEMENT_ARRAY_BUFFER);
-  is->buffer_ptr->Bind();
-  is->buffer_ptr->SetData(is->Stride() * is->size, inds);
+  Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER, inds);
 
   vertex_array.PrimitiveType() = GL_LINES;
   vertex_array.AddVertexStream(vs);
@@ -411,22 +364,13 @@ void BuildMesh(const std::vector<glm::vec3> &positions,
   vs->layout.push_back({POSITION, type_mapping::FLOAT32, 3});
   vs->type = VST_VERTEX;
   vs->size = (uint32_t)positions.size();
-  vs->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND,
-    GraphicsBuffer::READ_ONLY,
-    GL_ARRAY_BUFFER));
-  vs->buffer_ptr->Bind();
-  vs->buffer_ptr->SetData(vs->Stride() * vs->size, glm::value_ptr(positions[0]));
+  Engine::Instance().GeomArena().AllocateStream(*vs, GL_ARRAY_BUFFER, glm::value_ptr(positions[0]));
 
   is->layout.push_back({INDEX, type_mapping::UINT32, 1});
   is->type = VST_INDEX;
   is->size = (uint32_t)faces.size() * 3;
-  is->buffer_ptr.reset(new GraphicsBuffer(GraphicsBuffer::STATIC,
-    GraphicsBuffer::SEND,
-    GraphicsBuffer::READ_ONLY,
-    GL_ELEMENT_ARRAY_BUFFER));
-  is->buffer_ptr->Bind();
-  is->buffer_ptr->SetData(is->Stride() * is->size, glm::value_ptr(faces[0]));
+  Engine::Instance().GeomArena().AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER,
+    glm::value_ptr(faces[0]));
 
   vertex_array.AddVertexStream(vs);
   vertex_array.SetIndexStream(is);
@@ -0,0 +1,157 @@
+#include "prefix.h"
+#include <mineola/ProgramBinaryCache.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+#include <mineola/glutility.h>
+#include <mineola/Engine.h>
+#include <mineola/FileSystem.h>
+
+namespace {
+
+const uint32_t kMagic = 0x3142504d;  // "MPB1"
+// GL records at most one flag per error kind
+const int kMaxPendingErrors = 8;
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t format;
+  uint64_t key;
+  uint32_t length;
+  uint32_t padding;
+};
+
+struct DriverInfo {
+  std::string id;  // vendor, renderer and version
+  int32_t num_formats;
+};
+
+// queried once, the GL context is not expected to change drivers
+const DriverInfo &Driver() {
+  static const DriverInfo info = [] {
+    DriverInfo result;
+    for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+      auto str = (const char *)glGetString(name);
+      result.id += str ? str : "";
+      result.id += '\n';
+    }
+    result.num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &result.num_formats);
+    return result;
+  }();
+  return info;
+}
+
+// FNV-1a
+uint64_t HashBytes(uint64_t hash, const std::string &str) {
+  for (unsigned char c : str) {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  // separator, so that moving text between the strings changes the hash
+  hash ^= 0xff;
+  hash *= 0x100000001b3ull;
+  return hash;
+}
+
+std::string CachePath(uint64_t key) {
+  char fn[32];
+  snprintf(fn, sizeof(fn), "%016llx.bin", (unsigned long long)key);
+  return mineola::file_system::JoinPaths(mineola::Engine::Instance().ProgramCacheDir(), fn);
+}
+
+}
+
+namespace mineola { namespace program_binary_cache {
+
+bool Enabled() {
+  return !Engine::Instance().ProgramCacheDir().empty() && Driver().num_formats > 0;
+}
+
+uint64_t Key(const std::string &vs_src, const std::string &ps_src) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  hash = HashBytes(hash, vs_src);
+  hash = HashBytes(hash, ps_src);
+  hash = HashBytes(hash, Driver().id);
+  return hash;
+}
+
+bool Load(uint64_t key, uint32_t program) {
+  const std::string path = CachePath(key);
+  std::ifstream infile(path, std::ios::binary);
+  if (!infile.good()) {
+    return false;
+  }
+
+  FileHeader header;
+  std::vector<char> binary;
+  if (infile.read((char *)&header, sizeof(header))
+    && header.magic == kMagic && header.key == key && header.length > 0) {
+    binary.resize(header.length);
+    infile.read(binary.data(), binary.size());
+  }
+  if (binary.empty() || !infile) {
+    MLOG("Corrupted program binary %s\n", path.c_str());
+    infile.close();
+    std::remove(path.c_str());
+    return false;
+  }
+  infile.close();
+
+  // errors left by earlier calls must not read as a rejected binary. Bounded, as a lost
+  // context keeps reporting an error.
+  for (int i = 0; i < kMaxPendingErrors && glGetError() != GL_NO_ERROR; ++i) {}
+  glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+  // an unknown format fails with GL_INVALID_ENUM
+  const bool unsupported = glGetError() == GL_INVALID_ENUM;
+  GLint linked = GL_FALSE;
+  if (!unsupported) {
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  }
+  if (linked != GL_TRUE) {
+    // stale, the source path relinks and stores a fresh one
+    std::remove(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Store(uint64_t key, uint32_t program) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return false;
+  }
+
+  FileHeader header = {kMagic, 0, key, (uint32_t)length, 0};
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+  if (length <= 0) {
+    return false;
+  }
+  header.format = format;
+  header.length = (uint32_t)length;
+
+  // write aside and rename, so concurrent processes sharing the directory never read a
+  // partially written file
+  const std::string path = CachePath(key);
+  const std::string tmp_path = path + ".tmp" +
+    std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+  std::ofstream outfile(tmp_path, std::ios::binary);
+  if (!outfile.good()) {
+    MLOG("Failed to write program binary %s\n", tmp_path.c_str());
+    return false;
+  }
+  outfile.write((const char *)&header, sizeof(header));
+  outfile.write(binary.data(), length);
+  outfile.close();
+  if (!outfile || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}} //end namespace
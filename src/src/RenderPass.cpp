@@ -7,6 +7,8 @@ RenderPass CreateShadowmapPass() {
   RenderPass result;
   result.sfx = RenderPass::SFX_PASS_SHADOWMAP;
   result.override_render_target = "mineola:rt:shadowmap";
+  // shadow casters are rendered from the light, not the active camera
+  result.frustum_cull = false;
   return result;
 }
 
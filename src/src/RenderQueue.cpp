@@ -0,0 +1,245 @@
+#include "prefix.h"
+#include <mineola/RenderQueue.h>
+#include <unordered_map>
+#include <string>
+#include <glm/gtc/matrix_transform.hpp>
+#include <mineola/SceneNode.h>
+#include <mineola/Renderable.h>
+#include <mineola/Camera.h>
+#include <mineola/OcclusionCuller.h>
+
+namespace {
+
+using KeyIndex = std::pair<uint64_t, uint32_t>;
+
+// LSD radix sort on 8-bit digits, stable. Digits shared by all keys are skipped.
+void RadixSort(std::vector<KeyIndex> &values, std::vector<KeyIndex> &scratch) {
+  const size_t n = values.size();
+  if (n < 2) {
+    return;
+  }
+  scratch.resize(n);
+
+  uint32_t histograms[8][256] = {};
+  for (const auto &v : values) {
+    for (uint32_t digit = 0; digit < 8; ++digit) {
+      ++histograms[digit][(v.first >> (digit * 8)) & 0xff];
+    }
+  }
+
+  for (uint32_t digit = 0; digit < 8; ++digit) {
+    auto &hist = histograms[digit];
+    if (hist[(values[0].first >> (digit * 8)) & 0xff] == n) {
+      continue;  // all keys share this digit
+    }
+
+    uint32_t offset = 0;
+    for (auto &count : hist) {
+      uint32_t c = count;
+      count = offset;
+      offset += c;
+    }
+    for (const auto &v : values) {
+      scratch[hist[(v.first >> (digit * 8)) & 0xff]++] = v;
+    }
+    values.swap(scratch);
+  }
+}
+
+template <typename T>
+uint16_t InternId(std::unordered_map<T, uint16_t> &ids, const T &key, uint32_t bits) {
+  auto iter = ids.find(key);
+  if (iter != ids.end()) {
+    return iter->second;
+  }
+  // ids beyond the key range share the last slot, only sorting quality degrades
+  uint16_t id = (uint16_t)std::min<size_t>(ids.size(), (1u << bits) - 1);
+  ids[key] = id;
+  return id;
+}
+
+}
+
+namespace mineola {
+
+RenderQueue::RenderQueue() : valid_(false) {
+}
+
+RenderQueue::~RenderQueue() {
+}
+
+void RenderQueue::Invalidate() {
+  valid_ = false;
+}
+
+bool RenderQueue::IsValid() const {
+  return valid_;
+}
+
+void RenderQueue::Clear() {
+  items_.clear();
+  static_keys_.clear();
+  order_.clear();
+  scratch_.clear();
+  bvh_.Clear();
+  in_bvh_.clear();
+  valid_ = false;
+}
+
+void RenderQueue::Rebuild(const SceneNode &root) {
+  items_.clear();
+  static_keys_.clear();
+  bvh_.Clear();
+
+  std::unordered_map<std::string, uint16_t> effect_ids, material_ids;
+  std::unordered_map<const void *, uint16_t> va_ids;
+
+  root.DFTraverse([&](const SceneNode &node) {
+    for (auto &renderable : node.Renderables()) {
+      Item item;
+      item.node = &node;
+      item.renderable = renderable.get();
+      items_.push_back(item);
+
+      StaticKey key;
+      key.queue = (uint16_t)((int32_t)renderable->QueueId() + 0x8000);
+      key.transparent = renderable->QueueId() >= Renderable::kQueueTransparent;
+      key.effect = InternId(effect_ids, std::string(renderable->GetEffectName()), kEffectBits);
+      if (renderable->NumVertexArray() > 0) {
+        key.material = InternId(material_ids, renderable->GetMaterialName(0), kMaterialBits);
+        key.vertex_array = InternId(va_ids,
+          (const void *)renderable->GetVertexArray(0).get(), kVertexArrayBits);
+      } else {
+        key.material = 0;
+        key.vertex_array = 0;
+      }
+      static_keys_.push_back(key);
+    }
+  });
+
+  order_.resize(items_.size());
+  for (uint32_t idx = 0; idx < (uint32_t)items_.size(); ++idx) {
+    order_[idx] = {0, idx};
+  }
+  in_bvh_.assign(items_.size(), 0);
+  valid_ = true;
+}
+
+void RenderQueue::Update(const Camera *camera) {
+  const uint32_t depth_max = (1u << kDepthBits) - 1;
+  float near_plane = camera ? camera->NearPlane() : 0.f;
+  float far_plane = camera ? camera->FarPlane() : 1.f;
+  float depth_scale = far_plane > near_plane ? 1.f / (far_plane - near_plane) : 0.f;
+  bool rebuild_bvh = bvh_.Empty();
+
+  for (size_t idx = 0; idx < items_.size(); ++idx) {
+    auto &item = items_[idx];
+    const auto &key = static_keys_[idx];
+
+    item.model_mat = glm::scale(item.node->WorldRbt().ToMatrix(), item.node->WorldScale());
+    const auto &bbox = item.renderable->Bbox();
+    // skinned vertices may leave the bind pose bounds, never cull them
+    if (bbox && !item.renderable->IsSkinned()) {
+      item.world_bbox = bbox;
+      item.world_bbox->Transform(item.model_mat);
+    } else {
+      item.world_bbox.reset();
+    }
+    rebuild_bvh |= item.world_bbox.has_value() != (bool)in_bvh_[idx];
+
+    uint64_t depth = 0;
+    if (camera) {
+      glm::vec3 center = item.world_bbox ?
+        item.world_bbox->Center() : glm::vec3(item.model_mat[3]);
+      float view_depth = -(camera->GetViewMatrix() * glm::vec4(center, 1.f)).z;
+      float t = glm::clamp((view_depth - near_plane) * depth_scale, 0.f, 1.f);
+      depth = (uint64_t)(t * depth_max);
+    }
+
+    uint64_t sort_key = (uint64_t)key.queue << (64 - kQueueBits);
+    if (key.transparent) {
+      sort_key |= (depth_max - depth) << (64 - kQueueBits - kDepthBits);
+      sort_key |= (uint64_t)key.effect << (kMaterialBits + kVertexArrayBits);
+      sort_key |= (uint64_t)key.material << kVertexArrayBits;
+      sort_key |= (uint64_t)key.vertex_array;
+    } else {
+      sort_key |= (uint64_t)key.effect << (64 - kQueueBits - kEffectBits);
+      sort_key |= (uint64_t)key.material << (kVertexArrayBits + kDepthBits);
+      sort_key |= (uint64_t)key.vertex_array << kDepthBits;
+      sort_key |= depth;
+    }
+    item.sort_key = sort_key;
+  }
+
+  // tree is built once per rebuild, then only refit to the moving bounds
+  if (rebuild_bvh) {
+    std::vector<std::optional<AABB>> item_bounds(items_.size());
+    for (size_t idx = 0; idx < items_.size(); ++idx) {
+      item_bounds[idx] = items_[idx].world_bbox;
+      in_bvh_[idx] = item_bounds[idx].has_value();
+    }
+    bvh_.Build(item_bounds);
+  } else {
+    for (uint32_t idx = 0; idx < (uint32_t)items_.size(); ++idx) {
+      if (items_[idx].world_bbox) {
+        bvh_.UpdateItem(idx, *items_[idx].world_bbox);
+      }
+    }
+    bvh_.Refit();
+  }
+
+  // keys are refreshed in place, previous order is a good starting point for stability
+  for (auto &entry : order_) {
+    entry.first = items_[entry.second].sort_key;
+  }
+  RadixSort(order_, scratch_);
+}
+
+void RenderQueue::Cull(const Frustum *frustum) {
+  if (!frustum) {
+    for (auto &item : items_) {
+      item.visible = true;
+    }
+    return;
+  }
+
+  // items without bounds are always drawn
+  for (auto &item : items_) {
+    item.visible = !item.world_bbox;
+  }
+  bvh_.QueryFrustum(*frustum, [this](uint32_t idx) {
+    items_[idx].visible = true;
+  });
+}
+
+void RenderQueue::CullOccluded(OcclusionCuller &culler, const glm::mat4 &proj_view) {
+  culler.Clear();
+  bool has_occluder = false;
+  for (const auto &item : items_) {
+    const auto &mesh = item.renderable->OccluderMesh();
+    if (item.visible && mesh) {
+      culler.RasterizeOccluder(*mesh, proj_view * item.model_mat);
+      has_occluder = true;
+    }
+  }
+  if (!has_occluder) {
+    return;
+  }
+  culler.BuildHiZ();
+
+  for (auto &item : items_) {
+    if (item.visible && item.world_bbox && !culler.IsVisible(*item.world_bbox, proj_view)) {
+      item.visible = false;
+    }
+  }
+}
+
+size_t RenderQueue::Size() const {
+  return order_.size();
+}
+
+const RenderQueue::Item &RenderQueue::operator[](size_t idx) const {
+  return items_[order_[idx].second];
+}
+
+} // namespace
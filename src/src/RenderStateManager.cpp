@@ -1,4 +1,5 @@
 #include <mineola/RenderStateManager.h>
+#include <iterator>
 #include <mineola/glutility.h>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -179,6 +180,104 @@ void RenderStateManager::SetBlendEnabled(bool enabled, bool force) {
   }
 }
 
+/******************** Bindings ********************/
+void RenderStateManager::UseProgram(uint32_t program) {
+  if (bindings_.program != program) {
+    glUseProgram(program);
+    bindings_.program = program;
+  }
+}
+
+void RenderStateManager::ActiveTexture(uint32_t unit) {
+  if (bindings_.active_texture_unit != unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    bindings_.active_texture_unit = unit;
+  }
+}
+
+void RenderStateManager::BindTexture(uint32_t target, uint32_t texture) {
+  if (bindings_.active_texture_unit == kUnknownBinding) {
+    glBindTexture(target, texture);
+    return;
+  }
+  uint64_t key = ((uint64_t)bindings_.active_texture_unit << 32) | target;
+  auto iter = bindings_.textures.find(key);
+  if (iter == bindings_.textures.end() || iter->second != texture) {
+    glBindTexture(target, texture);
+    bindings_.textures[key] = texture;
+  }
+}
+
+void RenderStateManager::BindVertexArray(uint32_t vao) {
+  if (bindings_.vertex_array != vao) {
+    glBindVertexArray(vao);
+    bindings_.vertex_array = vao;
+    bindings_.buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+  }
+}
+
+void RenderStateManager::BindBuffer(uint32_t target, uint32_t buffer) {
+  auto iter = bindings_.buffers.find(target);
+  if (iter == bindings_.buffers.end() || iter->second != buffer) {
+    glBindBuffer(target, buffer);
+    bindings_.buffers[target] = buffer;
+  }
+}
+
+void RenderStateManager::BindBufferBase(uint32_t target, uint32_t index, uint32_t buffer) {
+  BindBufferRange(target, index, buffer, 0, 0);
+}
+
+void RenderStateManager::BindBufferRange(uint32_t target, uint32_t index, uint32_t buffer,
+  uint32_t offset, uint32_t size) {
+  uint64_t key = ((uint64_t)target << 32) | index;
+  auto iter = bindings_.indexed_buffers.find(key);
+  if (iter != bindings_.indexed_buffers.end() && iter->second.buffer == buffer &&
+    iter->second.offset == offset && iter->second.size == size) {
+    return;
+  }
+  if (size == 0) {
+    glBindBufferBase(target, index, buffer);
+  } else {
+    glBindBufferRange(target, index, buffer, offset, size);
+  }
+  bindings_.indexed_buffers[key] = {buffer, offset, size};
+  // also binds the generic binding point
+  bindings_.buffers[target] = buffer;
+}
+
+void RenderStateManager::OnProgramDeleted(uint32_t program) {
+  if (bindings_.program == program) {
+    bindings_.program = kUnknownBinding;
+  }
+}
+
+void RenderStateManager::OnTextureDeleted(uint32_t texture) {
+  for (auto iter = bindings_.textures.begin(); iter != bindings_.textures.end();) {
+    iter = iter->second == texture ? bindings_.textures.erase(iter) : std::next(iter);
+  }
+}
+
+void RenderStateManager::OnVertexArrayDeleted(uint32_t vao) {
+  if (bindings_.vertex_array == vao) {
+    bindings_.vertex_array = kUnknownBinding;
+    bindings_.buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+  }
+}
+
+void RenderStateManager::OnBufferDeleted(uint32_t buffer) {
+  for (auto iter = bindings_.buffers.begin(); iter != bindings_.buffers.end();) {
+    iter = iter->second == buffer ? bindings_.buffers.erase(iter) : std::next(iter);
+  }
+  for (auto iter = bindings_.indexed_buffers.begin(); iter != bindings_.indexed_buffers.end();) {
+    iter = iter->second.buffer == buffer ? bindings_.indexed_buffers.erase(iter) : std::next(iter);
+  }
+}
+
+void RenderStateManager::InvalidateBindings() {
+  bindings_ = {};
+}
+
 void RenderStateManager::ApplyCurrentState() {
   ApplyStateCache(current_state_, true);
 }
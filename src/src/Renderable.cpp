@@ -1,8 +1,14 @@
 #include "prefix.h"
+#include <atomic>
 #include <mineola/Renderable.h>
 #include <mineola/Engine.h>
 #include <mineola/Material.h>
 #include <mineola/VertexType.h>
+#include <mineola/GLEffect.h>
+
+namespace {
+std::atomic<uint32_t> bbox_generation{0};
+}
 
 namespace mineola {
 
@@ -34,18 +40,29 @@ int16_t Renderable::QueueId() const {
 
 void Renderable::SetQueueId(int16_t queue_id) {
   q_id_ = queue_id;
+  Engine::Instance().InvalidateRenderQueue();
 }
 
 void Renderable::SetSkin(std::shared_ptr<Skin> skin) {
   skin_ = std::move(skin);
 }
 
+bool Renderable::IsSkinned() const {
+  return (bool)skin_;
+}
+
+const std::shared_ptr<Skin> &Renderable::GetSkin() const {
+  return skin_;
+}
+
 void Renderable::AddVertexArray(
   std::shared_ptr<vertex_type::VertexArray> va,
   const char *material_name) {
 
   vertex_arrays_.push_back(std::move(va));
   material_names_.push_back(material_name);
+  InvalidateDrawPackets();
+  Engine::Instance().InvalidateRenderQueue();
 }
 
 size_t Renderable::NumVertexArray() const {
@@ -58,10 +75,13 @@ std::shared_ptr<vertex_type::VertexArray> Renderable::GetVertexArray(int idx) {
 
 void Renderable::SetEffect(std::string effect_name) {
   effect_name_ = std::move(effect_name);
+  InvalidateDrawPackets();
+  Engine::Instance().InvalidateRenderQueue();
 }
 
 void Renderable::SetShadowmapEffect(std::string effect_name) {
   shadowmap_effect_name_ = std::move(effect_name);
+  InvalidateDrawPackets();
 }
 
 std::optional<const char *> Renderable::GetShadowmapEffectName() const {
@@ -74,6 +94,8 @@ std::optional<const char *> Renderable::GetShadowmapEffectName() const {
 
 void Renderable::SetMaterial(size_t index, const char *material_name) {
   material_names_[index] = material_name;
+  InvalidateDrawPackets();
+  Engine::Instance().InvalidateRenderQueue();
 }
 
 const std::string &Renderable::GetMaterialName(size_t index) const {
@@ -82,23 +104,79 @@ const std::string &Renderable::GetMaterialName(size_t index) const {
 
 void Renderable::SetBbox(const AABB &bbox) {
   bbox_ = std::optional<AABB>{bbox};
+  bbox_generation.fetch_add(1, std::memory_order_release);
 }
 
 const std::optional<AABB> &Renderable::Bbox() const {
   return bbox_;
 }
 
-void Renderable::PreRender(double frame_time, uint32_t pass_idx) {
-  auto &en = Engine::Instance();
-  auto &pass = en.RenderPasses()[pass_idx];
-  switch (pass.sfx) {
-  case RenderPass::SFX_PASS_SHADOWMAP:
-    en.ChangeEffect(*shadowmap_effect_name_, false);
-    break;
-  default:
-    en.ChangeEffect(effect_name_, false);
-    break;
+uint32_t Renderable::BboxGeneration() {
+  return bbox_generation.load(std::memory_order_acquire);
+}
+
+void Renderable::SetOccluderMesh(std::shared_ptr<TriangleMesh> mesh) {
+  occluder_mesh_ = std::move(mesh);
+}
+
+const std::shared_ptr<TriangleMesh> &Renderable::OccluderMesh() const {
+  return occluder_mesh_;
+}
+
+void Renderable::InvalidateDrawPackets() {
+  packets_generation_.reset();
+}
+
+void Renderable::CompileDrawPackets() {
+  auto &resrc_mgr = Engine::Instance().ResrcMgr();
+  // effects missing, failed or still linking (see Engine::AddPendingEffect()) fall back
+  auto find_effect = [&resrc_mgr](const std::string &name, const char *fallback) {
+    auto effect = bd_cast<GLEffect>(resrc_mgr.Find(name));
+    if (!effect) {
+      effect = bd_cast<GLEffect>(resrc_mgr.Find(fallback));
+    }
+    return effect ? effect : bd_cast<GLEffect>(resrc_mgr.Find("mineola:effect:fallback"));
+  };
+  effect_ = find_effect(effect_name_, "mineola:effect:fallback");
+  shadowmap_effect_ = shadowmap_effect_name_ ?
+    find_effect(*shadowmap_effect_name_, "mineola:effect:shadowmap_fallback") : nullptr;
+
+  auto fallback_material = bd_cast<Material>(resrc_mgr.Find("mineola:material:fallback"));
+  materials_.clear();
+  packets_.clear();
+  for (size_t i = 0; i < vertex_arrays_.size(); ++i) {
+    auto material = bd_cast<Material>(resrc_mgr.Find(material_names_[i]));
+    if (!material) {
+      material = fallback_material;
+    }
+    packets_.push_back({vertex_arrays_[i].get(), material.get()});
+    materials_.push_back(std::move(material));
   }
+  packets_generation_ = resrc_mgr.Generation();
+}
+
+void Renderable::UpdateDrawPackets() {
+  if (packets_generation_ != Engine::Instance().ResrcMgr().Generation()) {
+    CompileDrawPackets();
+  }
+}
+
+const std::shared_ptr<GLEffect> &Renderable::PassEffect(uint32_t pass_idx) const {
+  auto &pass = Engine::Instance().RenderPasses()[pass_idx];
+  return pass.sfx == RenderPass::SFX_PASS_SHADOWMAP ? shadowmap_effect_ : effect_;
+}
+
+const std::vector<Renderable::DrawPacket> &Renderable::DrawPackets() const {
+  return packets_;
+}
+
+void Renderable::PrepareFrame(double frame_time) {
+  // skin palettes are computed by the engine, once per skin
+}
+
+void Renderable::PreRender(double frame_time, uint32_t pass_idx) {
+  UpdateDrawPackets();
+  Engine::Instance().ChangeEffect(PassEffect(pass_idx), false);
 
   if (skin_) {
     skin_->PreRender(frame_time, pass_idx);
@@ -107,8 +185,42 @@ void Renderable::PreRender(double frame_time, uint32_t pass_idx) {
 
 void Renderable::Draw(double frame_time, uint32_t pass) {
   Engine &en = Engine::Instance();
-  for (uint32_t i = 0; i < vertex_arrays_.size(); ++i) {
-    en.DoRender(*vertex_arrays_[i], material_names_[i]);
+  for (const auto &packet : packets_) {
+    en.DoRender(*packet.vertex_array, *packet.material);
+  }
+}
+
+bool Renderable::SupportsInstancing() const {
+  return !skin_;
+}
+
+bool Renderable::CanInstanceWith(Renderable &other, uint32_t pass_idx) {
+  if (!SupportsInstancing() || !other.SupportsInstancing()) {
+    return false;
+  }
+  UpdateDrawPackets();
+  other.UpdateDrawPackets();
+
+  if (PassEffect(pass_idx) != other.PassEffect(pass_idx)) {
+    return false;
+  }
+
+  if (packets_.size() != other.packets_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < packets_.size(); ++i) {
+    if (packets_[i].vertex_array != other.packets_[i].vertex_array
+      || packets_[i].material != other.packets_[i].material) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Renderable::DrawInstanced(double frame_time, uint32_t pass, uint32_t num_instances) {
+  Engine &en = Engine::Instance();
+  for (const auto &packet : packets_) {
+    en.DoRenderInstanced(*packet.vertex_array, *packet.material, num_instances);
   }
 }
 
@@ -0,0 +1,117 @@
+#include "prefix.h"
+#include <mineola/RingBuffer.h>
+#include <algorithm>
+#include <mineola/glutility.h>
+#include <mineola/GraphicsBuffer.h>
+
+namespace {
+
+const uint64_t kFenceTimeout = 100000000;  // 100ms, in ns
+
+}
+
+namespace mineola {
+
+RingBuffer::RingBuffer(uint32_t target, uint32_t index, uint32_t num_frames) :
+  buffer_(std::make_unique<GraphicsBuffer>(GraphicsBuffer::STREAM,
+    GraphicsBuffer::SEND, GraphicsBuffer::WRITE_ONLY, target, index)),
+  alignment_(16),
+  segment_size_(0),
+  frame_(0),
+  head_(0),
+  mapped_(nullptr),
+  fences_(std::max<uint32_t>(num_frames, 1), nullptr) {
+
+  if (target == GL_UNIFORM_BUFFER) {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment_ = std::max<uint32_t>((uint32_t)alignment, alignment_);
+  }
+}
+
+RingBuffer::~RingBuffer() {
+  EndWrite();
+  for (auto fence : fences_) {
+    if (fence) {
+      glDeleteSync((GLsync)fence);
+    }
+  }
+}
+
+uint32_t RingBuffer::Align(uint32_t size) const {
+  return (size + alignment_ - 1) / alignment_ * alignment_;
+}
+
+bool RingBuffer::BeginFrame(uint32_t size) {
+  EndWrite();
+  frame_ = (frame_ + 1) % (uint32_t)fences_.size();
+  head_ = 0;
+
+  size = Align(size);
+  if (size > segment_size_) {
+    // new storage, frames in flight keep reading the orphaned one
+    segment_size_ = std::max(size, Align(segment_size_ + segment_size_ / 2));
+    buffer_->SetSize(segment_size_ * (uint32_t)fences_.size());
+    for (auto &fence : fences_) {
+      if (fence) {
+        glDeleteSync((GLsync)fence);
+        fence = nullptr;
+      }
+    }
+  } else if (fences_[frame_]) {
+    GLsync fence = (GLsync)fences_[frame_];
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeout);
+    while (result == GL_TIMEOUT_EXPIRED) {
+      result = glClientWaitSync(fence, 0, kFenceTimeout);
+    }
+    glDeleteSync(fence);
+    fences_[frame_] = nullptr;
+  }
+
+  if (segment_size_ == 0) {
+    return false;
+  }
+  // already synchronized by the fence
+  mapped_ = (uint8_t *)buffer_->MapRange(frame_ * segment_size_, segment_size_,
+    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+  return mapped_ != nullptr;
+}
+
+std::optional<uint32_t> RingBuffer::Allocate(uint32_t size) {
+  if (!mapped_ || head_ + size > segment_size_) {
+    return std::nullopt;
+  }
+  uint32_t offset = frame_ * segment_size_ + head_;
+  head_ = std::min(Align(head_ + size), segment_size_);
+  return offset;
+}
+
+void *RingBuffer::Pointer(uint32_t offset) const {
+  return mapped_ + (offset - frame_ * segment_size_);
+}
+
+void RingBuffer::EndWrite() {
+  if (mapped_) {
+    buffer_->Bind();
+    buffer_->Unmap();
+    mapped_ = nullptr;
+  }
+}
+
+void RingBuffer::EndFrame() {
+  EndWrite();
+  if (fences_[frame_]) {
+    glDeleteSync((GLsync)fences_[frame_]);
+  }
+  fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+uint32_t RingBuffer::Alignment() const {
+  return alignment_;
+}
+
+GraphicsBuffer &RingBuffer::Buffer() {
+  return *buffer_;
+}
+
+} // namespace
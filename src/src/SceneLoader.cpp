@@ -25,6 +25,7 @@
 #include <mineola/FileSystem.h>
 #include <mineola/EnvLight.h>
 #include <mineola/PrefabHelper.h>
+#include <mineola/StaticBatching.h>
 
 namespace {
 template <typename Op, typename ...Args>
@@ -352,7 +353,7 @@ bool BuildSceneFromConfig(const char *config_str,
         }
         renderable->SetLayerMask(layer);
         renderable->SetQueueId(queue);
-        node->Renderables().push_back(renderable);
+        node->AddRenderable(renderable);
       } else {
         std::string filename = geo["filename"].get<std::string>();
         std::string found_fn;
@@ -362,9 +363,18 @@ bool BuildSceneFromConfig(const char *config_str,
           std::tie(input_path, input_fn) = file_system::SplitPath(found_fn);
           en.ResrcMgr().AddSearchPath(input_path.c_str());
 
-          if (!RunSequential(geometry_loaders, found_fn.c_str(), node,
+          // static geometries are loaded under their own node and merged into batches
+          bool is_static = geo.find("static") != geo.end() && geo["static"].get<bool>();
+          auto parent = node;
+          if (is_static) {
+            parent = std::make_shared<SceneNode>(("static:" + filename).c_str());
+            SceneNode::LinkTo(parent, node);
+          }
+          if (!RunSequential(geometry_loaders, found_fn.c_str(), parent,
             effect, shadowmap_effect, layer)) {
             MLOG("Geometry %s not loaded!\n", filename.c_str());
+          } else if (is_static) {
+            static_batching::BuildStaticBatches(parent);
           }
           en.ResrcMgr().PopSearchPath(input_path.c_str());
         } else {
@@ -629,51 +639,51 @@ bool BuildSceneFromConfig(const char *config_str,
 
           if (uniform_type == "float") {
             float value = uniform["value"].get<float>();
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(value);
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(value));
           } else if (uniform_type == "int") {
             int32_t value = uniform["value"].get<int32_t>();
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(value);
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(value));
           } else if (uniform_type == "uint") {
             uint32_t value = uniform["value"].get<uint32_t>();
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(value);
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(value));
           } else if (uniform_type == "float[]") {
             std::vector<float> value;
             for (const auto &v : uniform["value"]) {
               value.push_back(v.get<float>());
             }
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(std::move(value));
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(std::move(value)));
           } else if (uniform_type == "vec2") {
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(JArray2Vec<glm::vec2>(uniform["value"]));
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(JArray2Vec<glm::vec2>(uniform["value"])));
           } else if (uniform_type == "vec2[]") {
             std::vector<glm::vec2> value;
             for (const auto &v : uniform["value"]) {
               value.push_back(JArray2Vec<glm::vec4>(v));
             }
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(std::move(value));
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(std::move(value)));
           } else if (uniform_type == "vec3") {
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(
-              JArray2Vec<glm::vec3>(uniform["value"]));
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(
+              JArray2Vec<glm::vec3>(uniform["value"])));
           } else if (uniform_type == "vec3[]") {
             std::vector<glm::vec3> value;
             for (const auto &v : uniform["value"]) {
               value.push_back(JArray2Vec<glm::vec4>(v));
             }
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(std::move(value));
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(std::move(value)));
           } else if (uniform_type == "vec4") {
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(
-              JArray2Vec<glm::vec4>(uniform["value"]));
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(
+              JArray2Vec<glm::vec4>(uniform["value"])));
           } else if (uniform_type == "vec4[]") {
             std::vector<glm::vec4> value;
             for (const auto &v : uniform["value"]) {
               value.push_back(JArray2Vec<glm::vec4>(v));
             }
-            material->uniform_slots[uniform_name] = uniform_helper::Wrap(std::move(value));
+            material->SetUniformSlot(uniform_name, uniform_helper::Wrap(std::move(value)));
           } else if (uniform_type == "texture") {
             std::vector<std::string> texture_names;
             for (const auto &v : uniform["texture_names"]) {
               texture_names.push_back(v.get<std::string>());
             }
-            material->texture_slots[uniform_name] = std::move(texture_names);
+            material->SetTextureSlot(uniform_name, std::move(texture_names));
           } else {
             MLOG("Unknown uniform type %s!\n", uniform_type.c_str());
           }
@@ -761,6 +771,14 @@ bool BuildSceneFromConfig(const char *config_str,
         }
       }
 
+      render_pass.frustum_cull = render_pass.sfx != RenderPass::SFX_PASS_SHADOWMAP;
+      if (pass.find("frustum_cull") != pass.end()) {
+        render_pass.frustum_cull = pass["frustum_cull"].get<bool>();
+      }
+      if (pass.find("occlusion_cull") != pass.end()) {
+        render_pass.occlusion_cull = pass["occlusion_cull"].get<bool>();
+      }
+
       render_pass.clear_flag = RenderPass::CLEAR_ALL;
       if (pass.find("clear") != pass.end()) {
         render_pass.clear_flag = RenderPass::CLEAR_NONE;
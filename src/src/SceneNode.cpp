@@ -1,22 +1,68 @@
 #include "prefix.h"
 #include <vector>
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 #include <mineola/Light.h>
 #include <mineola/Camera.h>
 #include <mineola/SceneNode.h>
 #include <mineola/Renderable.h>
+#include <mineola/Engine.h>
+#include <mineola/TransformStore.h>
+#include <mineola/NameRegistry.h>
+
+namespace {
+  using namespace mineola;
+
+  bool InSubtree(const SceneNode &subtree_root, const SceneNode &node) {
+    const SceneNode *current = &node;
+    while (current != &subtree_root) {
+      auto parent = current->Parent().lock();
+      if (!parent) {
+        return false;
+      }
+      current = parent.get();
+    }
+    return true;
+  }
+
+  // child indices from subtree_root down to node, empty if node is not in the subtree.
+  // Paths compare lexicographically in pre-order, ancestors before their descendants.
+  bool PathFrom(const SceneNode &subtree_root, const SceneNode &node,
+    std::vector<uint32_t> &path) {
+    path.clear();
+    const SceneNode *current = &node;
+    while (current != &subtree_root) {
+      auto parent = current->Parent().lock();
+      if (!parent) {
+        return false;
+      }
+      path.push_back(current->ChildIndex());
+      current = parent.get();
+    }
+    std::reverse(path.begin(), path.end());
+    return true;
+  }
+}
 
 namespace mineola {
   SceneNode::SceneNode() :
-    scale_(1, 1, 1), world_scale_(1, 1, 1) {
+    child_index_(0), aabb_valid_(false), aabb_bbox_generation_(0), name_id_(NameRegistry::kEmptyName) {
+    // construct the registry before any node, so that it outlives them
+    NameRegistry::Instance();
+    tform_index_ = TransformStore::Instance().Allocate(this);
   }
 
   SceneNode::SceneNode(const char *name) :
-    scale_(1, 1, 1), world_scale_(1, 1, 1),
-    name_(name) {
+    child_index_(0), aabb_valid_(false), aabb_bbox_generation_(0), name_id_(NameRegistry::kEmptyName) {
+    tform_index_ = TransformStore::Instance().Allocate(this);
+    SetName(name);
   }
 
   SceneNode::~SceneNode() {
+    TransformStore::Instance().Free(tform_index_);
+    if (name_id_ != NameRegistry::kEmptyName) {
+      NameRegistry::Instance().RemoveNode(name_id_, this);
+    }
   }
 
   const std::weak_ptr<SceneNode>& SceneNode::Parent() const {
@@ -27,12 +73,13 @@ namespace mineola {
     return children_;
   }
 
+  uint32_t SceneNode::ChildIndex() const {
+    return child_index_;
+  }
+
   void SceneNode::RemoveChild(const SceneNode &node) {
-    for (size_t i = 0; i < children_.size(); ++i) {
-      if (children_[i].get() == &node) {
-        RemoveChild(i);
-        return;
-      }
+    if (node.child_index_ < children_.size() && children_[node.child_index_].get() == &node) {
+      RemoveChild(node.child_index_);
     }
   }
 
@@ -40,13 +87,23 @@ namespace mineola {
     if (index >= children_.size())
       return;
     children_[index]->parent_.reset();
+    TransformStore::Instance().SetParent(children_[index]->tform_index_, -1);
     children_.erase(children_.begin() + index);
+    for (size_t i = index; i < children_.size(); ++i) {
+      children_[i]->child_index_ = (uint32_t)i;
+    }
+    InvalidateAABB();
+    Engine::Instance().InvalidateRenderQueue();
   }
 
   void SceneNode::RemoveChildren() {
-    for (size_t i = 0; i < children_.size(); ++i)
+    for (size_t i = 0; i < children_.size(); ++i) {
       children_[i]->parent_.reset();
+      TransformStore::Instance().SetParent(children_[i]->tform_index_, -1);
+    }
     children_.clear();
+    InvalidateAABB();
+    Engine::Instance().InvalidateRenderQueue();
   }
 
   void SceneNode::LinkTo(std::shared_ptr<SceneNode> child,
@@ -57,75 +114,120 @@ namespace mineola {
     if (old_parent)
       old_parent->RemoveChild(*child);
     child->parent_ = parent;
-    if (parent)
+    TransformStore::Instance().SetParent(child->tform_index_,
+      parent ? (int32_t)parent->tform_index_ : -1);
+    if (parent) {
+      child->child_index_ = (uint32_t)parent->children_.size();
       parent->children_.push_back(std::move(child));
+      parent->InvalidateAABB();
+    }
+    Engine::Instance().InvalidateRenderQueue();
   }
 
-  const glm::vec3& SceneNode::Position() const {
-    return rbt_.Translation();
+  glm::vec3 SceneNode::Position() const {
+    return TransformStore::Instance().LocalRbt(tform_index_).Translation();
   }
 
   void SceneNode::SetPosition(const glm::vec3 &position) {
-    rbt_.Translation() = position;
+    TransformStore::Instance().LocalRbt(tform_index_).Translation() = position;
+    MarkTformDirty();
   }
 
-  const glm::quat& SceneNode::Rotation() const {
-    return rbt_.Rotation();
+  glm::quat SceneNode::Rotation() const {
+    return TransformStore::Instance().LocalRbt(tform_index_).Rotation();
   }
 
   void SceneNode::SetRotation(const glm::quat &rotation) {
-    rbt_.Rotation() = rotation;
+    TransformStore::Instance().LocalRbt(tform_index_).Rotation() = rotation;
+    MarkTformDirty();
   }
 
-  const glm::vec3& SceneNode::Scale() const {
-    return scale_;
+  glm::vec3 SceneNode::Scale() const {
+    return TransformStore::Instance().LocalScale(tform_index_);
   }
 
   void SceneNode::SetScale(const glm::vec3 &scale) {
-    scale_ = scale;
+    TransformStore::Instance().LocalScale(tform_index_) = scale;
+    MarkTformDirty();
   }
 
-  const math::Rbt& SceneNode::Rbt() const {
-    return rbt_;
+  math::Rbt SceneNode::Rbt() const {
+    return TransformStore::Instance().LocalRbt(tform_index_);
   }
 
   void SceneNode::SetRbt(const math::Rbt &rbt) {
-    rbt_ = rbt;
+    TransformStore::Instance().LocalRbt(tform_index_) = rbt;
+    MarkTformDirty();
   }
 
   const std::string &SceneNode::Name() const {
-    return name_;
+    return NameRegistry::Instance().Str(name_id_);
   }
 
   void SceneNode::SetName(const std::string &name) {
-    name_ = name;
+    auto &registry = NameRegistry::Instance();
+    uint32_t name_id = registry.Intern(name);
+    if (name_id == name_id_) {
+      return;
+    }
+    // unnamed nodes are not indexed
+    if (name_id_ != NameRegistry::kEmptyName) {
+      registry.RemoveNode(name_id_, this);
+    }
+    name_id_ = name_id;
+    if (name_id_ != NameRegistry::kEmptyName) {
+      registry.AddNode(name_id_, this);
+    }
+  }
+
+  uint32_t SceneNode::NameId() const {
+    return name_id_;
   }
 
-  const math::Rbt& SceneNode::WorldRbt() const {
-    return world_rbt_;
+  math::Rbt SceneNode::WorldRbt() const {
+    return TransformStore::Instance().WorldRbt(tform_index_);
   }
 
-  const glm::vec3 &SceneNode::WorldScale() const {
-    return world_scale_;
+  glm::vec3 SceneNode::WorldScale() const {
+    return TransformStore::Instance().WorldScale(tform_index_);
   }
 
   void SceneNode::SetWorldRbt(const math::Rbt &rbt) {
+    auto &store = TransformStore::Instance();
     auto parent = parent_.lock();
-    rbt_ = math::Rbt::Inv(parent->world_rbt_) * rbt;
-    rbt_.Translation() /= parent->world_scale_;
-    world_rbt_ = rbt;
+    auto &local_rbt = store.LocalRbt(tform_index_);
+    local_rbt = math::Rbt::Inv(store.WorldRbt(parent->tform_index_)) * rbt;
+    local_rbt.Translation() /= store.WorldScale(parent->tform_index_);
+    store.WorldRbt(tform_index_) = rbt;
+    MarkTformDirty();
   }
 
 
-  std::vector<std::shared_ptr<Renderable>>& SceneNode::Renderables() {
+  const std::vector<std::shared_ptr<Renderable>>& SceneNode::Renderables() const {
     return renderables_;
   }
 
-  const std::vector<std::shared_ptr<Renderable>>& SceneNode::Renderables() const {
-    return renderables_;
+  void SceneNode::AddRenderable(std::shared_ptr<Renderable> renderable) {
+    if (!renderable)
+      return;
+    renderables_.push_back(std::move(renderable));
+    InvalidateAABB();
+    Engine::Instance().InvalidateRenderQueue();
+  }
+
+  void SceneNode::RemoveRenderable(const std::shared_ptr<Renderable> &renderable) {
+    auto iter = std::find(renderables_.begin(), renderables_.end(), renderable);
+    if (iter == renderables_.end())
+      return;
+    renderables_.erase(iter);
+    InvalidateAABB();
+    Engine::Instance().InvalidateRenderQueue();
   }
 
   std::vector<std::shared_ptr<Light>>& SceneNode::Lights() {
+    // newly attached lights need their transforms
+    TransformStore::Instance().SetHasAttachments(tform_index_);
+    MarkTformDirty();
     return lights_;
   }
 
@@ -134,6 +236,9 @@ namespace mineola {
   }
 
   std::vector<std::weak_ptr<Camera>>& SceneNode::Cameras() {
+    // newly attached cameras need their view matrices
+    TransformStore::Instance().SetHasAttachments(tform_index_);
+    MarkTformDirty();
     return cameras_;
   }
 
@@ -141,32 +246,47 @@ namespace mineola {
     return cameras_;
   }
 
+  void SceneNode::MarkTformDirty() {
+    // descendants are picked up by the level-order update
+    TransformStore::Instance().MarkDirty(tform_index_);
+    InvalidateAABB();
+  }
+
+  void SceneNode::InvalidateAABB() {
+    if (!aabb_valid_) {
+      return;  // ancestors were invalidated along with this node
+    }
+    // atomic as thread safe entities may invalidate common ancestors concurrently
+    aabb_valid_ = false;
+    auto parent = parent_.lock();
+    while (parent && parent->aabb_valid_) {
+      parent->aabb_valid_ = false;
+      parent = parent->parent_.lock();
+    }
+  }
+
   void SceneNode::UpdateSubtreeWorldTforms() {
-    DFTraverse([](SceneNode &node) {
-      auto parent = node.parent_.lock();
-      if (parent) {
-        math::Rbt scaled_local = node.rbt_;
-        scaled_local.Translation() = parent->world_scale_ * scaled_local.Translation();
-        node.world_rbt_ = parent->world_rbt_ * scaled_local;
-        node.world_scale_ = parent->world_scale_ * node.scale_;
-      } else {
-        node.world_rbt_ = node.rbt_;
-        node.world_scale_ = node.scale_;
-      }
+    TransformStore::Instance().Update(*this);
+  }
 
-      // update light transforms
-      for (auto &light : node.lights_) {
-        light->UpdateLightTransform(node.world_rbt_);
-      }
+  void SceneNode::UpdateAttachedTforms() {
+    const auto world_rbt = WorldRbt();
 
-      // update camera transforms
-      for (auto &weak_camera : node.cameras_) {
+    // update light transforms
+    for (auto &light : lights_) {
+      light->UpdateLightTransform(world_rbt);
+    }
+
+    // update camera transforms
+    if (!cameras_.empty()) {
+      auto view_mat = glm::inverse(world_rbt.ToMatrix());
+      for (auto &weak_camera : cameras_) {
         auto camera = weak_camera.lock();
         if (camera) {
-          camera->SetViewMatrix(glm::inverse(node.world_rbt_.ToMatrix()));
+          camera->SetViewMatrix(view_mat);
         }
       }
-    });
+    }
   }
 
   std::shared_ptr<SceneNode> SceneNode::FindNodeByName(
@@ -177,29 +297,51 @@ namespace mineola {
       return nullptr;
     }
 
-    std::string name_str = name;
-    return start_node->FindIf(
-      [&name_str](const SceneNode &node) {
-        return node.Name() == name_str;
-      });
+    auto &registry = NameRegistry::Instance();
+    uint32_t name_id = registry.Find(name);
+    if (name_id == NameRegistry::kInvalidName) {
+      return nullptr;
+    }
+    if (name_id == NameRegistry::kEmptyName) {
+      // unnamed nodes are not indexed
+      return start_node->FindIf(
+        [](const SceneNode &node) {
+          return node.NameId() == NameRegistry::kEmptyName;
+        });
+    }
+
+    const auto candidates = registry.Nodes(name_id);
+    if (candidates.size() == 1) {
+      auto node = candidates.front();
+      return InSubtree(*start_node, *node) ? node->weak_from_this().lock() : nullptr;
+    }
+
+    // the first match in depth-first order, as FindIf would return it
+    SceneNode *result = nullptr;
+    std::vector<uint32_t> path, result_path;
+    for (auto node : candidates) {
+      if (PathFrom(*start_node, *node, path) && (!result || path < result_path)) {
+        result = node;
+        result_path.swap(path);
+      }
+    }
+    return result ? result->weak_from_this().lock() : nullptr;
   }
 
   std::shared_ptr<SceneNode const> SceneNode::FindNodeByName(
     const char *name,
     const SceneNode *start_node) {
 
-    if (start_node == nullptr) {
-      return nullptr;
-    }
-
-    std::string name_str = name;
-    return start_node->FindIf(
-      [&name_str](const SceneNode &node) {
-        return node.Name() == name_str;
-      });
+    return FindNodeByName(name, const_cast<SceneNode *>(start_node));
   }
 
 std::optional<AABB> SceneNode::ComputeAABB() const {
+  // read first, a bbox set while computing makes the next call recompute
+  const uint32_t bbox_generation = Renderable::BboxGeneration();
+  if (aabb_valid_ && aabb_bbox_generation_ == bbox_generation) {
+    return cached_aabb_;
+  }
+
   std::optional<AABB> result;
   for (auto &child : Children()) {
     auto aabb = child->ComputeAABB();
@@ -223,10 +365,13 @@ std::optional<AABB> SceneNode::ComputeAABB() const {
   }
   
   if (result) {
-    auto model_mat = glm::scale(rbt_.ToMatrix(), scale_);
+    auto model_mat = glm::scale(Rbt().ToMatrix(), Scale());
     result->Transform(model_mat);
   }
 
+  cached_aabb_ = result;
+  aabb_bbox_generation_ = bbox_generation;
+  aabb_valid_ = true;
   return result;
 }
 
@@ -1,9 +1,11 @@
 #include "prefix.h"
 #include <iostream>
+#include <memory>
 #include <mineola/ServerAppFrame.h>
 #include <mineola/glutility.h>
 #include <EGL/egl.h>
 #include <mineola/AppHelper.h>
+#include <mineola/FramePipeline.h>
 
 namespace mineola {
 
@@ -103,25 +105,38 @@ void ServerAppFrame::Run(uint32_t width, uint32_t height) {
   ResizeScreen(window_width_, window_height_);
   auto &en = GetEngine();
 
+  std::unique_ptr<FramePipeline> pipeline;
+  if (pipelined_) {
+    pipeline = std::make_unique<FramePipeline>();
+  }
+
   //main loop
   running_ = true;
   while( running_ ) {
-    ///////////////////////////////////////////
-    //call frame move before rendering
-    FrameMove();
-    ///////////////////////////////////////////
-
-    ///////////////////////////////////////////
-    //render
-    Render();
-    ///////////////////////////////////////////
-
-    // Swap front and back rendering buffers
-    eglSwapBuffers(egl_display_, egl_surface_);
+    if (pipeline) {
+      // render this frame while the next one is simulated
+      pipeline->BeginFrame();
+      eglSwapBuffers(egl_display_, egl_surface_);
+      pipeline->EndFrame();
+    } else {
+      ///////////////////////////////////////////
+      //call frame move before rendering
+      FrameMove();
+      ///////////////////////////////////////////
+
+      ///////////////////////////////////////////
+      //render
+      Render();
+      ///////////////////////////////////////////
+
+      // Swap front and back rendering buffers
+      eglSwapBuffers(egl_display_, egl_surface_);
+    }
 
     // Check if ESC key was pressed or window was closed
     running_ = running_ && !en.TerminationSignaled();
   }
+  pipeline.reset();
 
   ReleaseScene();
   ReleaseEngine();
@@ -129,6 +144,10 @@ void ServerAppFrame::Run(uint32_t width, uint32_t height) {
   eglTerminate(egl_display_);
 }
 
+void ServerAppFrame::SetPipelined(bool pipelined) {
+  pipelined_ = pipelined;
+}
+
 void ServerAppFrame::InitScene() {
 }
 
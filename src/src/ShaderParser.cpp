@@ -1,39 +1,102 @@
 #include "prefix.h"
 #include <mineola/ShaderParser.h>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <string>
-#include <regex>
+#include <mutex>
+#include <unordered_map>
 #include <mineola/Engine.h>
+#include <mineola/FileSystem.h>
 
 namespace mineola { namespace shader_parser {
   const uint32_t kMaxIncludeDepth = 4;
-  bool IsIncludedFile(std::string &line,
+  // parsed outputs kept, the least recently used are dropped beyond it
+  const size_t kMaxParsedShaders = 256;
+  const char kSpaces[] = " \f\r\t\v";
+
+  using file_stamps_t = std::vector<std::pair<std::string, file_system::FileStamp>>;
+
+  struct CachedFile {
+    file_system::FileStamp stamp;
+    std::string content;
+  };
+
+  struct ParsedShader {
+    std::string shader_str;
+    file_stamps_t includes;  // files read, with their stamps at the time
+    uint64_t last_use{0};
+  };
+
+  // guards the caches, parsing holds it throughout
+  std::mutex cache_mutex;
+  std::unordered_map<std::string, CachedFile> file_cache;
+  // by defines and source text
+  std::unordered_map<std::string, ParsedShader> parsed_cache;
+  uint64_t parse_count = 0;
+
+  bool IsSpace(char c) {
+    return c != '\0' && strchr(kSpaces, c);
+  }
+
+  size_t SkipSpaces(std::string_view line, size_t pos) {
+    while (pos < line.size() && IsSpace(line[pos])) {
+      ++pos;
+    }
+    return pos;
+  }
+
+  // #include "filename", with optional spaces around the tokens
+  bool IsIncludedFile(std::string_view line,
     uint32_t line_number,
     std::string &include_filename) {
-    const std::string delimiters = " \f\r\t\v";
-    std::size_t first_found = line.find_first_not_of(delimiters);
-    if (first_found == std::string::npos) return false;
-    if (line[first_found] != '#') return false;
-
-    std::size_t second_found = line.substr(first_found).find_first_not_of(delimiters);
-    second_found += first_found + 1;
-    if (second_found + 7 >= line.size() || line.substr(second_found, 7) != "include") {
-      return false;
+    size_t pos = SkipSpaces(line, 0);
+    if (pos == line.size() || line[pos] != '#') return false;
+    pos = SkipSpaces(line, pos + 1);
+    if (line.substr(pos, 7) != "include") return false;
+    pos += 7;
+    if (pos < line.size() && line[pos] != '"' && !IsSpace(line[pos])) {
+      return false;  // another identifier starting with include
     }
 
-    std::regex e(R"("\S\S.*")");
-    std::smatch m;
-    std::string s = line.substr(second_found + 7);
-    std::size_t third_found = s.find_first_not_of(delimiters);
-    s = s.substr(third_found);
-    if (!std::regex_match(s, m, e)) {
-      MLOG("Include syntax error on line #%d: %s\n", line_number, line.c_str());
+    pos = SkipSpaces(line, pos);
+    size_t last = line.find_last_not_of(kSpaces);
+    if (pos >= line.size() || line[pos] != '"' || last <= pos + 1 || line[last] != '"') {
+      MLOG("Include syntax error on line #%d: %s\n", line_number, std::string(line).c_str());
       return false;
-    } else {
-      include_filename = m[0];
-      include_filename = include_filename.substr(1);
-      include_filename.pop_back();
+    }
+    include_filename = line.substr(pos + 1, last - pos - 1);
+    return true;
+  }
+
+  // cached content of a file, nullptr if it cannot be read
+  const std::string *ReadFile(const std::string &path, file_system::FileStamp &stamp) {
+    if (!file_system::GetFileStamp(path.c_str(), stamp)) {
+      return nullptr;
+    }
+    auto iter = file_cache.find(path);
+    if (iter != file_cache.end() && iter->second.stamp == stamp) {
+      return &iter->second.content;
+    }
+
+    std::ifstream infile(path, std::ios::binary);
+    if (!infile.good()) {
+      return nullptr;
+    }
+    std::ostringstream content;
+    content << infile.rdbuf();
+    auto &cached = file_cache[path];
+    cached.stamp = stamp;
+    cached.content = content.str();
+    return &cached.content;
+  }
+
+  bool IncludesUnchanged(const file_stamps_t &includes) {
+    file_system::FileStamp stamp;
+    for (const auto &include : includes) {
+      if (!file_system::GetFileStamp(include.first.c_str(), stamp) || stamp != include.second) {
+        return false;
+      }
     }
     return true;
   }
@@ -66,26 +129,57 @@ void InsertBuiltInUniformBlock(std::string &shader_str) {
         vec4 _time;
         vec4 _delta_time;
       };
-      uniform mat4 _model_mat;
+      // per draw, a range of a buffer written once per frame
+      layout(std140) uniform mineola_draw_uniforms {
+        mat4 _model_mat;
+      };
       uniform sampler2DShadow _shadowmap0;
       uniform sampler2D _env_light_probe_0;
     )";
     shader_str += built_in_uniform_str;
   }
 
+  // std140 layout must match MaterialUniforms
+  void InsertMaterialBlock(std::string &shader_str) {
+    static const char material_block_str[] = R"(
+      layout(std140) uniform mineola_material {
+        vec3 ambient;
+        float alpha;
+        vec3 diffuse;
+        float specularity;
+        vec3 specular;
+        float roughness;
+        vec3 emit;
+      };
+    )";
+    shader_str += material_block_str;
+  }
+
   void InsertSkinningVariables(std::string &shader_str) {
     static const char skinning_uniform_str[] = R"(
       #if defined(kMaxJoints)
       #else
-      #define kMaxJoints 32
+      #define kMaxJoints 256
       #endif
       in vec4 BlendIdx;
       in vec4 BlendWeight;
-      uniform mat4 _joint_mats[kMaxJoints];
+      // palette of the drawn skin, a range of a buffer written once per frame. The default
+      // size matches Skin::kMaxJoints and the minimum GL_MAX_UNIFORM_BLOCK_SIZE
+      layout(std140) uniform mineola_joint_uniforms {
+        mat4 _joint_mats[kMaxJoints];
+      };
     )";
     shader_str += skinning_uniform_str;
   }
 
+  void InsertInstancingVariables(std::string &shader_str) {
+    static const char instancing_str[] = R"(
+      // per-instance model matrix for instanced draws, a constant attribute otherwise
+      in mat4 _instance_model_mat;
+    )";
+    shader_str += instancing_str;
+  }
+
   void InsertHardShadowSnippet(std::string &shader_str) {
     static const char hard_shadow[] = R"(
     // 0.0 means totally in shadow, 1.0 means totally out of shadow
@@ -163,32 +257,41 @@ void InsertBuiltInUniformBlock(std::string &shader_str) {
   std::string BuildDefineString(const effect_defines_t *defines) {
     if (!defines)
       return "";
-    std::ostringstream result;
+    std::string result;
     for (auto &pair : *defines) {
-      if (pair.second.empty()) {
-        result << "#define " << pair.first << "\n";
-      } else {
-        result << "#define " << pair.first << " " << pair.second << "\n";
+      result += "#define ";
+      result += pair.first;
+      if (!pair.second.empty()) {
+        result += ' ';
+        result += pair.second;
       }
+      result += '\n';
     }
-    return result.str();
+    return result;
   }
 
-  bool ParseShader(std::istream &stream, const effect_defines_t *defines, std::string &shader_str) {
-    return RecursiveParseShader(stream, defines, 0, shader_str);
-  }
-
-  bool RecursiveParseShader(std::istream &stream,
-    const effect_defines_t *defines, uint32_t depth, std::string &shader_str) {
+  bool RecursiveParseShader(std::string_view source, const effect_defines_t *defines,
+    const std::string &define_str, uint32_t depth, ParsedShader &parsed) {
     if (depth > kMaxIncludeDepth) {
       MLOG("Include depth exceeds MAX include depth!\n");
       return false;
     }
 
-    std::string line;
+    std::string &shader_str = parsed.shader_str;
     uint32_t line_number = 0;
-    while(std::getline(stream, line)) {
+    size_t line_begin = 0;
+    while (line_begin < source.size()) {
+      size_t line_end = source.find('\n', line_begin);
+      if (line_end == std::string_view::npos) {
+        line_end = source.size();
+      }
+      std::string_view line = source.substr(line_begin, line_end - line_begin);
+      if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+      }
+      line_begin = line_end + 1;
       line_number++;
+
       std::string include_filename;
       if (IsIncludedFile(line, line_number, include_filename)) {
         if (defines) {
@@ -201,8 +304,12 @@ void InsertBuiltInUniformBlock(std::string &shader_str) {
 
         if (include_filename == "mineola_builtin_uniforms") {
           InsertBuiltInUniformBlock(shader_str);
+        } else if (include_filename == "mineola_material") {
+          InsertMaterialBlock(shader_str);
         } else if (include_filename == "mineola_skinned_animation") {
           InsertSkinningVariables(shader_str);
+        } else if (include_filename == "mineola_instancing") {
+          InsertInstancingVariables(shader_str);
         } else if (include_filename == "mineola_hard_shadow") {
           InsertHardShadowSnippet(shader_str);
         } else if (include_filename == "mineola_pcf_soft_shadow") {
@@ -213,34 +320,101 @@ void InsertBuiltInUniformBlock(std::string &shader_str) {
             MLOG("Include file %s does not exist!\n", include_filename.c_str());
             return false;
           }
-          std::ifstream infile(found_fn);
-          if (!infile.good()) {
+          file_system::FileStamp stamp;
+          const std::string *content = ReadFile(found_fn, stamp);
+          if (!content) {
             MLOG("Failed to open %s!\n", found_fn.c_str());
             return false;
           }
-          if (!RecursiveParseShader(infile, defines, depth + 1, shader_str)) {
-            infile.close();
+          parsed.includes.push_back({found_fn, stamp});
+          if (!RecursiveParseShader(*content, defines, define_str, depth + 1, parsed)) {
             return false;
           }
-          infile.close();
         }
       } else {
         if (shader_str.empty()) {
           // before appending the first line, check whether it's a version directive
           // and insert or append define strings
-          if (line.substr(0, 8) == std::string("#version")) {
-            shader_str += line + "\n";
-            shader_str += BuildDefineString(defines);
+          if (line.substr(0, 8) == "#version") {
+            shader_str += line;
+            shader_str += '\n';
+            shader_str += define_str;
           } else {
-            shader_str += BuildDefineString(defines);
-            shader_str += line + "\n";
+            shader_str += define_str;
+            shader_str += line;
+            shader_str += '\n';
           }
         } else {
-          shader_str += line + "\n";
+          shader_str += line;
+          shader_str += '\n';
         }
       }
     }
 
     return true;
   }
+
+  bool ParseShader(std::string_view source, const effect_defines_t *defines,
+    std::string &shader_str) {
+    const std::string define_str = BuildDefineString(defines);
+    // the full text, length prefixed so that defines and source cannot run into each other
+    std::string key = std::to_string(define_str.size());
+    key += ':';
+    key += define_str;
+    key += source;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    ++parse_count;
+    auto iter = parsed_cache.find(key);
+    if (iter != parsed_cache.end() && IncludesUnchanged(iter->second.includes)) {
+      iter->second.last_use = parse_count;
+      shader_str = iter->second.shader_str;
+      return true;
+    }
+
+    ParsedShader parsed;
+    if (!RecursiveParseShader(source, defines, define_str, 0, parsed)) {
+      return false;
+    }
+    shader_str = parsed.shader_str;
+    parsed.last_use = parse_count;
+    if (iter != parsed_cache.end()) {
+      iter->second = std::move(parsed);
+      return true;
+    }
+    if (parsed_cache.size() >= kMaxParsedShaders) {
+      auto oldest = parsed_cache.begin();
+      for (auto entry = parsed_cache.begin(); entry != parsed_cache.end(); ++entry) {
+        if (entry->second.last_use < oldest->second.last_use) {
+          oldest = entry;
+        }
+      }
+      parsed_cache.erase(oldest);
+    }
+    parsed_cache.emplace(std::move(key), std::move(parsed));
+    return true;
+  }
+
+  bool ParseShaderFile(const char *path, const effect_defines_t *defines,
+    std::string &shader_str) {
+    std::string source;
+    {
+      std::lock_guard<std::mutex> lock(cache_mutex);
+      file_system::FileStamp stamp;
+      const std::string *content = ReadFile(path, stamp);
+      if (!content) {
+        MLOG("Failed to open [%s]!\n", path);
+        return false;
+      }
+      source = *content;  // the cache may change once unlocked
+    }
+    return ParseShader(source, defines, shader_str);
+  }
+
+  void ClearCache() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    file_cache.clear();
+    parsed_cache.clear();
+    parse_count = 0;
+  }
 }}
@@ -1,10 +1,39 @@
 #include "prefix.h"
 #include <mineola/Skin.h>
 #include <glm/gtc/type_ptr.hpp>
-#include <glm/gtc/matrix_transform.hpp>
 #include <mineola/Engine.h>
 #include <mineola/SceneNode.h>
 #include <mineola/GLEffect.h>
+#include <mineola/UniformBlock.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MINEOLA_SKIN_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// out = a * b, column-major like glm
+void MulMat4(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out) {
+#ifdef MINEOLA_SKIN_SSE
+  const __m128 a0 = _mm_loadu_ps(glm::value_ptr(a[0]));
+  const __m128 a1 = _mm_loadu_ps(glm::value_ptr(a[1]));
+  const __m128 a2 = _mm_loadu_ps(glm::value_ptr(a[2]));
+  const __m128 a3 = _mm_loadu_ps(glm::value_ptr(a[3]));
+  for (int col = 0; col < 4; ++col) {
+    const float *b_col = glm::value_ptr(b[col]);
+    __m128 r = _mm_mul_ps(a0, _mm_set1_ps(b_col[0]));
+    r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b_col[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b_col[2])));
+    r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b_col[3])));
+    _mm_storeu_ps(glm::value_ptr(out[col]), r);
+  }
+#else
+  out = a * b;
+#endif
+}
+
+}
 
 namespace mineola {
 
@@ -12,17 +41,26 @@ Skin::Skin() = default;
 
 Skin::~Skin() = default;
 
+void Skin::PrepareFrame() {
+  CalculateMatrices();
+}
+
 void Skin::PreRender(double frame_time, uint32_t pass) {
   if (joint_nodes_.size() == 0) {
     return;
   }
 
-  CalculateMatrices();
-
-  // send uniforms to GPU
   auto &en = Engine::Instance();
   auto &effect = en.CurrentEffect();
-  effect->UploadVariable("_joint_mats[0]", glm::value_ptr(joint_mats_[0]));
+  if (effect->GetUniformBlockBinding(
+    UniformBlock::GetSemanticsString(UniformBlock::JOINT_UNIFORMS)) >= 0) {
+    if (!en.BindJointPalette(this)) {
+      en.UploadJointPalette(joint_mats_.data(), (uint32_t)joint_nodes_.size());
+    }
+  } else {
+    // effects declaring their own _joint_mats uniform array
+    effect->UploadVariable("_joint_mats[0]", glm::value_ptr(joint_mats_[0]));
+  }
 }
 
 void Skin::SetRootNode(std::shared_ptr<SceneNode> &node) {
@@ -41,8 +79,21 @@ void Skin::SetJointNodes(
   if (inv_bind_mats_.size() != num_joints) {
     throw std::logic_error("Wrong number of inverse bind matrices for joints!");
   }
+  if (num_joints > kMaxJoints) {
+    MLOG("Skin has %u joints, shaders address the first %u only!\n",
+      (uint32_t)num_joints, (uint32_t)kMaxJoints);
+  }
+
+  // padded for effects uploading _joint_mats arrays of a multiple of 32
+  joint_mats_.resize(num_joints_32);
+}
+
+size_t Skin::NumJoints() const {
+  return joint_nodes_.size();
+}
 
-  joint_mats_.resize(num_joints_32);  // only mats sent to GPU
+const glm::mat4 *Skin::JointMatrices() const {
+  return joint_mats_.data();
 }
 
 // collect joint node global transforms and recalculate joint matrices
@@ -50,9 +101,12 @@ void Skin::CalculateMatrices() {
   for (size_t idx = 0; idx < joint_nodes_.size(); ++idx) {
     auto node = joint_nodes_[idx].lock();
     auto global_joint_mat = node->WorldRbt().ToMatrix();
-    global_joint_mat = glm::scale(global_joint_mat, node->WorldScale());
+    const auto &scale = node->WorldScale();
+    global_joint_mat[0] *= scale.x;
+    global_joint_mat[1] *= scale.y;
+    global_joint_mat[2] *= scale.z;
 
-    joint_mats_[idx] = global_joint_mat * inv_bind_mats_[idx];
+    MulMat4(global_joint_mat, inv_bind_mats_[idx], joint_mats_[idx]);
   }
 }
 
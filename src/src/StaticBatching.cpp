@@ -0,0 +1,407 @@
+#include "prefix.h"
+#include <mineola/StaticBatching.h>
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <typeinfo>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <mineola/glutility.h>
+#include <mineola/Engine.h>
+#include <mineola/GraphicsBuffer.h>
+#include <mineola/Renderable.h>
+#include <mineola/SceneNode.h>
+#include <mineola/TriangleMesh.h>
+
+namespace {
+
+using namespace mineola;
+using namespace mineola::vertex_type;
+
+// keeps merged draws small enough for frustum culling to matter
+const uint32_t kMaxBatchVertices = 1 << 18;
+
+// effect, shadowmap effect, layer mask, queue, material, primitive type, vertex layout
+using BatchKey = std::tuple<std::string, std::string, int, int16_t, std::string, int,
+  std::vector<uint32_t>>;
+
+struct Batch {
+  std::vector<LayoutElement> layout;  // one output stream per element
+  std::vector<std::vector<uint8_t>> attributes;
+  std::vector<uint32_t> indices;
+  uint32_t num_vertices{0};
+  std::optional<AABB> bbox;
+};
+
+bool IsTransformed(uint32_t semantics) {
+  return semantics == POSITION || semantics == NORMAL ||
+    semantics == TANGENT || semantics == BINORMAL;
+}
+
+bool IsBatchable(VertexArray &va) {
+  int primitive = va.PrimitiveType();
+  if (primitive != GL_TRIANGLES && primitive != GL_LINES && primitive != GL_POINTS) {
+    return false;
+  }
+  if (va.VertexStreams().empty()) {
+    return false;
+  }
+  bool has_position = false;
+  for (const auto &stream : va.VertexStreams()) {
+    if (!stream->buffer_ptr || stream->size == 0) {
+      return false;
+    }
+    for (const auto &elem : stream->layout) {
+      if (IsTransformed(elem.semantics) &&
+        (elem.format != type_mapping::FLOAT32 || elem.length < 3)) {
+        return false;
+      }
+      has_position |= elem.semantics == POSITION;
+    }
+  }
+  if (va.IsIndexed() && !va.IndexStream()->buffer_ptr) {
+    return false;
+  }
+  return has_position;
+}
+
+std::vector<uint32_t> LayoutSignature(VertexArray &va) {
+  std::vector<uint32_t> signature;
+  for (const auto &stream : va.VertexStreams()) {
+    for (const auto &elem : stream->layout) {
+      signature.push_back(elem.semantics);
+      signature.push_back(elem.format);
+      signature.push_back(elem.length);
+    }
+  }
+  return signature;
+}
+
+// copies the bytes of count elements starting at the stream offset
+bool ReadStream(VertexStream &stream, uint32_t count, std::vector<uint8_t> &bytes) {
+  uint32_t element_bytes = 0;
+  for (const auto &elem : stream.layout) {
+    element_bytes += elem.SizeOf();
+  }
+  uint32_t size = (count - 1) * stream.Stride() + element_bytes;
+  auto ptr = (const uint8_t*)stream.buffer_ptr->MapRange(stream.offset, size, GL_MAP_READ_BIT);
+  if (!ptr) {
+    return false;
+  }
+  bytes.assign(ptr, ptr + size);
+  stream.buffer_ptr->Unmap();
+  return true;
+}
+
+bool ReadIndices(VertexArray &va, uint32_t num_vertices, std::vector<uint32_t> &indices) {
+  indices.clear();
+  if (!va.IsIndexed()) {
+    for (uint32_t idx = 0; idx < num_vertices; ++idx) {
+      indices.push_back(idx);
+    }
+    return true;
+  }
+
+  auto &stream = *va.IndexStream();
+  uint32_t format = stream.layout[0].format;
+  std::vector<uint8_t> bytes;
+  if (stream.size == 0 || !ReadStream(stream, stream.size, bytes)) {
+    return false;
+  }
+  uint32_t stride = stream.Stride();
+  for (uint32_t idx = 0; idx < stream.size; ++idx) {
+    const uint8_t *src = &bytes[idx * stride];
+    switch (format) {
+    case type_mapping::UBYTE:
+      indices.push_back(*src);
+      break;
+    case type_mapping::UINT16: {
+      uint16_t value;
+      memcpy(&value, src, sizeof(value));
+      indices.push_back(value);
+      break;
+    }
+    case type_mapping::UINT32: {
+      uint32_t value;
+      memcpy(&value, src, sizeof(value));
+      indices.push_back(value);
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+// appends the vertices of va transformed by model_mat to batch
+bool AppendVertexArray(VertexArray &va, const glm::mat4 &model_mat, Batch &batch) {
+  uint32_t num_vertices = va.VertexStreams()[0]->size;
+  std::vector<uint32_t> indices;
+  if (!ReadIndices(va, num_vertices, indices)) {
+    return false;
+  }
+
+  const glm::mat3 linear(model_mat);
+  const glm::mat3 normal_mat = glm::transpose(glm::inverse(linear));
+  const bool mirrored = glm::determinant(linear) < 0.f;
+
+  // read everything first, the batch is left untouched on failure
+  std::vector<std::vector<uint8_t>> sources;
+  for (const auto &stream : va.VertexStreams()) {
+    if (stream->size < num_vertices) {
+      return false;
+    }
+    sources.emplace_back();
+    if (!ReadStream(*stream, num_vertices, sources.back())) {
+      return false;
+    }
+  }
+
+  size_t elem_idx = 0;
+  for (size_t stream_idx = 0; stream_idx < sources.size(); ++stream_idx) {
+    auto &stream = *va.VertexStreams()[stream_idx];
+    const auto &src = sources[stream_idx];
+    uint32_t stride = stream.Stride();
+    uint32_t elem_offset = 0;
+    for (const auto &elem : stream.layout) {
+      auto &dst = batch.attributes[elem_idx++];
+      uint32_t elem_bytes = elem.SizeOf();
+      size_t dst_offset = dst.size();
+      dst.resize(dst_offset + (size_t)elem_bytes * num_vertices);
+
+      for (uint32_t vert = 0; vert < num_vertices; ++vert) {
+        const uint8_t *in = &src[vert * stride + elem_offset];
+        uint8_t *out = &dst[dst_offset + (size_t)vert * elem_bytes];
+        if (!IsTransformed(elem.semantics)) {
+          memcpy(out, in, elem_bytes);
+          continue;
+        }
+
+        float value[4] = {0.f, 0.f, 0.f, 1.f};
+        memcpy(value, in, elem_bytes);
+        glm::vec3 v(value[0], value[1], value[2]);
+        if (elem.semantics == POSITION) {
+          glm::vec4 p = model_mat * glm::vec4(v, elem.length == 4 ? value[3] : 1.f);
+          v = glm::vec3(p);
+          value[3] = p.w;
+          if (batch.bbox) {
+            batch.bbox->Combine(AABB(v, v));
+          } else {
+            batch.bbox = AABB(v, v);
+          }
+        } else if (elem.semantics == NORMAL) {
+          v = glm::normalize(normal_mat * v);
+        } else {
+          v = glm::normalize(linear * v);
+          if (mirrored && elem.semantics == TANGENT) {
+            value[3] = -value[3];  // bitangent sign
+          }
+        }
+        value[0] = v.x; value[1] = v.y; value[2] = v.z;
+        memcpy(out, value, elem_bytes);
+      }
+      elem_offset += elem_bytes;
+    }
+  }
+
+  // mirroring flips the winding
+  if (mirrored && va.PrimitiveType() == GL_TRIANGLES) {
+    for (size_t tri = 0; tri + 2 < indices.size(); tri += 3) {
+      std::swap(indices[tri + 1], indices[tri + 2]);
+    }
+  }
+  for (uint32_t index : indices) {
+    batch.indices.push_back(batch.num_vertices + index);
+  }
+  batch.num_vertices += num_vertices;
+  return true;
+}
+
+std::shared_ptr<VertexArray> CreateVertexArray(const Batch &batch, int primitive) {
+  auto &arena = Engine::Instance().GeomArena();
+  auto va = std::make_shared<VertexArray>();
+  for (size_t idx = 0; idx < batch.layout.size(); ++idx) {
+    auto vs = std::make_shared<VertexStream>();
+    vs->layout.push_back(batch.layout[idx]);
+    vs->type = VST_VERTEX;
+    vs->size = batch.num_vertices;
+    if (!arena.AllocateStream(*vs, GL_ARRAY_BUFFER, batch.attributes[idx].data())) {
+      return nullptr;
+    }
+    va->AddVertexStream(vs);
+  }
+
+  auto is = std::make_shared<VertexStream>();
+  is->layout.push_back({INDEX, type_mapping::UINT32, 1});
+  is->type = VST_INDEX;
+  is->size = (uint32_t)batch.indices.size();
+  if (!arena.AllocateStream(*is, GL_ELEMENT_ARRAY_BUFFER, batch.indices.data())) {
+    return nullptr;
+  }
+  va->SetIndexStream(is);
+  va->PrimitiveType() = primitive;
+
+  if (primitive == GL_TRIANGLES && Engine::Instance().RetainCPUGeometry()) {
+    for (size_t idx = 0; idx < batch.layout.size(); ++idx) {
+      if (batch.layout[idx].semantics != POSITION) {
+        continue;
+      }
+      std::vector<glm::vec3> positions(batch.num_vertices);
+      uint32_t elem_bytes = batch.layout[idx].SizeOf();
+      for (uint32_t vert = 0; vert < batch.num_vertices; ++vert) {
+        memcpy(&positions[vert], &batch.attributes[idx][(size_t)vert * elem_bytes],
+          sizeof(glm::vec3));
+      }
+      va->SetTriangleMesh(std::make_shared<TriangleMesh>(std::move(positions), batch.indices));
+      break;
+    }
+  }
+  return va;
+}
+
+}
+
+namespace mineola { namespace static_batching {
+
+size_t BuildStaticBatches(const std::shared_ptr<SceneNode> &root) {
+  if (!root) {
+    return 0;
+  }
+  root->UpdateSubtreeWorldTforms();
+  auto node_matrix = [](const SceneNode &node) {
+    return glm::scale(node.WorldRbt().ToMatrix(), node.WorldScale());
+  };
+  const glm::mat4 root_inv = glm::inverse(node_matrix(*root));
+
+  // finished batches of each key, the last one is being filled
+  std::map<BatchKey, std::deque<Batch>> batches;
+  std::vector<std::pair<SceneNode*, std::shared_ptr<Renderable>>> merged;
+
+  root->DFTraverse([&](SceneNode &node) {
+    const glm::mat4 model_mat = root_inv * node_matrix(node);
+    for (const auto &renderable : node.Renderables()) {
+      if (typeid(*renderable) != typeid(Renderable) || renderable->IsSkinned() ||
+        renderable->OccluderMesh() || renderable->NumVertexArray() == 0) {
+        continue;
+      }
+      bool batchable = true;
+      for (size_t idx = 0; idx < renderable->NumVertexArray() && batchable; ++idx) {
+        batchable = IsBatchable(*renderable->GetVertexArray((int)idx));
+      }
+      if (!batchable) {
+        continue;
+      }
+
+      auto shadowmap_effect = renderable->GetShadowmapEffectName();
+      std::vector<std::pair<Batch*, Batch>> appended;  // committed once all arrays are read
+      std::map<Batch*, uint32_t> pending;  // vertices appended but not committed
+      for (size_t idx = 0; idx < renderable->NumVertexArray(); ++idx) {
+        auto va = renderable->GetVertexArray((int)idx);
+        BatchKey key(renderable->GetEffectName(),
+          shadowmap_effect ? *shadowmap_effect : "",
+          renderable->LayerMask(), renderable->QueueId(),
+          renderable->GetMaterialName(idx), va->PrimitiveType(), LayoutSignature(*va));
+
+        auto &key_batches = batches[key];
+        uint32_t num_vertices = va->VertexStreams()[0]->size;
+        if (key_batches.empty() || key_batches.back().num_vertices +
+          pending[&key_batches.back()] + num_vertices > kMaxBatchVertices) {
+          key_batches.emplace_back();
+          auto &batch = key_batches.back();
+          for (const auto &stream : va->VertexStreams()) {
+            for (const auto &elem : stream->layout) {
+              batch.layout.push_back(elem);
+            }
+          }
+          batch.attributes.resize(batch.layout.size());
+        }
+
+        auto &target = key_batches.back();
+        Batch staged;
+        staged.layout = target.layout;
+        staged.attributes.resize(target.layout.size());
+        // indices are rebased onto the target
+        const uint32_t base = target.num_vertices + pending[&target];
+        staged.num_vertices = base;
+        if (!AppendVertexArray(*va, model_mat, staged)) {
+          batchable = false;
+          break;
+        }
+        staged.num_vertices -= base;
+        pending[&target] += staged.num_vertices;
+        appended.emplace_back(&target, std::move(staged));
+      }
+      if (!batchable) {
+        MLOG("Static batching skipped a renderable, vertex data not readable\n");
+        continue;
+      }
+
+      for (auto &[target, staged] : appended) {
+        for (size_t elem = 0; elem < staged.attributes.size(); ++elem) {
+          target->attributes[elem].insert(target->attributes[elem].end(),
+            staged.attributes[elem].begin(), staged.attributes[elem].end());
+        }
+        target->indices.insert(target->indices.end(),
+          staged.indices.begin(), staged.indices.end());
+        target->num_vertices += staged.num_vertices;
+        if (staged.bbox) {
+          if (target->bbox) {
+            target->bbox->Combine(*staged.bbox);
+          } else {
+            target->bbox = staged.bbox;
+          }
+        }
+      }
+      merged.emplace_back(&node, renderable);
+    }
+  });
+
+  if (merged.empty()) {
+    return 0;
+  }
+
+  auto batch_node = std::make_shared<SceneNode>("static_batch");
+  size_t num_batches = 0;
+  for (const auto &[key, key_batches] : batches) {
+    for (const auto &batch : key_batches) {
+      if (batch.num_vertices == 0) {
+        continue;
+      }
+      auto va = CreateVertexArray(batch, std::get<5>(key));
+      if (!va) {
+        MLOG("Failed to create static batch vertex array\n");
+        continue;
+      }
+      auto renderable = std::make_shared<Renderable>(std::get<3>(key));
+      renderable->AddVertexArray(va, std::get<4>(key).c_str());
+      renderable->SetEffect(std::get<0>(key));
+      if (!std::get<1>(key).empty()) {
+        renderable->SetShadowmapEffect(std::get<1>(key));
+      }
+      renderable->SetLayerMask(std::get<2>(key));
+      if (batch.bbox) {
+        renderable->SetBbox(*batch.bbox);
+      }
+      batch_node->AddRenderable(renderable);
+      ++num_batches;
+    }
+  }
+
+  for (const auto &[node, renderable] : merged) {
+    node->RemoveRenderable(renderable);
+  }
+  SceneNode::LinkTo(batch_node, root);
+
+  // the source meshes are freed unless referenced elsewhere, close the holes they leave
+  merged.clear();
+  Engine::Instance().GeomArena().Defragment();
+  return num_batches;
+}
+
+}} // namespace
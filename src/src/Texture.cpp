@@ -2,6 +2,7 @@
 #include <mineola/Texture.h>
 #include <algorithm>
 #include <mineola/glutility.h>
+#include <mineola/Engine.h>
 #include <mineola/TextureTypes.h>
 
 namespace {
@@ -18,7 +19,13 @@ Texture::~Texture() {
 }
 
 void Texture::Bind() {
-  glBindTexture(desc_.type, handle_);
+  Engine::Instance().RenderStateMgr().BindTexture(desc_.type, handle_);
+}
+
+void Texture::BindToUnit(uint32_t unit) {
+  auto &mgr = Engine::Instance().RenderStateMgr();
+  mgr.ActiveTexture(unit);
+  mgr.BindTexture(desc_.type, handle_);
 }
 
 uint32_t Texture::Handle() const {
@@ -49,8 +56,10 @@ InternalTexture::InternalTexture() {
 }
 
 InternalTexture::~InternalTexture() {
-  if (handle_)
+  if (handle_) {
     glDeleteTextures(1, &handle_);
+    Engine::Instance().RenderStateMgr().OnTextureDeleted(handle_);
+  }
 }
 
 ///////////////////////////////////
@@ -77,7 +86,7 @@ bool Texture2D::Create(const TextureDesc &desc) {
   }
 
   desc_ = desc;
-  glBindTexture(desc_.type, handle_);
+  Bind();
 
   int actual_levels = desc_.levels;
   if (actual_levels == 0) {  // manually calculate max level
@@ -197,7 +206,7 @@ bool Texture2D::Create(const TextureDesc &desc) {
       }
     }
   }
-  glBindTexture(desc_.type, 0);
+  Engine::Instance().RenderStateMgr().BindTexture(desc_.type, 0);
   desc_.src_data.reset();
   CHKGLERR_RET
 
@@ -208,7 +217,7 @@ bool Texture2D::UpdateTexture(const SubTextureDesc &sub_desc, const void *data)
   if (handle_ == 0)
     return false;
 
-  glBindTexture(desc_.type, handle_);
+  Bind();
 
   if (sub_desc.x_offset + sub_desc.width > desc_.width
     || sub_desc.y_offset + sub_desc.height > desc_.height) {
@@ -235,7 +244,7 @@ bool Texture2D::UpdateTexture(const SubTextureDesc &sub_desc, const void *data)
     glPixelStorei(GL_UNPACK_ALIGNMENT, kDefaultAlignment);
   }
 
-  glBindTexture(desc_.type, 0);
+  Engine::Instance().RenderStateMgr().BindTexture(desc_.type, 0);
   return true;
 }
 
@@ -256,7 +265,7 @@ bool Texture3D::Create(const TextureDesc &desc) {
     return false;
 
   desc_ = desc;
-  glBindTexture(desc_.type, handle_);
+  Bind();
 
   int actual_levels = desc_.levels;
   if (actual_levels == 0) {  // manually calculate max level
@@ -325,7 +334,7 @@ bool Texture3D::Create(const TextureDesc &desc) {
       glPixelStorei(GL_UNPACK_ALIGNMENT, kDefaultAlignment);
     }
   }
-  glBindTexture(desc_.type, 0);
+  Engine::Instance().RenderStateMgr().BindTexture(desc_.type, 0);
   desc_.src_data.reset();
   CHKGLERR_RET
 
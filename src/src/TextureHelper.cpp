@@ -581,9 +581,8 @@ bool CreateShadowmapRenderTarget(uint32_t width, uint32_t height) {
   }
 
   // bind to texture unit
-  glActiveTexture(GL_TEXTURE0 + kShadowmap0TextureUnit);
-  depth_texture->Bind();
-  glActiveTexture(GL_TEXTURE0 + kNumReservedTextureUnits);
+  depth_texture->BindToUnit(kShadowmap0TextureUnit);
+  Engine::Instance().RenderStateMgr().ActiveTexture(kNumReservedTextureUnits);
   CHKGLERR_RET;
   return true;
 }
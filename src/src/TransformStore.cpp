@@ -0,0 +1,262 @@
+#include "prefix.h"
+#include <mineola/TransformStore.h>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <mineola/SceneNode.h>
+#include <mineola/JobSystem.h>
+
+namespace {
+
+const uint32_t kNoDirtySlot = std::numeric_limits<uint32_t>::max();
+
+void AtomicMin(std::atomic<uint32_t> &value, uint32_t candidate) {
+  uint32_t current = value.load(std::memory_order_relaxed);
+  while (candidate < current &&
+    !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {}
+}
+
+void AtomicMax(std::atomic<uint32_t> &value, uint32_t candidate) {
+  uint32_t current = value.load(std::memory_order_relaxed);
+  while (candidate > current &&
+    !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {}
+}
+
+}
+
+namespace mineola {
+
+TransformStore::TransformStore() :
+  dirty_begin_(kNoDirtySlot), dirty_end_(0), ordered_(true) {
+}
+
+TransformStore::~TransformStore() {
+}
+
+TransformStore &TransformStore::Instance() {
+  static TransformStore store;
+  return store;
+}
+
+size_t TransformStore::Size() const {
+  return nodes_.size();
+}
+
+uint32_t TransformStore::Allocate(SceneNode *node) {
+  uint32_t idx = (uint32_t)nodes_.size();
+  local_rbts_.emplace_back();
+  local_scales_.emplace_back(1.f, 1.f, 1.f);
+  world_rbts_.emplace_back();
+  world_scales_.emplace_back(1.f, 1.f, 1.f);
+  parents_.push_back(-1);
+  dirty_.push_back(0);
+  changed_.push_back(0);
+  has_attachments_.push_back(0);
+  nodes_.push_back(node);
+  child_begin_.push_back(0);
+  child_end_.push_back(0);
+  MarkDirty(idx);
+  ordered_ = false;
+  return idx;
+}
+
+void TransformStore::Free(uint32_t idx) {
+  // slot is dropped on next reorder
+  nodes_[idx] = nullptr;
+  ordered_ = false;
+}
+
+void TransformStore::SetParent(uint32_t idx, int32_t parent_idx) {
+  parents_[idx] = parent_idx;
+  MarkDirty(idx);
+  ordered_ = false;
+}
+
+void TransformStore::MarkDirty(uint32_t idx) {
+  dirty_[idx] = 1;
+  AtomicMin(dirty_begin_, idx);
+  AtomicMax(dirty_end_, idx + 1);
+}
+
+void TransformStore::SetHasAttachments(uint32_t idx) {
+  has_attachments_[idx] = 1;
+}
+
+void TransformStore::Reorder() {
+  const uint32_t num_slots = (uint32_t)nodes_.size();
+  std::vector<uint32_t> new_order;
+  new_order.reserve(num_slots);
+  level_offsets_.clear();
+
+  // roots, including nodes whose parent has been destroyed
+  for (uint32_t idx = 0; idx < num_slots; ++idx) {
+    if (!nodes_[idx]) {
+      continue;
+    }
+    int32_t parent = parents_[idx];
+    if (parent < 0 || !nodes_[parent]) {
+      if (parent >= 0) {
+        parents_[idx] = -1;
+        dirty_[idx] = 1;
+      }
+      new_order.push_back(idx);
+    }
+  }
+
+  // breadth-first, one level at a time
+  std::vector<uint32_t> child_begin, child_end;
+  child_begin.reserve(num_slots);
+  child_end.reserve(num_slots);
+  size_t level_begin = 0;
+  while (level_begin < new_order.size()) {
+    level_offsets_.push_back((uint32_t)level_begin);
+    size_t level_end = new_order.size();
+    for (size_t i = level_begin; i < level_end; ++i) {
+      child_begin.push_back((uint32_t)new_order.size());
+      for (auto &child : nodes_[new_order[i]]->Children()) {
+        new_order.push_back(child->tform_index_);
+      }
+      child_end.push_back((uint32_t)new_order.size());
+    }
+    level_begin = level_end;
+  }
+  level_offsets_.push_back((uint32_t)new_order.size());
+
+  // permute all arrays
+  std::vector<int32_t> old_to_new(num_slots, -1);
+  for (uint32_t new_idx = 0; new_idx < (uint32_t)new_order.size(); ++new_idx) {
+    old_to_new[new_order[new_idx]] = (int32_t)new_idx;
+  }
+
+  auto permute = [&new_order](auto &values) {
+    std::remove_reference_t<decltype(values)> result;
+    result.reserve(new_order.size());
+    for (auto old_idx : new_order) {
+      result.push_back(values[old_idx]);
+    }
+    values.swap(result);
+  };
+  permute(local_rbts_);
+  permute(local_scales_);
+  permute(world_rbts_);
+  permute(world_scales_);
+  permute(parents_);
+  permute(dirty_);
+  permute(changed_);
+  permute(has_attachments_);
+  permute(nodes_);
+  child_begin_.swap(child_begin);
+  child_end_.swap(child_end);
+
+  uint32_t dirty_begin = kNoDirtySlot, dirty_end = 0;
+  for (uint32_t idx = 0; idx < (uint32_t)nodes_.size(); ++idx) {
+    if (parents_[idx] >= 0) {
+      parents_[idx] = old_to_new[parents_[idx]];
+    }
+    nodes_[idx]->tform_index_ = idx;
+    if (dirty_[idx]) {
+      dirty_begin = std::min(dirty_begin, idx);
+      dirty_end = idx + 1;
+    }
+  }
+  dirty_begin_ = dirty_begin;
+  dirty_end_ = dirty_end;
+
+  ordered_ = true;
+}
+
+void TransformStore::Update(const SceneNode &root) {
+  if (!ordered_) {
+    Reorder();
+  }
+  if (dirty_begin_ >= dirty_end_) {
+    return;
+  }
+  const uint32_t dirty_begin = dirty_begin_;
+  const uint32_t dirty_end = dirty_end_;
+
+  // slot ranges visited per level: the dirty bounds, clipped to the subtree of root, plus
+  // the children of the range visited in the level above
+  std::vector<std::pair<uint32_t, uint32_t>> ranges;
+  const uint32_t root_idx = root.tform_index_;
+  size_t level = std::upper_bound(level_offsets_.begin(), level_offsets_.end(), root_idx) -
+    level_offsets_.begin() - 1;
+  uint32_t subtree_begin = root_idx, subtree_end = root_idx + 1;
+  uint32_t begin = 0, end = 0;  // visited in the previous level
+
+  auto &jobs = JobSystem::Instance();
+  for (; level + 1 < level_offsets_.size() && subtree_begin < subtree_end; ++level) {
+    uint32_t next_begin = subtree_begin, next_end = subtree_begin;
+    const uint32_t lo = std::max(subtree_begin, dirty_begin);
+    const uint32_t hi = std::min(subtree_end, dirty_end);
+    if (lo < hi) {
+      next_begin = lo;
+      next_end = hi;
+    }
+    if (begin < end && child_begin_[begin] < child_end_[end - 1]) {
+      if (next_begin < next_end) {
+        next_begin = std::min(next_begin, child_begin_[begin]);
+        next_end = std::max(next_end, child_end_[end - 1]);
+      } else {
+        next_begin = child_begin_[begin];
+        next_end = child_end_[end - 1];
+      }
+    }
+    begin = next_begin;
+    end = next_end;
+    if (begin < end) {
+      ranges.emplace_back(begin, end);
+    } else if (dirty_end <= level_offsets_[level + 1]) {
+      break;  // nothing changed here, and no dirty slots further down
+    }
+
+    // parents all live in the previous levels, slots within a level are independent
+    jobs.ParallelFor(begin, end, kParallelMinLevelSize, [this](size_t idx) {
+      int32_t parent = parents_[idx];
+      bool changed = dirty_[idx] || (parent >= 0 && changed_[parent]);
+      changed_[idx] = changed;
+      dirty_[idx] = 0;
+      if (!changed) {
+        return;
+      }
+
+      if (parent >= 0) {
+        const auto &parent_scale = world_scales_[parent];
+        math::Rbt scaled_local = local_rbts_[idx];
+        scaled_local.Translation() = parent_scale * scaled_local.Translation();
+        world_rbts_[idx] = world_rbts_[parent] * scaled_local;
+        world_scales_[idx] = parent_scale * local_scales_[idx];
+      } else {
+        world_rbts_[idx] = local_rbts_[idx];
+        world_scales_[idx] = local_scales_[idx];
+      }
+    });
+
+    const uint32_t child_lo = child_begin_[subtree_begin];
+    const uint32_t child_hi = child_end_[subtree_end - 1];
+    subtree_begin = child_lo;
+    subtree_end = child_hi;
+  }
+
+  // lights and cameras following the changed nodes
+  for (auto [range_begin, range_end] : ranges) {
+    for (uint32_t idx = range_begin; idx < range_end; ++idx) {
+      if (changed_[idx]) {
+        if (has_attachments_[idx]) {
+          nodes_[idx]->UpdateAttachedTforms();
+        }
+        changed_[idx] = 0;
+      }
+    }
+  }
+
+  // slots outside the subtree may still be dirty
+  auto first = std::find(dirty_.begin() + dirty_begin, dirty_.begin() + dirty_end, 1);
+  auto last = std::find(std::make_reverse_iterator(dirty_.begin() + dirty_end),
+    std::make_reverse_iterator(first), 1);
+  dirty_begin_ = first == dirty_.begin() + dirty_end ?
+    kNoDirtySlot : (uint32_t)(first - dirty_.begin());
+  dirty_end_ = (uint32_t)(last.base() - dirty_.begin());
+}
+
+} // namespace
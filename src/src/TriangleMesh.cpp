@@ -0,0 +1,83 @@
+#include "prefix.h"
+#include <mineola/TriangleMesh.h>
+#include <cmath>
+#include <optional>
+
+namespace mineola {
+
+TriangleMesh::TriangleMesh(std::vector<glm::vec3> positions, std::vector<uint32_t> indices) :
+  positions_(std::move(positions)), indices_(std::move(indices)), bvh_built_(false) {
+}
+
+TriangleMesh::~TriangleMesh() {
+}
+
+const std::vector<glm::vec3> &TriangleMesh::Positions() const {
+  return positions_;
+}
+
+const std::vector<uint32_t> &TriangleMesh::Indices() const {
+  return indices_;
+}
+
+size_t TriangleMesh::NumTriangles() const {
+  return indices_.size() / 3;
+}
+
+void TriangleMesh::BuildBVH() const {
+  std::vector<std::optional<AABB>> tri_bounds(NumTriangles());
+  for (size_t tri = 0; tri < tri_bounds.size(); ++tri) {
+    const auto &p0 = positions_[indices_[tri * 3]];
+    const auto &p1 = positions_[indices_[tri * 3 + 1]];
+    const auto &p2 = positions_[indices_[tri * 3 + 2]];
+    tri_bounds[tri] = AABB(glm::min(glm::min(p0, p1), p2), glm::max(glm::max(p0, p1), p2));
+  }
+  bvh_.Build(tri_bounds);
+  bvh_built_ = true;
+}
+
+bool TriangleMesh::IntersectRay(const glm::vec3 &origin, const glm::vec3 &dir, float t_max,
+  TriangleHit &hit) const {
+  if (!bvh_built_) {
+    BuildBVH();
+  }
+
+  bool found = false;
+  bvh_.QueryRay(origin, dir, t_max, [&](uint32_t tri, float t_limit) {
+    // Moller-Trumbore, double sided
+    const auto &p0 = positions_[indices_[tri * 3]];
+    const auto &p1 = positions_[indices_[tri * 3 + 1]];
+    const auto &p2 = positions_[indices_[tri * 3 + 2]];
+    glm::vec3 e1 = p1 - p0;
+    glm::vec3 e2 = p2 - p0;
+    glm::vec3 p = glm::cross(dir, e2);
+    float det = glm::dot(e1, p);
+    if (std::abs(det) < 1e-12f) {
+      return t_limit;  // parallel or degenerate
+    }
+    float inv_det = 1.f / det;
+    glm::vec3 s = origin - p0;
+    float u = glm::dot(s, p) * inv_det;
+    if (u < 0.f || u > 1.f) {
+      return t_limit;
+    }
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(dir, q) * inv_det;
+    if (v < 0.f || u + v > 1.f) {
+      return t_limit;
+    }
+    float t = glm::dot(e2, q) * inv_det;
+    if (t < 0.f || t > t_limit) {
+      return t_limit;
+    }
+
+    hit.t = t;
+    hit.triangle = tri;
+    hit.barycentric = glm::vec2(u, v);
+    found = true;
+    return t;
+  });
+  return found;
+}
+
+} // namespace
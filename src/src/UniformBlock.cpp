@@ -1,5 +1,7 @@
 #include "prefix.h"
 #include <mineola/UniformBlock.h>
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <mineola/glutility.h>
 #include <mineola/GraphicsBuffer.h>
@@ -10,6 +12,12 @@ const char *UniformBlock::GetSemanticsString(int semantics) {
   switch (semantics) {
   case BUILTIN_UNIFORMS:
     return "mineola_builtin_uniforms";
+  case MATERIAL_UNIFORMS:
+    return "mineola_material";
+  case DRAW_UNIFORMS:
+    return "mineola_draw_uniforms";
+  case JOINT_UNIFORMS:
+    return "mineola_joint_uniforms";
   }
   return nullptr;
 }
@@ -18,11 +26,74 @@ uint32_t UniformBlock::GetSemanticsBindLocation(int semantics) {
   switch (semantics) {
   case BUILTIN_UNIFORMS:
     return 0;
+  case MATERIAL_UNIFORMS:
+    return 1;
+  case DRAW_UNIFORMS:
+    return 2;
+  case JOINT_UNIFORMS:
+    return 3;
   }
   return -1;
 }
 
-UniformBlock::UniformBlock(uint32_t block_index) {
+const char *UniformBlock::GetBuiltinVariableString(int variable) {
+  switch (variable) {
+  case VIEW_MAT: return "_view_mat";
+  case VIEW_MAT_INV: return "_view_mat_inv";
+  case PROJ_MAT: return "_proj_mat";
+  case PROJ_MAT_INV: return "_proj_mat_inv";
+  case PROJ_VIEW_MAT: return "_proj_view_mat";
+  case LIGHT_VIEW_MAT_0: return "_light_view_mat_0";
+  case LIGHT_PROJ_MAT_0: return "_light_proj_mat_0";
+  case VIEWPORT_SIZE: return "_viewport_size";
+  case LIGHT_POS_0: return "_light_pos_0";
+  case LIGHT_INTENSITY_0: return "_light_intensity_0";
+  case LIGHT_POS_1: return "_light_pos_1";
+  case LIGHT_INTENSITY_1: return "_light_intensity_1";
+  case LIGHT_POS_2: return "_light_pos_2";
+  case LIGHT_INTENSITY_2: return "_light_intensity_2";
+  case LIGHT_POS_3: return "_light_pos_3";
+  case LIGHT_INTENSITY_3: return "_light_intensity_3";
+  case ENV_LIGHT_MAT_0: return "_env_light_mat_0";
+  case ENV_LIGHT_SH3_0: return "_env_light_sh3_0[0]";
+  case TIME: return "_time";
+  case DELTA_TIME: return "_delta_time";
+  default: return nullptr;
+  }
+}
+
+uint32_t UniformBlock::GetBuiltinVariableSize(int variable) {
+  switch (variable) {
+  case VIEW_MAT:
+  case VIEW_MAT_INV:
+  case PROJ_MAT:
+  case PROJ_MAT_INV:
+  case PROJ_VIEW_MAT:
+  case LIGHT_VIEW_MAT_0:
+  case LIGHT_PROJ_MAT_0:
+  case ENV_LIGHT_MAT_0:
+    return 16 * (uint32_t)sizeof(float);
+  case ENV_LIGHT_SH3_0:
+    return 9 * 4 * (uint32_t)sizeof(float);
+  case VIEWPORT_SIZE:
+  case LIGHT_POS_0:
+  case LIGHT_INTENSITY_0:
+  case LIGHT_POS_1:
+  case LIGHT_INTENSITY_1:
+  case LIGHT_POS_2:
+  case LIGHT_INTENSITY_2:
+  case LIGHT_POS_3:
+  case LIGHT_INTENSITY_3:
+  case TIME:
+  case DELTA_TIME:
+    return 4 * (uint32_t)sizeof(float);
+  default:
+    return 0;
+  }
+}
+
+UniformBlock::UniformBlock(uint32_t block_index) :
+  dirty_begin_(0), dirty_end_(0) {
   buffer_ = std::make_unique<GraphicsBuffer>(GraphicsBuffer::DYNAMIC,
     GraphicsBuffer::SEND, GraphicsBuffer::READ_ONLY, GL_UNIFORM_BUFFER, block_index);
 }
@@ -31,23 +102,70 @@ UniformBlock::~UniformBlock() {
 }
 
 bool UniformBlock::SetSize(uint32_t size) {
+  data_.assign(size, 0);
+  // storage is uninitialized, upload the zeros with the first flush
+  dirty_begin_ = 0;
+  dirty_end_ = size;
   return buffer_->SetSize(size);
 }
 
 void UniformBlock::Activate() {
+  Flush();
   buffer_->BindBase();
 }
 
 void UniformBlock::SetVariable(const char *variable_name, uint32_t offset, uint32_t size) {
-  variable_map_[variable_name] = {offset, size};
+  auto iter = variable_map_.find(variable_name);
+  if (iter != variable_map_.end()) {
+    variables_[iter->second] = {offset, size};
+  } else {
+    variable_map_[variable_name] = (int32_t)variables_.size();
+    variables_.push_back({offset, size});
+  }
 }
 
-bool UniformBlock::UpdateVariable(const char *variable_name, const void *data) {
+int32_t UniformBlock::GetVariableHandle(const char *variable_name) const {
   auto iter = variable_map_.find(variable_name);
-  if (iter != variable_map_.end()) {
-    return buffer_->UpdateData(iter->second.first, iter->second.second, data);
+  return iter != variable_map_.end() ? iter->second : -1;
+}
+
+bool UniformBlock::UpdateVariable(int32_t handle, const void *data) {
+  if (handle < 0 || handle >= (int32_t)variables_.size()) {
+    return false;
+  }
+  const auto &var = variables_[handle];
+  if (var.first + var.second > data_.size()) {
+    return false;
+  }
+
+  uint8_t *dst = &data_[var.first];
+  if (memcmp(dst, data, var.second) != 0) {
+    memcpy(dst, data, var.second);
+    if (dirty_end_ <= dirty_begin_) {
+      dirty_begin_ = var.first;
+      dirty_end_ = var.first + var.second;
+    } else {
+      dirty_begin_ = std::min(dirty_begin_, var.first);
+      dirty_end_ = std::max(dirty_end_, var.first + var.second);
+    }
+  }
+  return true;
+}
+
+bool UniformBlock::UpdateVariable(const char *variable_name, const void *data) {
+  return UpdateVariable(GetVariableHandle(variable_name), data);
+}
+
+bool UniformBlock::IsDirty() const {
+  return dirty_end_ > dirty_begin_;
+}
+
+void UniformBlock::Flush() {
+  if (!IsDirty()) {
+    return;
   }
-  return false;
+  buffer_->UpdateData(dirty_begin_, dirty_end_ - dirty_begin_, &data_[dirty_begin_]);
+  dirty_begin_ = dirty_end_ = 0;
 }
 
 }
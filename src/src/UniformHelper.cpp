@@ -39,6 +39,7 @@ void SetUniform(uint32_t type, uint32_t loc, uint32_t length, const float *val)
 void SetUniform(uint32_t type, uint32_t loc, uint32_t length, const int32_t *val) {
   switch (type) {
     case GL_INT:
+    case GL_BOOL:
     case GL_SAMPLER_2D:
     case GL_SAMPLER_3D:
     case GL_SAMPLER_CUBE:
@@ -57,12 +58,15 @@ void SetUniform(uint32_t type, uint32_t loc, uint32_t length, const int32_t *val
       glUniform1iv(loc, length, val);
       break;
     case GL_INT_VEC2:
+    case GL_BOOL_VEC2:
       glUniform2iv(loc, length, val);
       break;
     case GL_INT_VEC3:
+    case GL_BOOL_VEC3:
       glUniform3iv(loc, length, val);
       break;
     case GL_INT_VEC4:
+    case GL_BOOL_VEC4:
       glUniform4iv(loc, length, val);
       break;
     default:
@@ -1,6 +1,9 @@
 #include <mineola/VertexType.h>
+#include <mineola/Engine.h>
+#include <mineola/GeometryArena.h>
 #include <mineola/GLEffect.h>
 #include <mineola/GraphicsBuffer.h>
+#include <mineola/TriangleMesh.h>
 #include <mineola/glutility.h>
 
 namespace mineola { namespace vertex_type {
@@ -22,6 +25,7 @@ uint32_t VertexStream::Stride() {
 
 VertexArray::VertexArray() :
   vao_updated_(false),
+  arena_generation_(0),
   primitive_type_(GL_TRIANGLES),
   is_indexed_(false) {
 }
@@ -49,15 +53,53 @@ std::vector<std::shared_ptr<VertexStream>> &VertexArray::VertexStreams() {
   return vertex_stream_ptrs_;
 }
 
+const std::shared_ptr<VertexStream> &VertexArray::IndexStream() const {
+  return index_stream_ptr_;
+}
+
 void VertexArray::SetIndexed(bool indexed) {
   is_indexed_ = indexed;
 }
 
+bool VertexArray::IsIndexed() const {
+  return is_indexed_ && index_stream_ptr_;
+}
+
+void VertexArray::SetTriangleMesh(std::shared_ptr<TriangleMesh> mesh) {
+  triangle_mesh_ = std::move(mesh);
+}
+
+const std::shared_ptr<TriangleMesh> &VertexArray::GetTriangleMesh() const {
+  return triangle_mesh_;
+}
+
 void VertexArray::MarkVertexUpdated() {
   vao_updated_ = false;
 }
 
+bool VertexArray::PrepareVAO() {
+  if (vao_updated_ && arena_generation_ == Engine::Instance().GeomArena().Generation()) {
+    return true;
+  }
+  return UpdateVAO();
+}
+
 bool VertexArray::UpdateVAO() {
+  // follow allocations moved by the geometry arena
+  arena_generation_ = Engine::Instance().GeomArena().Generation();
+  auto sync_allocation = [](VertexStream &stream) {
+    if (stream.allocation) {
+      stream.buffer_ptr = stream.allocation->Buffer();
+      stream.offset = stream.allocation->Offset() + stream.allocation_offset;
+    }
+  };
+  for (auto &vertex_stream_ptr : vertex_stream_ptrs_) {
+    sync_allocation(*vertex_stream_ptr);
+  }
+  if (index_stream_ptr_) {
+    sync_allocation(*index_stream_ptr_);
+  }
+
   if (!vao_ptr_) {
     vao_ptr_.reset(new VertexArrayObject);
   }
@@ -66,15 +108,11 @@ bool VertexArray::UpdateVAO() {
     return false;
   }
 
+  auto &mgr = Engine::Instance().RenderStateMgr();
   vao_ptr_->Bind();
-  //bind vertex buffers
-  std::shared_ptr<GraphicsBuffer> last_buffer;
+  //bind vertex buffers, repeated binds of the same buffer are skipped by the state manager
   for (auto &vertex_stream_ptr : vertex_stream_ptrs_) {
-    // avoid repeated binding the same buffer
-    if (vertex_stream_ptr->buffer_ptr != last_buffer) {
-      vertex_stream_ptr->buffer_ptr->Bind();
-      last_buffer = vertex_stream_ptr->buffer_ptr;
-    }
+    mgr.BindBuffer(GL_ARRAY_BUFFER, vertex_stream_ptr->buffer_ptr->Handle());
 
     //bind attributes
     uint32_t offset = vertex_stream_ptr->offset;
@@ -90,19 +128,16 @@ bool VertexArray::UpdateVAO() {
     }
   }
 
-  //bind index buffer
-  if (index_stream_ptr_ && index_stream_ptr_->buffer_ptr != last_buffer) {
-    index_stream_ptr_->buffer_ptr->Bind();
-  }
-
-  vao_ptr_->Unbind();
+  //bind index buffer, recorded by the bound vao
+  mgr.BindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+    index_stream_ptr_ ? index_stream_ptr_->buffer_ptr->Handle() : 0);
 
   vao_updated_ = true;
   return true;
 }
 
 bool VertexArray::Draw() {
-  if (!vao_updated_ && !UpdateVAO()) {
+  if (!PrepareVAO()) {
     return false;
   }
 
@@ -120,9 +155,48 @@ bool VertexArray::Draw() {
       glDrawArrays(primitive_type_, 0, vertex_stream_ptrs_[0]->size);
     }
 
+    CHKGLERR_RET
+    // leave the vao bound, the state manager skips rebinding it for the next draw
+  }
+  return true;
+}
+
+bool VertexArray::DrawInstanced(GraphicsBuffer &instance_buffer, uint32_t offset,
+  uint32_t count) {
+  if (!PrepareVAO()) {
+    return false;
+  }
+
+  if (vao_ptr_) {
+    vao_ptr_->Bind();
+
+    // instance attributes are enabled only for this draw, plain draws of the same array
+    // read the constant generic attribute instead
+    instance_buffer.Bind();
+    const uint32_t stride = 16 * sizeof(float);
+    for (uint32_t col = 0; col < 4; ++col) {
+      uint32_t loc = INSTANCE_MODEL_MAT_BIND_LOCATION + col;
+      glEnableVertexAttribArray(loc);
+      glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, stride,
+        reinterpret_cast<GLvoid*>((uintptr_t)(offset + col * 4 * sizeof(float))));
+      glVertexAttribDivisor(loc, 1);
+    }
+
+    CHKGLERR_RET
+
+    if (is_indexed_ && index_stream_ptr_) {
+      glDrawElementsInstanced(primitive_type_, index_stream_ptr_->size,
+        type_mapping::Map2GLType(index_stream_ptr_->layout[0].format),
+        reinterpret_cast<GLvoid*>((uintptr_t)index_stream_ptr_->offset), count);
+    } else {
+      glDrawArraysInstanced(primitive_type_, 0, vertex_stream_ptrs_[0]->size, count);
+    }
+
     CHKGLERR_RET
 
-    vao_ptr_->Unbind();
+    for (uint32_t col = 0; col < 4; ++col) {
+      glDisableVertexAttribArray(INSTANCE_MODEL_MAT_BIND_LOCATION + col);
+    }
   }
   return true;
 }
@@ -135,16 +209,18 @@ VertexArrayObject::VertexArrayObject() :
 }
 
 VertexArrayObject::~VertexArrayObject() {
-  if (vao_handle_ != 0)
-      glDeleteVertexArrays(1, &vao_handle_);
+  if (vao_handle_ != 0) {
+    glDeleteVertexArrays(1, &vao_handle_);
+    Engine::Instance().RenderStateMgr().OnVertexArrayDeleted(vao_handle_);
+  }
 }
 
 void VertexArrayObject::Bind() {
-  glBindVertexArray(vao_handle_);
+  Engine::Instance().RenderStateMgr().BindVertexArray(vao_handle_);
 }
 
 void VertexArrayObject::Unbind() {
-  glBindVertexArray(0);
+  Engine::Instance().RenderStateMgr().BindVertexArray(0);
 }
 
 }} //namespace
@@ -30,7 +30,7 @@ void Viewport::Activate() {
   auto builtin_ub = Engine::Instance().BuiltinUniformBlock().lock();
   if (builtin_ub) {
     float viewport_size[] = {(float)width, (float)height, 0.0f, 0.0f};
-    builtin_ub->UpdateVariable("_viewport_size", viewport_size);
+    builtin_ub->UpdateVariable(UniformBlock::VIEWPORT_SIZE, viewport_size);
   }
 }
 